@@ -0,0 +1,191 @@
+/* Purpose:
+*   Cost of per-message I/O buffers drawn from BufferPool against
+*   malloc/free.
+*
+*  Command line arguments:
+*   argv[1]  number of threads
+*   argv[2]  buffers allocated and released per thread
+*   argv[3]  buffers each thread keeps in use, like connections
+*            holding a message that is not yet sent
+*   argv[4]  1 backs the pool with huge pages, 0 does not
+*
+*  Description:
+*
+*   for each allocator (malloc, pool):
+*       every thread keeps a window of buffers with sizes from 64 bytes
+*           to 16 KB, replacing one at a time in random order, touching
+*           the first bytes of each as a received message would
+*       half of the releases hand the buffer to the next thread, which
+*           frees it, as when one thread reads and another writes. At
+*           most a window's worth waits to be freed.
+*
+*   prints nanoseconds per allocate/release pair, minor page faults and
+*   the pool's slab count
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi, malloc, free
+#include <cstring>              // memset
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>       // getrusage
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/bufferPool.h>
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double pairNs;
+    long minorFaults;
+};
+
+
+// buffers handed from one thread to the next, freed by the receiver
+struct handoff_t{
+    std::mutex lock;
+    std::vector<void*> buffers;
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+long minor_faults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+
+template <typename Allocate, typename Release>
+void work(int index, int count, int window, std::vector<handoff_t> &handoffs,
+          Allocate allocate, Release release)
+{
+    std::mt19937 rng(uint32_t(index) + 1);
+    std::vector<void*> held(static_cast<size_t>(window), nullptr);
+    handoff_t &mine = handoffs[size_t(index)];
+    handoff_t &next = handoffs[size_t(index + 1) % handoffs.size()];
+    std::vector<void*> received;
+
+    for(int i = 0; i < count; ++i){
+        size_t slot = rng() % held.size();
+
+        if(held[slot] != nullptr){
+            bool handed = false;
+            if(i & 1){
+                // bounded, the next thread may not be running right now
+                std::lock_guard<std::mutex> guard(next.lock);
+                if(next.buffers.size() < held.size()){
+                    next.buffers.push_back(held[slot]);
+                    handed = true;
+                }
+            }
+            if(!handed){
+                release(held[slot]);
+            }
+        }
+
+        size_t len = size_t(64) << (rng() % 9);        // 64 .. 16K
+        held[slot] = allocate(len);
+        memset(held[slot], 0x5a, 64);
+
+        // free what other threads handed over
+        if((i & 63) == 0){
+            {
+                std::lock_guard<std::mutex> guard(mine.lock);
+                received.swap(mine.buffers);
+            }
+            for(void *p : received){
+                release(p);
+            }
+            received.clear();
+        }
+    }
+
+    for(void *p : held){
+        release(p);
+    }
+}
+
+
+template <typename Allocate, typename Release>
+result_t run(int numThreads, int count, int window, Allocate allocate, Release release)
+{
+    std::vector<handoff_t> handoffs(static_cast<size_t>(numThreads));
+    std::vector<std::thread> threads;
+
+    long faults = minor_faults();
+    Clock::time_point start = Clock::now();
+
+    for(int t = 0; t < numThreads; ++t){
+        threads.emplace_back([&, t]{work(t, count, window, handoffs, allocate, release);});
+    }
+    for(std::thread &t : threads){
+        t.join();
+    }
+
+    // handed over after the receiver finished
+    for(handoff_t &h : handoffs){
+        for(void *p : h.buffers){
+            release(p);
+        }
+    }
+
+    result_t result;
+    result.pairNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+                    / (double(count) * numThreads);
+    result.minorFaults = minor_faults() - faults;
+    return result;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <threads> <buffers per thread> <window> <huge pages 0|1>", argv[0]);
+        return 1;
+    }
+
+    int numThreads = atoi(argv[1]);
+    int count = atoi(argv[2]);
+    int window = atoi(argv[3]);
+    bool hugePages = atoi(argv[4]) != 0;
+
+    if(numThreads < 1 || count < 1 || window < 1){
+        log_error("threads, buffers and window must be positive");
+        return 1;
+    }
+
+    printf("%-8s %10s %14s %8s\n", "alloc", "ns/pair", "minor faults", "slabs");
+
+    result_t r = run(numThreads, count, window,
+                        [](size_t len){return malloc(len);},
+                        [](void *p){free(p);});
+    printf("%-8s %10.1f %14ld %8s\n", "malloc", r.pairNs, r.minorFaults, "-");
+
+    BufferPool pool(hugePages);
+    r = run(numThreads, count, window,
+                [&pool](size_t len){return pool.allocate(len);},
+                [](void *p){BufferPool::release(p);});
+    printf("%-8s %10.1f %14ld %8lu\n", "pool", r.pairNs, r.minorFaults,
+            (unsigned long)pool.get_slabs());
+
+    // a second pass, the slabs are mapped and faulted in
+    r = run(numThreads, count, window,
+                [&pool](size_t len){return pool.allocate(len);},
+                [](void *p){BufferPool::release(p);});
+    printf("%-8s %10.1f %14ld %8lu\n", "pool warm", r.pairNs, r.minorFaults,
+            (unsigned long)pool.get_slabs());
+
+    return 0;
+}
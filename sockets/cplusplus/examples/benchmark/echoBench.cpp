@@ -0,0 +1,312 @@
+/* Purpose:
+*   CPU the echo example server burns with idle clients connected, and
+*   the echo rate it sustains with active ones.
+*
+*  Command line arguments:
+*   argv[1]  path of the echo server executable (examples/echo/eserver),
+*            with its options when quoted, e.g. "../echo/eserver -t 4"
+*   argv[2]  port number the server is started on
+*   argv[3]  number of idle clients
+*   argv[4]  seconds the idle clients are measured
+*   argv[5]  number of active clients
+*   argv[6]  round trips per active client
+*   argv[7]  optional, megabytes each active client streams through the
+*            server, 0 or none skips the stream phase
+*
+*  Description:
+*
+*   starts the server as a child process, its output discarded
+*   connects the idle clients, which then send nothing, and reads the
+*       server's user and system time from /proc before and after
+*   each active client thread sends a 64 byte message and waits for the
+*       echo, round after round, while the idle clients stay connected
+*   each active client then streams its megabytes from one thread and
+*       reads the echo from another
+*   stops the server with SIGTERM
+*
+*   prints the server's CPU use while idle, echoes per second and the
+*   megabytes per second echoed
+*/
+#include <algorithm>            // std::min
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi, atol
+#include <cstring>              // memset
+#include <csignal>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>              // open
+#include <unistd.h>             // fork, execv, sysconf
+#include <sys/socket.h>         // shutdown
+#include <sys/wait.h>           // waitpid
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/socketClient.h>
+
+constexpr size_t MESSAGE_SIZE = 64;
+constexpr size_t STREAM_CHUNK = 65536;
+constexpr int START_TIMEOUT_MS = 5000;
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+/*========================= Function Definitions ==========================*/
+
+
+// command is the server path and its options, separated by spaces
+pid_t start_server(const char *command, const char *port)
+{
+    std::vector<std::string> words;
+    std::istringstream split(command);
+    std::string word;
+    while(split >> word){
+        words.push_back(word);
+    }
+    words.push_back(port);
+
+    std::vector<char*> args;
+    for(std::string &w : words){
+        args.push_back(&w[0]);
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if(pid == 0){
+        int null = open("/dev/null", O_WRONLY);
+        if(null != -1){
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+        execv(args[0], args.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+
+// user plus system time of a process, in seconds
+double cpu_seconds(pid_t pid)
+{
+    std::ifstream stat("/proc/" + std::to_string(pid) + "/stat");
+    std::string field;
+    unsigned long utime = 0, stime = 0;
+
+    // fields 14 and 15, the command name in field 2 has no spaces here
+    for(int i = 1; i <= 15 && stat >> field; ++i){
+        if(i == 14){
+            utime = std::stoul(field);
+        }
+        else if(i == 15){
+            stime = std::stoul(field);
+        }
+    }
+    return double(utime + stime) / double(sysconf(_SC_CLK_TCK));
+}
+
+
+// echoes received, a short one means the connection failed
+int ping_pong(SocketClient *client, int rounds)
+{
+    uint8_t message[MESSAGE_SIZE];
+    uint8_t echo[MESSAGE_SIZE];
+    memset(message, 'x', MESSAGE_SIZE);
+
+    for(int i = 0; i < rounds; ++i){
+        if(client->send_data(client->get_fd(), message, MESSAGE_SIZE) != ssize_t(MESSAGE_SIZE)){
+            return i;
+        }
+        size_t received = 0;
+        while(received < MESSAGE_SIZE){
+            ssize_t n = client->receive_data(client->get_fd(), echo + received,
+                                             MESSAGE_SIZE - received);
+            if(n <= 0){
+                return i;
+            }
+            received += size_t(n);
+        }
+    }
+    return rounds;
+}
+
+
+// bytes echoed back, short when the connection failed
+long stream(SocketClient *client, long bytes)
+{
+    std::vector<uint8_t> out(STREAM_CHUNK, 'x');
+    std::vector<uint8_t> in(STREAM_CHUNK);
+    long received = 0;
+
+    std::thread writer([client, bytes, &out]{
+        for(long sent = 0; sent < bytes;){
+            size_t len = size_t(std::min(long(STREAM_CHUNK), bytes - sent));
+            ssize_t n = client->send_data(client->get_fd(), out.data(), len);
+            if(n <= 0){
+                break;
+            }
+            sent += n;
+        }
+    });
+
+    while(received < bytes){
+        ssize_t n = client->receive_data(client->get_fd(), in.data(), STREAM_CHUNK);
+        if(n <= 0){
+            break;
+        }
+        received += n;
+    }
+
+    // a failed read leaves the writer blocked in send
+    if(received < bytes){
+        shutdown(client->get_fd(), SHUT_RDWR);
+    }
+    writer.join();
+    return received;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 7){
+        log_error("usage: %s <eserver path> <port> <idle clients> <seconds>"
+                  " <active clients> <round trips> [megabytes]", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[1];
+    const char *port = argv[2];
+    int numIdle = atoi(argv[3]);
+    int seconds = atoi(argv[4]);
+    int numActive = atoi(argv[5]);
+    int rounds = atoi(argv[6]);
+    long streamBytes = argc > 7 ? atol(argv[7]) * 1024 * 1024 : 0;
+
+    if(numIdle < 0 || seconds < 1 || numActive < 1 || rounds < 1){
+        log_error("seconds, active clients and round trips must be positive");
+        return 1;
+    }
+
+    pid_t server = start_server(path, port);
+    if(server == -1){
+        log_error("fork failed");
+        return 1;
+    }
+
+    // wait for the server to listen
+    std::vector<SocketClient> idle(static_cast<size_t>(numIdle));
+    SocketClient probe;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(START_TIMEOUT_MS);
+    while(probe.connect_client(port, "127.0.0.1") != 0){
+        if(Clock::now() > deadline || waitpid(server, NULL, WNOHANG) == server){
+            log_error("server %s did not start", path);
+            kill(server, SIGKILL);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    for(SocketClient &client : idle){
+        if(client.connect_client(port, "127.0.0.1") != 0){
+            log_error("idle client failed to connect");
+            kill(server, SIGTERM);
+            waitpid(server, NULL, 0);
+            return 1;
+        }
+    }
+
+    // let the server register them all before measuring
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    double cpuStart = cpu_seconds(server);
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    double idleCpu = (cpu_seconds(server) - cpuStart) / seconds;
+
+    std::vector<SocketClient> active(static_cast<size_t>(numActive));
+    std::vector<int> echoed(static_cast<size_t>(numActive), 0);
+    std::vector<std::thread> threads;
+
+    for(SocketClient &client : active){
+        if(client.connect_client(port, "127.0.0.1") != 0){
+            log_error("active client failed to connect");
+            kill(server, SIGTERM);
+            waitpid(server, NULL, 0);
+            return 1;
+        }
+    }
+
+    cpuStart = cpu_seconds(server);
+    Clock::time_point start = Clock::now();
+
+    for(size_t t = 0; t < active.size(); ++t){
+        threads.emplace_back([&, t]{echoed[t] = ping_pong(&active[t], rounds);});
+    }
+    for(std::thread &t : threads){
+        t.join();
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double activeCpu = (cpu_seconds(server) - cpuStart) / elapsed;
+
+    long total = 0;
+    for(int n : echoed){
+        total += n;
+    }
+
+    // every active client streams at once
+    std::vector<long> streamed(static_cast<size_t>(numActive), 0);
+    double streamElapsed = 0;
+    double streamCpu = 0;
+
+    if(streamBytes > 0){
+        threads.clear();
+        cpuStart = cpu_seconds(server);
+        start = Clock::now();
+
+        for(size_t t = 0; t < active.size(); ++t){
+            threads.emplace_back([&, t]{streamed[t] = stream(&active[t], streamBytes);});
+        }
+        for(std::thread &t : threads){
+            t.join();
+        }
+
+        streamElapsed = std::chrono::duration<double>(Clock::now() - start).count();
+        streamCpu = (cpu_seconds(server) - cpuStart) / streamElapsed;
+    }
+
+    long streamTotal = 0;
+    for(long n : streamed){
+        streamTotal += n;
+    }
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+
+    char rate[32];
+    printf("%-8s %8s %14s %10s\n", "phase", "clients", "rate", "cpu %");
+    printf("%-8s %8d %14s %10.1f\n", "idle", numIdle, "-", idleCpu * 100.0);
+    snprintf(rate, sizeof(rate), "%.0f echo/s", double(total) / elapsed);
+    printf("%-8s %8d %14s %10.1f\n", "active", numActive, rate, activeCpu * 100.0);
+    if(streamBytes > 0){
+        snprintf(rate, sizeof(rate), "%.1f MB/s", double(streamTotal) / (1024.0 * 1024.0)
+                    / streamElapsed);
+        printf("%-8s %8d %14s %10.1f\n", "stream", numActive, rate, streamCpu * 100.0);
+    }
+
+    if(total != long(numActive) * rounds){
+        log_error("%ld of %ld echoes received", total, long(numActive) * rounds);
+        return 1;
+    }
+    if(streamTotal != long(numActive) * streamBytes){
+        log_error("%ld of %ld bytes streamed", streamTotal, long(numActive) * streamBytes);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,251 @@
+/* Purpose:
+*   Echo throughput of the two IoEngine implementations, io_uring and
+*   epoll, with many streams in flight at once.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each engine uses the next port
+*   argv[2]  number of concurrent streams
+*   argv[3]  megabytes each stream sends through the echo
+*
+*  Description:
+*
+*   for each engine (io_uring, epoll), made by IoEngine::create:
+*       a server thread accepts with accept_multishot, receives with
+*           receive_multishot and sends every chunk straight back with
+*           send_data, all from run_once
+*       each stream connects, sends a numbered byte pattern from one
+*           thread and reads the echo from another, checking every byte
+*           against the pattern
+*
+*   prints MB/sec echoed over all streams, the CPU time of the server
+*   thread and the bytes that came back wrong or not at all. The io_uring
+*   row is skipped when the running kernel lacks its features.
+*/
+#include <algorithm>            // std::min
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>             // close
+#include <sys/socket.h>         // shutdown
+#include <sys/resource.h>       // getrusage
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/ioEngine.h>
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+
+// pattern byte i is i % PATTERN_PERIOD mixed with the stream number. A
+// chunk is a whole number of periods, so every chunk starts the pattern
+// over and one buffer serves every send.
+constexpr size_t PATTERN_PERIOD = 251;
+constexpr size_t STREAM_CHUNK = PATTERN_PERIOD * 256;
+constexpr int LOOP_TIMEOUT_MS = 100;
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double megabytesPerSec;
+    double serverCpuSeconds;
+    long wrongBytes;            // received, but not what was sent
+    long missingBytes;          // never received
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+double thread_cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+            + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+
+uint8_t pattern_byte(size_t offset, int stream)
+{
+    return uint8_t((offset % PATTERN_PERIOD) ^ size_t(stream));
+}
+
+
+// echoes every connection on listenfd until stop is set
+void echo_server(IoEngine *engine, int listenfd, std::atomic<bool> *stop,
+                 double *cpuSeconds)
+{
+    double start = thread_cpu_seconds();
+
+    IoEngine::ReceiveCallback echo = [engine](int fd, const uint8_t *data, ssize_t numBytes){
+        if(numBytes <= 0){
+            engine->cancel(fd);
+            close(fd);
+            return;
+        }
+        engine->send_data(fd, data, size_t(numBytes));
+    };
+
+    engine->accept_multishot(listenfd,
+            [engine, echo](int fd, const struct sockaddr_storage&){
+        if(fd < 0){
+            return;
+        }
+        if(engine->receive_multishot(fd, echo) != 0){
+            close(fd);
+        }
+    });
+
+    while(!stop->load(std::memory_order_relaxed)){
+        engine->run_once(LOOP_TIMEOUT_MS);
+    }
+    engine->cancel(listenfd);
+
+    *cpuSeconds = thread_cpu_seconds() - start;
+}
+
+
+// sends bytes of the pattern and checks the echo, returns the bytes that
+// came back wrong. received is set to the bytes read.
+long stream(const char *port, int number, long bytes, long *received)
+{
+    SocketClient client;
+    *received = 0;
+    if(client.connect_client(port, "127.0.0.1") != 0){
+        return 0;
+    }
+
+    std::vector<uint8_t> out(STREAM_CHUNK);
+    for(size_t i = 0; i < out.size(); ++i){
+        out[i] = pattern_byte(i, number);
+    }
+
+    std::thread writer([&client, bytes, &out]{
+        for(long sent = 0; sent < bytes;){
+            size_t len = size_t(std::min(long(STREAM_CHUNK), bytes - sent));
+            ssize_t n = client.send_data(client.get_fd(), out.data(), len);
+            if(n <= 0){
+                break;
+            }
+            sent += n;
+        }
+    });
+
+    std::vector<uint8_t> in(STREAM_CHUNK);
+    long wrong = 0;
+    while(*received < bytes){
+        ssize_t n = client.receive_data(client.get_fd(), in.data(), in.size());
+        if(n <= 0){
+            break;
+        }
+        for(ssize_t i = 0; i < n; ++i){
+            if(in[size_t(i)] != pattern_byte(size_t(*received + i), number)){
+                ++wrong;
+            }
+        }
+        *received += n;
+    }
+
+    // a failed read leaves the writer blocked in send
+    if(*received < bytes){
+        shutdown(client.get_fd(), SHUT_RDWR);
+    }
+    writer.join();
+    return wrong;
+}
+
+
+result_t run(IoEngine *engine, int port, int numStreams, long bytes)
+{
+    result_t result = {0.0, 0.0, 0, long(numStreams) * bytes};
+    std::string portString = std::to_string(port);
+
+    // every stream connects at once
+    SocketServer server;
+    if(server.initialize(portString.c_str(), SOMAXCONN) != 0){
+        return result;
+    }
+
+    std::atomic<bool> stop(false);
+    std::thread serverThread(echo_server, engine, server.get_fd(), &stop,
+                             &result.serverCpuSeconds);
+
+    std::vector<long> wrong(static_cast<size_t>(numStreams), 0);
+    std::vector<long> received(static_cast<size_t>(numStreams), 0);
+    std::vector<std::thread> threads;
+
+    Clock::time_point start = Clock::now();
+    for(int s = 0; s < numStreams; ++s){
+        threads.emplace_back([&, s]{
+            wrong[size_t(s)] = stream(portString.c_str(), s, bytes, &received[size_t(s)]);
+        });
+    }
+    for(std::thread &t : threads){
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    stop = true;
+    serverThread.join();
+
+    long total = 0;
+    for(int s = 0; s < numStreams; ++s){
+        total += received[size_t(s)];
+        result.wrongBytes += wrong[size_t(s)];
+    }
+    result.missingBytes = long(numStreams) * bytes - total;
+    if(seconds > 0){
+        result.megabytesPerSec = double(total) / (1024.0 * 1024.0) / seconds;
+    }
+    return result;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 4){
+        log_error("usage: %s <first port> <streams> <megabytes>", argv[0]);
+        return 1;
+    }
+
+    int port = atoi(argv[1]);
+    int numStreams = atoi(argv[2]);
+    long bytes = atol(argv[3]) * 1024 * 1024;
+
+    if(numStreams < 1 || bytes < 1){
+        log_error("streams and megabytes must be positive");
+        return 1;
+    }
+
+    int status = 0;
+    printf("%-10s %8s %10s %16s %12s %12s\n", "engine", "streams", "MB/sec",
+            "server cpu sec", "wrong bytes", "missing");
+
+    for(bool preferUring : {true, false}){
+        std::unique_ptr<IoEngine> engine = IoEngine::create(preferUring);
+        if(preferUring && std::string(engine->name()) != "io_uring"){
+            printf("%-10s %8s\n", "io_uring", "n/a");
+            ++port;
+            continue;
+        }
+
+        result_t r = run(engine.get(), port++, numStreams, bytes);
+        printf("%-10s %8d %10.1f %16.3f %12ld %12ld\n", engine->name(), numStreams,
+                r.megabytesPerSec, r.serverCpuSeconds, r.wrongBytes, r.missingBytes);
+
+        if(r.wrongBytes != 0 || r.missingBytes != 0){
+            status = 1;
+        }
+    }
+
+    return status;
+}
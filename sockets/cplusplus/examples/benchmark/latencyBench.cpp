@@ -0,0 +1,225 @@
+/* Purpose:
+*   Round trip latency and throughput of the socket option profiles
+*   over loopback.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each profile uses the next port
+*   argv[2]  number of round trips
+*   argv[3]  message size in bytes for the round trips
+*   argv[4]  megabytes sent for the throughput run
+*
+*  Description:
+*
+*   for each profile (default, low latency, bulk):
+*       a server thread applies the profile with SocketServer::set_options
+*       the first connection is echoed: the client sends one message,
+*           waits for the echo and records the round trip time
+*       the second connection is a sink: the client streams the payload,
+*           closes its side and waits for a one byte acknowledgement
+*
+*   prints p50/p99 round trip time in microseconds and MB/sec
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+#include <mysocket/socketOptions.h>
+
+constexpr size_t STREAM_CHUNK = 65536;
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double p50Us;
+    double p99Us;
+    double megabytesPerSec;
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+void serve(SocketServer *server, socket_options_t options)
+{
+    client_info_t client;
+    std::vector<uint8_t> buffer(STREAM_CHUNK);
+
+    // echo connection
+    if(server->accept_client_connection(&client) != 0){
+        return;
+    }
+    for(;;){
+        ssize_t n = server->receive_data(client.fd, buffer.data(), buffer.size());
+        if(n <= 0){
+            break;
+        }
+        server->send_data(client.fd, buffer.data(), size_t(n));
+        if(options.cork){
+            flush_cork(client.fd);      // end of response
+        }
+    }
+    close(client.fd);
+
+    // sink connection
+    if(server->accept_client_connection(&client) != 0){
+        return;
+    }
+    while(server->receive_data(client.fd, buffer.data(), buffer.size()) > 0){
+    }
+    uint8_t ack = 1;
+    server->send_data(client.fd, &ack, 1);
+    if(options.cork){
+        flush_cork(client.fd);
+    }
+    close(client.fd);
+}
+
+
+double percentile(std::vector<double> &samples, double p)
+{
+    if(samples.empty()){
+        return 0.0;
+    }
+    size_t index = size_t(p * double(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + long(index), samples.end());
+    return samples[index];
+}
+
+
+result_t run_profile(const char *port, const socket_options_t &options,
+                    int roundTrips, int size, int megabytes)
+{
+    result_t result = {0.0, 0.0, 0.0};
+    SocketServer server;
+
+    server.set_options(options);
+    if(server.initialize(port, SocketServer::AUTO_BACKLOG) != 0){
+        return result;
+    }
+    std::thread serverThread(serve, &server, options);
+
+    // round trips
+    SocketClient client;
+    client.set_options(options);
+    if(client.connect_client(port, "127.0.0.1") != 0){
+        shutdown(server.get_fd(), SHUT_RDWR);   // wakes the blocked accept
+        serverThread.join();
+        return result;
+    }
+
+    std::vector<uint8_t> message(size_t(size), 0x5a);
+    std::vector<uint8_t> reply(message.size());
+    std::vector<double> samples;
+    samples.reserve(size_t(roundTrips));
+
+    for(int i = 0; i < roundTrips; ++i){
+        Clock::time_point start = Clock::now();
+
+        client.send_data(client.get_fd(), message.data(), message.size());
+        if(options.cork){
+            flush_cork(client.get_fd());
+        }
+
+        size_t got = 0;
+        while(got < reply.size()){
+            ssize_t n = client.receive_data(client.get_fd(), reply.data() + got,
+                                            reply.size() - got);
+            if(n <= 0){
+                break;
+            }
+            got += size_t(n);
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(
+                            Clock::now() - start).count());
+    }
+    client.close_socket();
+
+    result.p50Us = percentile(samples, 0.50);
+    result.p99Us = percentile(samples, 0.99);
+
+    // throughput
+    SocketClient streamer;
+    streamer.set_options(options);
+    if(streamer.connect_client(port, "127.0.0.1") != 0){
+        shutdown(server.get_fd(), SHUT_RDWR);
+        serverThread.join();
+        return result;
+    }
+
+    std::vector<uint8_t> chunk(STREAM_CHUNK, 0xa5);
+    size_t total = size_t(megabytes) * 1024 * 1024;
+
+    Clock::time_point start = Clock::now();
+    for(size_t sent = 0; sent < total; sent += chunk.size()){
+        if(streamer.send_data(streamer.get_fd(), chunk.data(), chunk.size()) <= 0){
+            break;
+        }
+    }
+    shutdown(streamer.get_fd(), SHUT_WR);       // sends FIN, corked data included
+
+    uint8_t ack;
+    streamer.receive_data(streamer.get_fd(), &ack, 1);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    streamer.close_socket();
+
+    result.megabytesPerSec = seconds > 0 ? double(megabytes) / seconds : 0.0;
+
+    serverThread.join();
+    return result;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <first port> <round trips> <message size> <megabytes>", argv[0]);
+        return 1;
+    }
+
+    int firstPort = atoi(argv[1]);
+    int roundTrips = atoi(argv[2]);
+    int size = atoi(argv[3]);
+    int megabytes = atoi(argv[4]);
+
+    if(roundTrips < 1 || size < 1 || megabytes < 1){
+        log_error("round trips, message size and megabytes must be positive");
+        return 1;
+    }
+
+    struct profile_t{
+        const char *name;
+        socket_options_t options;
+    };
+    profile_t profiles[] = {
+        {"default", socket_options_t()},
+        {"low latency", low_latency_profile()},
+        {"bulk", bulk_profile()},
+    };
+
+    printf("%-12s %10s %10s %10s\n", "profile", "p50 us", "p99 us", "MB/sec");
+
+    int port = firstPort;
+    for(profile_t &profile : profiles){
+        std::string portText = std::to_string(port++);
+        result_t r = run_profile(portText.c_str(), profile.options, roundTrips, size, megabytes);
+        printf("%-12s %10.1f %10.1f %10.0f\n", profile.name, r.p50Us, r.p99Us,
+                r.megabytesPerSec);
+    }
+
+    return 0;
+}
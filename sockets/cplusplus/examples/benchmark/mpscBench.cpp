@@ -0,0 +1,275 @@
+/* Purpose:
+*   Rate of messages sent on one connection by several threads through
+*   SubmissionQueue (lock-free MPSC queue plus eventfd), against the same
+*   hand-off through a mutex protected queue.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each run uses the next port
+*   argv[2]  number of producer threads
+*   argv[3]  messages per producer
+*   argv[4]  message size in bytes, at least 16
+*
+*  Description:
+*
+*   for each queue (mutex, mpsc):
+*       a loop thread owns an accepted connection, its OutboundQueue and
+*           the submission queue, and writes submitted messages
+*       the producer threads submit length-prefixed messages carrying
+*           their producer number and a sequence number
+*       the client reads every message and checks that none are mixed
+*           and that each producer's sequence numbers arrive in order
+*
+*   prints messages/sec and the number of out of order or corrupt messages
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/eventLoop.h>
+#include <mysocket/frameCodec.h>
+#include <mysocket/outboundQueue.h>
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+#include <mysocket/submissionQueue.h>
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double messagesPerSec;
+    uint64_t errors;
+};
+
+
+/*  Baseline with the interface of SubmissionQueue: producers append
+*   under a mutex, the loop swaps the batch out under the same mutex.
+*/
+class LockedSubmissionQueue{
+    public:
+
+    LockedSubmissionQueue(EventLoop &eventLoop, OutboundQueue &outbound)
+        : loop(&eventLoop), out(&outbound){
+        wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        loop->add(wakefd, EventLoop::READ, [this](int, uint32_t){drain();});
+    }
+
+    ~LockedSubmissionQueue(){
+        loop->remove(wakefd);
+        close(wakefd);
+    }
+
+    int submit(const void *buf, size_t len){
+        const uint8_t *bytes = static_cast<const uint8_t*>(buf);
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            wasEmpty = messages.empty();
+            messages.emplace_back(bytes, bytes + len);
+        }
+        if(wasEmpty){
+            uint64_t one = 1;
+            if(write(wakefd, &one, sizeof(one)) != sizeof(one)){
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    int drain(){
+        uint64_t count;
+        std::vector<std::vector<uint8_t>> batch;
+
+        if(read(wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+            return -1;
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            batch.swap(messages);
+        }
+        for(std::vector<uint8_t> &message : batch){
+            if(out->send(message.data(), message.size()) != 0){
+                return -1;
+            }
+        }
+        return int(batch.size());
+    }
+
+
+    private:
+        EventLoop *loop;
+        OutboundQueue *out;
+        std::mutex lock;
+        std::vector<std::vector<uint8_t>> messages;
+        int wakefd;
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+void put_u32(uint8_t *p, uint32_t v)
+{
+    p[0] = uint8_t(v >> 24);
+    p[1] = uint8_t(v >> 16);
+    p[2] = uint8_t(v >> 8);
+    p[3] = uint8_t(v);
+}
+
+
+uint32_t get_u32(const uint8_t *p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16)
+         | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+
+// the loop thread: accepts one connection, then runs the loop while the
+// producers submit to it
+template <typename Queue>
+void own_connection(SocketServer *server, int producers, int messages, int size,
+                    std::atomic<bool> *done)
+{
+    client_info_t client;
+    if(server->accept_client_connection(&client) != 0){
+        return;
+    }
+    set_nonblocking(client.fd);
+
+    EventLoop loop;
+    OutboundQueue out(client.fd, &loop, 0);
+    loop.add(client.fd, 0, [&out](int, uint32_t events){
+        if(events & EPOLLOUT){
+            out.flush();
+        }
+    });
+
+    {
+        Queue queue(loop, out);
+
+        std::vector<std::thread> threads;
+        for(int p = 0; p < producers; ++p){
+            threads.emplace_back([&queue, p, messages, size]{
+                std::vector<uint8_t> message(size_t(size), 0x77);
+                put_u32(message.data(), uint32_t(size) - uint32_t(FRAME_HEADER_SIZE));
+                put_u32(message.data() + 4, uint32_t(p));
+                for(int i = 0; i < messages; ++i){
+                    put_u32(message.data() + 8, uint32_t(i));
+                    queue.submit(message.data(), message.size());
+                }
+            });
+        }
+
+        // runs until the client has everything
+        while(!done->load()){
+            loop.run_once(10);
+        }
+        for(std::thread &t : threads){
+            t.join();
+        }
+    }
+
+    loop.remove(client.fd);
+    close(client.fd);
+}
+
+
+template <typename Queue>
+result_t run(int port, int producers, int messages, int size)
+{
+    result_t result = {0.0, 0};
+    std::string portText = std::to_string(port);
+    std::atomic<bool> done(false);
+
+    SocketServer server;
+    if(server.initialize(portText.c_str(), SocketServer::AUTO_BACKLOG) != 0){
+        return result;
+    }
+    std::thread owner(own_connection<Queue>, &server, producers, messages, size, &done);
+
+    SocketClient client;
+    if(client.connect_client(portText.c_str(), "127.0.0.1") != 0){
+        shutdown(server.get_fd(), SHUT_RDWR);
+        owner.join();
+        return result;
+    }
+
+    std::vector<uint32_t> expected(size_t(producers), 0);
+    std::vector<uint8_t> message(static_cast<size_t>(size));
+    uint64_t total = uint64_t(producers) * uint64_t(messages);
+
+    Clock::time_point start = Clock::now();
+    for(uint64_t i = 0; i < total; ++i){
+        if(recv(client.get_fd(), message.data(), message.size(), MSG_WAITALL)
+                != ssize_t(message.size())){
+            log_error("connection lost after %llu messages", (unsigned long long)i);
+            result.errors += total - i;
+            break;
+        }
+
+        // a message mixed with another shows up as a bad length or id
+        uint32_t length = get_u32(message.data());
+        uint32_t producer = get_u32(message.data() + 4);
+        uint32_t sequence = get_u32(message.data() + 8);
+        if(length != uint32_t(size) - FRAME_HEADER_SIZE || producer >= uint32_t(producers) ||
+                sequence != expected[producer]){
+            ++result.errors;
+            if(producer < uint32_t(producers)){
+                expected[producer] = sequence + 1;
+            }
+            continue;
+        }
+        ++expected[producer];
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    done = true;
+    owner.join();
+
+    result.messagesPerSec = seconds > 0 ? double(total) / seconds : 0.0;
+    return result;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <first port> <producers> <messages> <message size>", argv[0]);
+        return 1;
+    }
+
+    int port = atoi(argv[1]);
+    int producers = atoi(argv[2]);
+    int messages = atoi(argv[3]);
+    int size = atoi(argv[4]);
+
+    if(producers < 1 || messages < 1 || size < 16){
+        log_error("producers and messages must be positive, message size at least 16");
+        return 1;
+    }
+
+    printf("%-8s %12s %8s\n", "queue", "msgs/sec", "errors");
+
+    result_t r = run<LockedSubmissionQueue>(port++, producers, messages, size);
+    printf("%-8s %12.0f %8llu\n", "mutex", r.messagesPerSec, (unsigned long long)r.errors);
+
+    r = run<SubmissionQueue>(port++, producers, messages, size);
+    printf("%-8s %12.0f %8llu\n", "mpsc", r.messagesPerSec, (unsigned long long)r.errors);
+
+    return 0;
+}
@@ -0,0 +1,409 @@
+/* Purpose:
+*   I/O latency and handler throughput of a server that runs CPU heavy
+*   request handlers inline on its I/O thread, against the same server
+*   handing them to a WorkerPool.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each run uses the next port
+*   argv[2]  largest number of pool workers, runs use 1, 2, 4, ... up to it
+*   argv[3]  number of clients sending heavy requests
+*   argv[4]  hash rounds per heavy request, the handler cost
+*   argv[5]  seconds per run
+*
+*  Description:
+*
+*   the server thread runs an EventLoop, reads length-prefixed requests
+*   with FrameReader and answers through an OutboundQueue
+*       a request carries a number of hash rounds over its payload
+*       0 rounds (a ping) is always answered on the I/O thread
+*       other requests run inline, or as WorkerPool jobs whose completions
+*           come back through the pool's eventfd
+*       responses are sent in request order per connection
+*
+*   the heavy clients send requests back to back, one outstanding each
+*   a probe client sends a ping every millisecond and records the round
+*   trip time, which shows how long the I/O thread takes to get to it
+*
+*   prints probe p50/p99 in microseconds and heavy requests per second
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>            // struct iovec
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/eventLoop.h>
+#include <mysocket/frameCodec.h>
+#include <mysocket/outboundQueue.h>
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+#include <mysocket/workerPool.h>
+
+constexpr uint32_t REQUEST_SIZE = 64;
+constexpr uint32_t RESPONSE_SIZE = 8;
+
+// reads per readiness event before other connections get a turn. Edge
+// triggered readiness is not reported again, so a connection that used
+// up its budget is revisited from a backlog instead
+constexpr int READ_BUDGET = 1;
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double p50Us;
+    double p99Us;
+    double requestsPerSec;
+};
+
+
+struct connection_t{
+    int fd;
+    FrameReader reader;
+    OutboundQueue out;
+    bool closed = false;
+
+    // responses leave in request order, finished ones wait here for
+    // their predecessors
+    uint64_t nextRequest = 0;
+    uint64_t nextResponse = 0;
+    std::map<uint64_t, uint64_t> finished;
+
+    connection_t(int socketfd, EventLoop *loop) : fd(socketfd), reader(socketfd),
+                                                out(socketfd, loop){}
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+uint32_t get_rounds(const uint8_t *payload)
+{
+    return (uint32_t(payload[0]) << 24) | (uint32_t(payload[1]) << 16)
+         | (uint32_t(payload[2]) << 8) | uint32_t(payload[3]);
+}
+
+
+// the request handler, FNV-1a over the payload rounds times
+uint64_t crunch(const std::vector<uint8_t> &payload, uint32_t rounds)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for(uint32_t r = 0; r < rounds; ++r){
+        for(uint8_t b : payload){
+            hash = (hash ^ b) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+
+void close_connection(EventLoop &loop, std::unordered_map<int, std::shared_ptr<connection_t>> &conns,
+                    int fd)
+{
+    auto it = conns.find(fd);
+    if(it == conns.end()){
+        return;
+    }
+    it->second->closed = true;      // completions still in the pool see this
+    loop.remove(fd);
+    close(fd);
+    conns.erase(it);
+}
+
+
+int send_response(OutboundQueue &out, uint64_t value)
+{
+    uint8_t header[FRAME_HEADER_SIZE];
+    struct iovec iov[2];
+
+    encode_frame_header(header, RESPONSE_SIZE);
+    iov[0].iov_base = header;
+    iov[0].iov_len = sizeof(header);
+    iov[1].iov_base = &value;
+    iov[1].iov_len = RESPONSE_SIZE;
+    return out.send(iov, 2);
+}
+
+
+// queues every response that is next in order
+int deliver(connection_t &c, uint64_t request, uint64_t value)
+{
+    c.finished[request] = value;
+
+    for(auto it = c.finished.begin();
+            it != c.finished.end() && it->first == c.nextResponse;
+            it = c.finished.erase(it)){
+        if(send_response(c.out, it->second) != 0){
+            return -1;
+        }
+        ++c.nextResponse;
+    }
+    return 0;
+}
+
+
+void serve(SocketServer *server, WorkerPool *pool, std::atomic<bool> *done)
+{
+    EventLoop loop;
+    std::unordered_map<int, std::shared_ptr<connection_t>> conns;
+    std::vector<int> backlog;
+
+    auto on_client = [&](int fd, uint32_t events){
+        auto found = conns.find(fd);
+        if(found == conns.end()){
+            return;                             // closed while in the backlog
+        }
+        std::shared_ptr<connection_t> c = found->second;
+
+        if(events & EPOLLOUT){
+            if(c->out.flush() != 0){
+                close_connection(loop, conns, fd);
+                return;
+            }
+        }
+
+        for(int budget = READ_BUDGET; ; --budget){
+            if(budget == 0){
+                backlog.push_back(fd);
+                break;
+            }
+
+            ssize_t n = c->reader.fill();
+            if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+                close_connection(loop, conns, fd);
+                return;
+            }
+
+            frame_view_t frame;
+            int more;
+            while((more = c->reader.next(frame)) == 1){
+                uint64_t request = c->nextRequest++;
+                uint32_t rounds = frame.length >= 4 ? get_rounds(frame.data) : 0;
+
+                if(rounds == 0 || pool == nullptr){
+                    std::vector<uint8_t> payload(frame.data, frame.data + frame.length);
+                    if(deliver(*c, request, crunch(payload, rounds)) != 0){
+                        close_connection(loop, conns, fd);
+                        return;
+                    }
+                    continue;
+                }
+
+                // the view is only valid until the next fill, the job
+                // gets its own copy of the payload
+                auto payload = std::make_shared<std::vector<uint8_t>>(frame.data,
+                                                        frame.data + frame.length);
+                auto value = std::make_shared<uint64_t>(0);
+                pool->submit([payload, value, rounds]{
+                        *value = crunch(*payload, rounds);
+                    },
+                    [&loop, &conns, c, request, value]{
+                        if(!c->closed && deliver(*c, request, *value) != 0){
+                            close_connection(loop, conns, c->fd);
+                        }
+                    });
+            }
+            if(more < 0){
+                close_connection(loop, conns, fd);
+                return;
+            }
+            if(n < 0){
+                break;                          // drained
+            }
+        }
+    };
+
+    set_nonblocking(server->get_fd());
+    loop.add(server->get_fd(), EventLoop::READ, [&](int, uint32_t){
+        for(;;){
+            int fd = accept4(server->get_fd(), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd == -1){
+                break;
+            }
+            conns[fd] = std::make_shared<connection_t>(fd, &loop);
+            loop.add(fd, EventLoop::READ, on_client);
+        }
+    });
+
+    if(pool != nullptr){
+        loop.add(pool->get_completion_fd(), EventLoop::READ, [pool](int, uint32_t){
+            pool->run_completions();
+        });
+    }
+
+    while(!done->load()){
+        loop.run_once(backlog.empty() ? 100 : 0);
+
+        std::vector<int> revisit;
+        revisit.swap(backlog);
+        for(int fd : revisit){
+            on_client(fd, 0);
+        }
+    }
+
+    if(pool != nullptr){
+        loop.remove(pool->get_completion_fd());
+    }
+    while(!conns.empty()){
+        close_connection(loop, conns, conns.begin()->first);
+    }
+}
+
+
+// one request, blocks for the response
+bool round_trip(SocketClient &client, const std::vector<uint8_t> &request)
+{
+    uint8_t response[FRAME_HEADER_SIZE + RESPONSE_SIZE];
+
+    if(send_frame(client.get_fd(), request.data(), uint32_t(request.size())) <= 0){
+        return false;
+    }
+    return recv(client.get_fd(), response, sizeof(response), MSG_WAITALL)
+            == ssize_t(sizeof(response));
+}
+
+
+void heavy_client(const char *port, uint32_t rounds, std::atomic<bool> *done,
+                std::atomic<uint64_t> *requests)
+{
+    SocketClient client;
+    if(client.connect_client(port, "127.0.0.1") != 0){
+        return;
+    }
+
+    std::vector<uint8_t> request(REQUEST_SIZE, 0x5a);
+    request[0] = uint8_t(rounds >> 24);
+    request[1] = uint8_t(rounds >> 16);
+    request[2] = uint8_t(rounds >> 8);
+    request[3] = uint8_t(rounds);
+
+    while(!done->load() && round_trip(client, request)){
+        requests->fetch_add(1);
+    }
+}
+
+
+double percentile(std::vector<double> &samples, double p)
+{
+    if(samples.empty()){
+        return 0.0;
+    }
+    size_t index = size_t(p * double(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + long(index), samples.end());
+    return samples[index];
+}
+
+
+result_t run(int port, int workers, int heavyClients, uint32_t rounds, int seconds)
+{
+    result_t result = {0.0, 0.0, 0.0};
+    std::string portText = std::to_string(port);
+
+    SocketServer server;
+    if(server.initialize(portText.c_str(), SocketServer::AUTO_BACKLOG) != 0){
+        return result;
+    }
+
+    std::unique_ptr<WorkerPool> pool;
+    if(workers > 0){
+        pool = std::make_unique<WorkerPool>(workers);
+        if(!pool->is_ready()){
+            log_error("worker pool failed to start");
+            return result;
+        }
+    }
+
+    std::atomic<bool> serverDone(false);
+    std::atomic<bool> clientsDone(false);
+    std::atomic<uint64_t> requests(0);
+
+    std::thread serverThread(serve, &server, pool.get(), &serverDone);
+
+    std::vector<std::thread> heavy;
+    for(int i = 0; i < heavyClients; ++i){
+        heavy.emplace_back(heavy_client, portText.c_str(), rounds, &clientsDone, &requests);
+    }
+
+    // probe
+    std::vector<double> samples;
+    SocketClient probe;
+    if(probe.connect_client(portText.c_str(), "127.0.0.1") == 0){
+        std::vector<uint8_t> ping(REQUEST_SIZE, 0);
+        Clock::time_point end = Clock::now() + std::chrono::seconds(seconds);
+
+        while(Clock::now() < end){
+            Clock::time_point start = Clock::now();
+            if(!round_trip(probe, ping)){
+                break;
+            }
+            samples.push_back(std::chrono::duration<double, std::micro>(
+                                Clock::now() - start).count());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        probe.close_socket();
+    }
+
+    uint64_t handled = requests.load();
+    clientsDone = true;
+    for(std::thread &t : heavy){
+        t.join();
+    }
+    serverDone = true;
+    serverThread.join();
+
+    result.p50Us = percentile(samples, 0.50);
+    result.p99Us = percentile(samples, 0.99);
+    result.requestsPerSec = double(handled) / double(seconds);
+    return result;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 6){
+        log_error("usage: %s <first port> <max workers> <heavy clients> <rounds> <seconds>",
+                    argv[0]);
+        return 1;
+    }
+
+    int port = atoi(argv[1]);
+    int maxWorkers = atoi(argv[2]);
+    int heavyClients = atoi(argv[3]);
+    int rounds = atoi(argv[4]);
+    int seconds = atoi(argv[5]);
+
+    if(maxWorkers < 1 || heavyClients < 1 || rounds < 1 || seconds < 1){
+        log_error("workers, clients, rounds and seconds must be positive");
+        return 1;
+    }
+
+    printf("%-10s %10s %10s %12s\n", "handlers", "probe p50", "probe p99", "requests/s");
+
+    result_t r = run(port++, 0, heavyClients, uint32_t(rounds), seconds);
+    printf("%-10s %10.1f %10.1f %12.0f\n", "inline", r.p50Us, r.p99Us, r.requestsPerSec);
+
+    for(int workers = 1; workers <= maxWorkers; workers *= 2){
+        r = run(port++, workers, heavyClients, uint32_t(rounds), seconds);
+        std::string name = "pool " + std::to_string(workers);
+        printf("%-10s %10.1f %10.1f %12.0f\n", name.c_str(), r.p50Us, r.p99Us,
+                r.requestsPerSec);
+    }
+
+    return 0;
+}
@@ -0,0 +1,340 @@
+/* Purpose:
+*   Throughput of a TCP relay moving bytes with splice (SpliceRelay)
+*   against one copying them through a user buffer with recv/send, the
+*   path echoServer.cpp uses.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each run uses the next two ports
+*   argv[2]  megabytes streamed through the relay per run
+*   argv[3]  number of runs per relay, the best is reported
+*
+*  Description:
+*
+*   for each relay (copy, splice):
+*       an upstream thread accepts one connection, reads until end of file
+*           and answers with a one byte acknowledgement
+*       a relay thread accepts the client, connects a SocketClient to the
+*           upstream and forwards both directions on an EventLoop
+*       the client streams the payload, shuts down its sending side and
+*           waits for the acknowledgement, which only arrives if the relay
+*           passed the half-close on to the upstream
+*
+*   prints MB/sec and the CPU time spent by the relay thread
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <cerrno>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>       // getrusage
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/eventLoop.h>
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+#include <mysocket/spliceRelay.h>
+
+constexpr size_t STREAM_CHUNK = 65536;
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double megabytesPerSec;
+    double relayCpuSeconds;
+};
+
+
+/*  The copy relay, same structure as SpliceRelay but every chunk goes
+*   through a user space buffer: recv copies it out of the kernel, send
+*   copies it back in.
+*/
+class CopyRelay{
+    public:
+
+    explicit CopyRelay(EventLoop &eventLoop) : loop(&eventLoop){}
+
+    ~CopyRelay(){
+        while(!pairs.empty()){
+            close_pair(pairs.begin()->first);
+        }
+    }
+
+    int add(int clientfd, int upstreamfd){
+        pair_t &p = pairs[clientfd];
+        p.clientfd = clientfd;
+        p.upstreamfd = upstreamfd;
+        p.toUpstream.from = clientfd;
+        p.toUpstream.to = upstreamfd;
+        p.toClient.from = upstreamfd;
+        p.toClient.to = clientfd;
+        owner[clientfd] = clientfd;
+        owner[upstreamfd] = clientfd;
+
+        set_nonblocking(clientfd);
+        set_nonblocking(upstreamfd);
+
+        EventLoop::Callback cb = [this](int fd, uint32_t){on_event(fd);};
+        loop->add(clientfd, EventLoop::READ | EventLoop::WRITE, cb);
+        loop->add(upstreamfd, EventLoop::READ | EventLoop::WRITE, cb);
+        on_event(clientfd);
+        return 0;
+    }
+
+    size_t size(){return pairs.size();}
+
+
+    private:
+
+        struct direction_t{
+            int from = -1;
+            int to = -1;
+            std::vector<uint8_t> buffer = std::vector<uint8_t>(STREAM_CHUNK);
+            size_t head = 0;
+            size_t tail = 0;
+            bool sourceEnded = false;
+            bool shutdownSent = false;
+        };
+
+        struct pair_t{
+            int clientfd;
+            int upstreamfd;
+            direction_t toUpstream;
+            direction_t toClient;
+        };
+
+        EventLoop *loop;
+        std::unordered_map<int, pair_t> pairs;
+        std::unordered_map<int, int> owner;
+
+        int pump(direction_t &d){
+            for(;;){
+                bool progress = false;
+
+                if(!d.sourceEnded && d.tail == 0){
+                    ssize_t n = recv(d.from, d.buffer.data(), d.buffer.size(), 0);
+                    if(n > 0){
+                        d.head = 0;
+                        d.tail = size_t(n);
+                        progress = true;
+                    }
+                    else if(n == 0){
+                        d.sourceEnded = true;
+                        progress = true;
+                    }
+                    else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                        return -1;
+                    }
+                }
+
+                if(d.head < d.tail){
+                    ssize_t n = send(d.to, d.buffer.data() + d.head, d.tail - d.head,
+                                    MSG_NOSIGNAL);
+                    if(n > 0){
+                        d.head += size_t(n);
+                        if(d.head == d.tail){
+                            d.head = d.tail = 0;
+                        }
+                        progress = true;
+                    }
+                    else if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                        return -1;
+                    }
+                }
+
+                if(!progress){
+                    break;
+                }
+            }
+
+            if(d.sourceEnded && d.tail == 0 && !d.shutdownSent){
+                shutdown(d.to, SHUT_WR);
+                d.shutdownSent = true;
+            }
+            return 0;
+        }
+
+        void on_event(int fd){
+            auto o = owner.find(fd);
+            if(o == owner.end()){
+                return;
+            }
+            int clientfd = o->second;
+            pair_t &p = pairs[clientfd];
+
+            if(pump(p.toUpstream) != 0 || pump(p.toClient) != 0 ||
+                    (p.toUpstream.shutdownSent && p.toClient.shutdownSent)){
+                close_pair(clientfd);
+            }
+        }
+
+        void close_pair(int clientfd){
+            pair_t &p = pairs[clientfd];
+            for(int fd : {p.clientfd, p.upstreamfd}){
+                loop->remove(fd);
+                owner.erase(fd);
+                close(fd);
+            }
+            pairs.erase(clientfd);
+        }
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+void upstream_sink(SocketServer *server)
+{
+    client_info_t client;
+    std::vector<uint8_t> buffer(STREAM_CHUNK);
+
+    if(server->accept_client_connection(&client) != 0){
+        return;
+    }
+    while(server->receive_data(client.fd, buffer.data(), buffer.size()) > 0){
+    }
+    uint8_t ack = 1;
+    server->send_data(client.fd, &ack, 1);
+    close(client.fd);
+}
+
+
+double thread_cpu_seconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return double(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+            + double(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+
+template <typename Relay>
+void relay_one(SocketServer *server, const char *upstreamPort, double *cpuSeconds)
+{
+    client_info_t client;
+    if(server->accept_client_connection(&client) != 0){
+        return;
+    }
+
+    SocketClient upstream;
+    if(upstream.connect_client(upstreamPort, "127.0.0.1") != 0){
+        close(client.fd);
+        return;
+    }
+
+    double start = thread_cpu_seconds();
+
+    EventLoop loop;
+    Relay relay(loop);
+    relay.add(client.fd, upstream.release());
+    while(relay.size() > 0){
+        loop.run_once(1000);
+    }
+
+    *cpuSeconds = thread_cpu_seconds() - start;
+}
+
+
+template <typename Relay>
+result_t run(int port, int megabytes)
+{
+    result_t result = {0.0, 0.0};
+    std::string relayPort = std::to_string(port);
+    std::string upstreamPort = std::to_string(port + 1);
+
+    SocketServer upstreamServer;
+    SocketServer relayServer;
+    if(upstreamServer.initialize(upstreamPort.c_str(), SocketServer::AUTO_BACKLOG) != 0 ||
+            relayServer.initialize(relayPort.c_str(), SocketServer::AUTO_BACKLOG) != 0){
+        return result;
+    }
+
+    std::thread upstreamThread(upstream_sink, &upstreamServer);
+    std::thread relayThread(relay_one<Relay>, &relayServer, upstreamPort.c_str(),
+                            &result.relayCpuSeconds);
+
+    SocketClient client;
+    if(client.connect_client(relayPort.c_str(), "127.0.0.1") != 0){
+        shutdown(relayServer.get_fd(), SHUT_RDWR);      // wakes the blocked accepts
+        shutdown(upstreamServer.get_fd(), SHUT_RDWR);
+        relayThread.join();
+        upstreamThread.join();
+        return result;
+    }
+
+    std::vector<uint8_t> chunk(STREAM_CHUNK, 0xa5);
+    size_t total = size_t(megabytes) * 1024 * 1024;
+
+    Clock::time_point start = Clock::now();
+    for(size_t sent = 0; sent < total; sent += chunk.size()){
+        if(client.send_data(client.get_fd(), chunk.data(), chunk.size()) <= 0){
+            break;
+        }
+    }
+    shutdown(client.get_fd(), SHUT_WR);
+
+    uint8_t ack = 0;
+    ssize_t n = client.receive_data(client.get_fd(), &ack, 1);
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    client.close_socket();
+
+    if(n != 1){
+        log_error("no acknowledgement, the half-close was not relayed");
+    }
+    else if(seconds > 0){
+        result.megabytesPerSec = double(megabytes) / seconds;
+    }
+
+    relayThread.join();
+    upstreamThread.join();
+    return result;
+}
+
+
+template <typename Relay>
+void report(const char *name, int &port, int megabytes, int runs)
+{
+    result_t best = {0.0, 0.0};
+    for(int i = 0; i < runs; ++i){
+        result_t r = run<Relay>(port, megabytes);
+        port += 2;
+        if(r.megabytesPerSec > best.megabytesPerSec){
+            best = r;
+        }
+    }
+    printf("%-8s %10.0f %14.3f\n", name, best.megabytesPerSec, best.relayCpuSeconds);
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 4){
+        log_error("usage: %s <first port> <megabytes> <runs>", argv[0]);
+        return 1;
+    }
+
+    int port = atoi(argv[1]);
+    int megabytes = atoi(argv[2]);
+    int runs = atoi(argv[3]);
+
+    if(megabytes < 1 || runs < 1){
+        log_error("megabytes and runs must be positive");
+        return 1;
+    }
+
+    printf("%-8s %10s %14s\n", "relay", "MB/sec", "relay cpu sec");
+    report<CopyRelay>("copy", port, megabytes, runs);
+    report<SpliceRelay>("splice", port, megabytes, runs);
+
+    return 0;
+}
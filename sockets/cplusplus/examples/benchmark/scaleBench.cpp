@@ -0,0 +1,322 @@
+/* Purpose:
+*   Tens of thousands of concurrent loopback connections to the echo
+*   example server: memory per connection and echo latency.
+*
+*  Command line arguments:
+*   argv[1]  path of the echo server executable (examples/echo/eserver),
+*            with its options when quoted, e.g. "../echo/eserver -t 4"
+*   argv[2]  port number the server is started on
+*   argv[3]  number of connections
+*   argv[4]  number of round trips timed
+*
+*  Description:
+*
+*   raises this process's open file limit, starts the server as a child
+*       process, its output discarded
+*   opens the connections, spread over source addresses 127.0.0.1,
+*       127.0.0.2, ... so the ephemeral ports of one do not run out
+*   sends one byte on every connection, then reads every echo: the time
+*       this takes is one sweep over all connections
+*   reads the server's resident memory and the kernel's slab memory,
+*       which holds the sockets, before and after, divides the growth
+*       by the connections
+*   times 64 byte round trips on connections picked at random, while
+*       every other connection stays open
+*   stops the server with SIGTERM
+*
+*   The server and this process each need a descriptor per connection,
+*   see ulimit -Hn. 50,000 connections need a hard limit above that.
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <cstring>              // memset, strerror
+#include <csignal>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>              // open
+#include <unistd.h>             // fork, execv, close
+#include <arpa/inet.h>          // htons, htonl
+#include <netinet/in.h>
+#include <sys/resource.h>       // setrlimit
+#include <sys/socket.h>
+#include <sys/wait.h>           // waitpid
+
+#include <debuglog/debuglog.h>
+
+constexpr size_t MESSAGE_SIZE = 64;
+constexpr int START_TIMEOUT_MS = 5000;
+
+// connections per source address, below the 28k ephemeral ports of the
+// default net.ipv4.ip_local_port_range
+constexpr int CONNECTIONS_PER_SOURCE = 20000;
+
+using Clock = std::chrono::steady_clock;
+
+
+/*========================= Function Definitions ==========================*/
+
+
+// command is the server path and its options, separated by spaces
+pid_t start_server(const char *command, const char *port)
+{
+    std::vector<std::string> words;
+    std::istringstream split(command);
+    std::string word;
+    while(split >> word){
+        words.push_back(word);
+    }
+    words.push_back(port);
+
+    std::vector<char*> args;
+    for(std::string &w : words){
+        args.push_back(&w[0]);
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if(pid == 0){
+        int null = open("/dev/null", O_WRONLY);
+        if(null != -1){
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+        execv(args[0], args.data());
+        _exit(127);
+    }
+    return pid;
+}
+
+
+// connects to 127.0.0.1:port from 127.0.0.<source>, -1 upon failure
+int connect_from(int source, uint16_t port)
+{
+    struct sockaddr_in local;
+    struct sockaddr_in remote;
+    int one = 1;
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(fd == -1){
+        return -1;
+    }
+
+    /** IP_BIND_ADDRESS_NO_PORT leaves the port to connect, which picks
+    *   one unique for the whole address pair, instead of reserving it at
+    *   bind for every destination.
+    */
+    setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK + uint32_t(source) - 1);
+
+    memset(&remote, 0, sizeof(remote));
+    remote.sin_family = AF_INET;
+    remote.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    remote.sin_port = htons(port);
+
+    if(bind(fd, (struct sockaddr*)&local, sizeof(local)) != 0 ||
+            connect(fd, (struct sockaddr*)&remote, sizeof(remote)) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+// reads exactly len bytes, false when the connection failed
+bool receive_all(int fd, uint8_t *buf, size_t len)
+{
+    size_t received = 0;
+    while(received < len){
+        ssize_t n = recv(fd, buf + received, len - received, 0);
+        if(n <= 0){
+            return false;
+        }
+        received += size_t(n);
+    }
+    return true;
+}
+
+
+// VmRSS of a process in kilobytes
+long resident_kb(pid_t pid)
+{
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+
+    while(std::getline(status, line)){
+        if(line.compare(0, 6, "VmRSS:") == 0){
+            return atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+
+/* Kernel slab memory in kilobytes, system wide: sockets, their files
+*  and epoll entries. Socket buffers are charged only while data waits
+*  in them, an idle connection holds none.
+*/
+long slab_kb()
+{
+    std::ifstream meminfo("/proc/meminfo");
+    std::string line;
+
+    while(std::getline(meminfo, line)){
+        if(line.compare(0, 5, "Slab:") == 0){
+            return atol(line.c_str() + 5);
+        }
+    }
+    return 0;
+}
+
+
+double percentile(std::vector<double> &sorted, double p)
+{
+    size_t index = size_t(p * double(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <eserver path> <port> <connections> <round trips>", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[1];
+    const char *port = argv[2];
+    int numConnections = atoi(argv[3]);
+    int rounds = atoi(argv[4]);
+
+    if(numConnections < 1 || rounds < 1){
+        log_error("connections and round trips must be positive");
+        return 1;
+    }
+
+    // as many descriptors as the hard limit allows
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0){
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if(rlim_t(numConnections) + 16 > limit.rlim_cur){
+        log_error("%d connections need more descriptors than the limit of %lu",
+                    numConnections, (unsigned long)limit.rlim_cur);
+        return 1;
+    }
+
+    pid_t server = start_server(path, port);
+    if(server == -1){
+        log_error("fork failed");
+        return 1;
+    }
+
+    // wait for the server to listen
+    uint16_t portNumber = uint16_t(atoi(port));
+    int probe;
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(START_TIMEOUT_MS);
+    while((probe = connect_from(1, portNumber)) == -1){
+        if(Clock::now() > deadline || waitpid(server, NULL, WNOHANG) == server){
+            log_error("server %s did not start", path);
+            kill(server, SIGKILL);
+            return 1;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    close(probe);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    long rssStart = resident_kb(server);
+    long slabStart = slab_kb();
+
+    std::vector<int> fds;
+    fds.reserve(size_t(numConnections));
+
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < numConnections; ++i){
+        int fd = connect_from(1 + i / CONNECTIONS_PER_SOURCE, portNumber);
+        if(fd == -1){
+            log_error("connection %d failed, %s", i, strerror(errno));
+            break;
+        }
+        fds.push_back(fd);
+    }
+    double connectSec = std::chrono::duration<double>(Clock::now() - start).count();
+
+    // one echo on every connection, all in flight at once
+    uint8_t message[MESSAGE_SIZE];
+    uint8_t echo[MESSAGE_SIZE];
+    memset(message, 'x', MESSAGE_SIZE);
+
+    int failed = 0;
+    start = Clock::now();
+    for(int fd : fds){
+        if(send(fd, message, 1, MSG_NOSIGNAL) != 1){
+            ++failed;
+        }
+    }
+    for(int fd : fds){
+        if(!receive_all(fd, echo, 1)){
+            ++failed;
+        }
+    }
+    double sweepMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    long rssEnd = resident_kb(server);
+    long slabEnd = slab_kb();
+
+    // round trips on random connections
+    std::mt19937 rng(1);
+    std::vector<double> rttUs;
+    rttUs.reserve(size_t(rounds));
+
+    for(int i = 0; i < rounds && !fds.empty(); ++i){
+        int fd = fds[rng() % fds.size()];
+        Clock::time_point sent = Clock::now();
+        if(send(fd, message, MESSAGE_SIZE, MSG_NOSIGNAL) != ssize_t(MESSAGE_SIZE) ||
+                !receive_all(fd, echo, MESSAGE_SIZE)){
+            ++failed;
+            continue;
+        }
+        rttUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+    }
+    std::sort(rttUs.begin(), rttUs.end());
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    for(int fd : fds){
+        close(fd);
+    }
+
+    double n = double(fds.empty() ? 1 : fds.size());
+    printf("connections       %10lu   (%.0f/sec)\n", fds.size(), double(fds.size()) / connectSec);
+    printf("sweep             %10.1f ms, one echo on every connection\n", sweepMs);
+    printf("server rss        %10.0f bytes/connection\n", double(rssEnd - rssStart) * 1024.0 / n);
+    printf("kernel slab       %10.0f bytes/connection, both ends\n",
+            double(slabEnd - slabStart) * 1024.0 / n);
+
+    if(!rttUs.empty()){
+        printf("round trip us     p50 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+                percentile(rttUs, 0.50), percentile(rttUs, 0.99),
+                percentile(rttUs, 0.999), rttUs.back());
+    }
+
+    if(failed > 0 || int(fds.size()) != numConnections){
+        log_error("%d echoes failed, %lu of %d connected", failed, fds.size(), numConnections);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,213 @@
+/* Purpose:
+*   Measure how accept rate and echo message rate scale with the
+*   number of ShardedServer threads.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each run uses the next port
+*   argv[2]  maximum number of server threads
+*   argv[3]  connections per run
+*   argv[4]  messages per connection
+*
+*  Description:
+*
+*   for thread count 1, 2, 4, ... up to the maximum
+*       start a ShardedServer echo server with that many shards
+*       the same number of client threads open all connections,
+*           accepts/sec = connections / time until all were accepted
+*       each client thread sends one message on each of its connections
+*       and waits for every echo, repeated for the message count,
+*           msgs/sec = echoed messages / elapsed time
+*       print accepted connections per shard to show the distribution
+*
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/socketClient.h>
+#include <mysocket/shardedServer.h>
+
+constexpr int MESSAGE_SIZE = 32;
+constexpr int MAX_SHARDS = 64;
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+/*============== Global Variable Declarations =============================*/
+
+static std::atomic<int> acceptedTotal;
+static std::atomic<int> acceptedPerShard[MAX_SHARDS];
+
+
+/*========================= Function Definitions ==========================*/
+
+
+// echo every byte received, runs on the shard's own thread
+void echo_connection(EventLoop &loop, int fd)
+{
+    uint8_t buffer[4096];
+
+    for(;;){
+        ssize_t bytesRead = recv(fd, buffer, sizeof(buffer), 0);
+        if(bytesRead > 0){
+            // messages are tiny, the socket buffer never fills here
+            send(fd, buffer, size_t(bytesRead), MSG_NOSIGNAL);
+            continue;
+        }
+        if(bytesRead == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)){
+            loop.remove(fd);
+            close(fd);
+        }
+        break;
+    }
+}
+
+
+void init_shard(ShardedServer::shard_t &shard)
+{
+    int listenfd = shard.server.get_fd();
+    EventLoop *loop = &shard.loop;
+    int index = shard.index;
+
+    loop->add(listenfd, EventLoop::READ, [loop, index](int fd, uint32_t){
+        // drain the accept queue, edge triggered
+        for(;;){
+            int connfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(connfd == -1){
+                break;
+            }
+            acceptedPerShard[index]++;
+            acceptedTotal++;
+            loop->add(connfd, EventLoop::READ, [loop](int cfd, uint32_t){
+                echo_connection(*loop, cfd);
+            });
+        }
+    });
+}
+
+
+void run_client(const char *port, int numConnections, int numMessages,
+                std::atomic<long> *echoed, std::atomic<bool> *go)
+{
+    std::vector<std::unique_ptr<SocketClient>> clients;
+    uint8_t message[MESSAGE_SIZE] = {0};
+    uint8_t reply[MESSAGE_SIZE];
+
+    for(int i = 0; i < numConnections; ++i){
+        std::unique_ptr<SocketClient> client(new SocketClient());
+        if(client->connect_client(port, "127.0.0.1") == 0){
+            clients.push_back(std::move(client));
+        }
+    }
+
+    while(!go->load()){
+        std::this_thread::yield();
+    }
+
+    for(int m = 0; m < numMessages; ++m){
+        for(auto &client : clients){
+            client->send_data(client->get_fd(), message, MESSAGE_SIZE);
+        }
+        for(auto &client : clients){
+            ssize_t received = 0;
+            while(received < MESSAGE_SIZE){
+                ssize_t n = client->receive_data(client->get_fd(), reply + received,
+                                size_t(MESSAGE_SIZE - received));
+                if(n <= 0){
+                    break;
+                }
+                received += n;
+            }
+            if(received == MESSAGE_SIZE){
+                (*echoed)++;
+            }
+        }
+    }
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <first port> <max threads> <connections> <messages>", argv[0]);
+        return 1;
+    }
+
+    int firstPort = atoi(argv[1]);
+    int maxThreads = atoi(argv[2]);
+    int numConnections = atoi(argv[3]);
+    int numMessages = atoi(argv[4]);
+
+    if(maxThreads > MAX_SHARDS){
+        maxThreads = MAX_SHARDS;
+    }
+
+    printf("%8s %14s %14s   %s\n", "threads", "accepts/sec", "msgs/sec", "accepted per shard");
+
+    int run = 0;
+    for(int threads = 1; threads <= maxThreads; threads *= 2, ++run){
+
+        std::string port = std::to_string(firstPort + run);
+        ShardedServer server;
+
+        acceptedTotal = 0;
+        for(int i = 0; i < MAX_SHARDS; ++i){
+            acceptedPerShard[i] = 0;
+        }
+
+        if(server.start(port.c_str(), threads, SOMAXCONN, true, init_shard) != 0){
+            log_fatal("server start failure, port %s", port.c_str());
+            return 1;
+        }
+
+        std::atomic<long> echoed(0);
+        std::atomic<bool> go(false);
+        std::vector<std::thread> clientThreads;
+
+        // accept phase
+        Clock::time_point start = Clock::now();
+        for(int t = 0; t < threads; ++t){
+            int share = numConnections / threads + (t < numConnections % threads ? 1 : 0);
+            clientThreads.emplace_back(run_client, port.c_str(), share, numMessages,
+                                        &echoed, &go);
+        }
+        while(acceptedTotal.load() < numConnections &&
+                Clock::now() - start < std::chrono::seconds(30)){
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        double acceptSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        // message phase
+        start = Clock::now();
+        go = true;
+        for(auto &t : clientThreads){
+            t.join();
+        }
+        double messageSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        server.stop();
+
+        std::string distribution;
+        for(int i = 0; i < threads; ++i){
+            distribution += std::to_string(acceptedPerShard[i].load()) + " ";
+        }
+
+        printf("%8d %14.0f %14.0f   %s\n", threads, acceptedTotal.load() / acceptSeconds,
+                    double(echoed.load()) / messageSeconds, distribution.c_str());
+    }
+
+    return 0;
+}
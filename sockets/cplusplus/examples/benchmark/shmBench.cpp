@@ -0,0 +1,251 @@
+/* Purpose:
+*   Message rate and round trip time between two processes through
+*   ShmChannel (shared memory rings with futex wakeups), against a
+*   SOCK_SEQPACKET unix socket carrying the same messages.
+*
+*  Command line arguments:
+*   argv[1]  number of messages streamed
+*   argv[2]  message size in bytes
+*   argv[3]  number of round trips
+*   argv[4]  spin time in microseconds before sleeping, -1 for the default
+*            (ShmChannel only)
+*
+*  Description:
+*
+*   for each transport (unixpacket, shm):
+*       the parent listens on an abstract unix address and forks a child
+*           that connects to it
+*       for shm, the parent offers a ShmChannel over the connection and
+*           the child accepts it
+*       the child streams the messages, the parent receives them all
+*       then the parent sends a message, the child echoes it back, and
+*           the parent records the round trip time
+*
+*   prints messages/sec, p50/p99 round trip in microseconds and the
+*   number of futex wake calls the parent made
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>           // waitpid
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/shmChannel.h>
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double messagesPerSec;
+    double p50Us;
+    double p99Us;
+    uint64_t wakeups;
+};
+
+
+struct config_t{
+    int messages;
+    int size;
+    int roundTrips;
+    int spinUs;
+};
+
+
+/*  The same interface over a unix socket, one system call per message. */
+class SocketTransport{
+    public:
+
+    explicit SocketTransport(int socketfd) : fd(socketfd){}
+
+    int send(const void *buf, uint32_t len){
+        return ::send(fd, buf, len, MSG_NOSIGNAL) == ssize_t(len) ? 0 : -1;
+    }
+
+    ssize_t receive(void *buf, size_t len){
+        return recv(fd, buf, len, 0);
+    }
+
+    uint64_t get_wakeups(){return 0;}
+
+    private:
+        int fd;
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+double percentile(std::vector<double> &samples, double p)
+{
+    if(samples.empty()){
+        return 0.0;
+    }
+    size_t index = size_t(p * double(samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + long(index), samples.end());
+    return samples[index];
+}
+
+
+// child side: stream, then echo
+template <typename Transport>
+void child_work(Transport &t, const config_t &cfg)
+{
+    std::vector<uint8_t> message(static_cast<size_t>(cfg.size), 0x3c);
+
+    for(int i = 0; i < cfg.messages; ++i){
+        if(t.send(message.data(), uint32_t(message.size())) != 0){
+            return;
+        }
+    }
+    for(int i = 0; i < cfg.roundTrips; ++i){
+        ssize_t n = t.receive(message.data(), message.size());
+        if(n <= 0 || t.send(message.data(), uint32_t(n)) != 0){
+            return;
+        }
+    }
+}
+
+
+// parent side: receive the stream, then time the round trips
+template <typename Transport>
+result_t parent_work(Transport &t, const config_t &cfg)
+{
+    result_t result = {0.0, 0.0, 0.0, 0};
+    std::vector<uint8_t> message(static_cast<size_t>(cfg.size), 0x5a);
+
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < cfg.messages; ++i){
+        if(t.receive(message.data(), message.size()) <= 0){
+            log_error("stream ended after %d messages", i);
+            return result;
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.messagesPerSec = seconds > 0 ? double(cfg.messages) / seconds : 0.0;
+
+    std::vector<double> samples;
+    samples.reserve(size_t(cfg.roundTrips));
+    for(int i = 0; i < cfg.roundTrips; ++i){
+        Clock::time_point sent = Clock::now();
+        if(t.send(message.data(), uint32_t(message.size())) != 0 ||
+                t.receive(message.data(), message.size()) <= 0){
+            break;
+        }
+        samples.push_back(std::chrono::duration<double, std::micro>(
+                            Clock::now() - sent).count());
+    }
+
+    result.p50Us = percentile(samples, 0.50);
+    result.p99Us = percentile(samples, 0.99);
+    result.wakeups = t.get_wakeups();
+    return result;
+}
+
+
+result_t run(bool useShm, const config_t &cfg)
+{
+    result_t result = {0.0, 0.0, 0.0, 0};
+    std::string address = "unixpacket:@shmbench." + std::to_string(getpid())
+                        + (useShm ? ".shm" : ".sock");
+
+    SocketServer server;
+    if(server.initialize(address.c_str(), SocketServer::AUTO_BACKLOG) != 0){
+        return result;
+    }
+
+    pid_t child = fork();
+    if(child == -1){
+        log_error("fork failed");
+        return result;
+    }
+
+    if(child == 0){
+        server.close_socket();
+
+        SocketClient client;
+        if(client.connect_client(address.c_str(), "") != 0){
+            _exit(1);
+        }
+        if(useShm){
+            ShmChannel channel;
+            if(channel.accept(client.get_fd()) != 0){
+                _exit(1);
+            }
+            if(cfg.spinUs >= 0){
+                channel.set_spin(cfg.spinUs);
+            }
+            child_work(channel, cfg);
+        }
+        else{
+            SocketTransport transport(client.get_fd());
+            child_work(transport, cfg);
+        }
+        _exit(0);
+    }
+
+    client_info_t peer;
+    if(server.accept_client_connection(&peer) == 0){
+        if(useShm){
+            ShmChannel channel;
+            if(channel.offer(peer.fd) == 0){
+                if(cfg.spinUs >= 0){
+                    channel.set_spin(cfg.spinUs);
+                }
+                result = parent_work(channel, cfg);
+            }
+        }
+        else{
+            SocketTransport transport(peer.fd);
+            result = parent_work(transport, cfg);
+        }
+        close(peer.fd);
+    }
+
+    waitpid(child, NULL, 0);
+    return result;
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <messages> <message size> <round trips> <spin us>", argv[0]);
+        return 1;
+    }
+
+    config_t cfg;
+    cfg.messages = atoi(argv[1]);
+    cfg.size = atoi(argv[2]);
+    cfg.roundTrips = atoi(argv[3]);
+    cfg.spinUs = atoi(argv[4]);
+
+    if(cfg.messages < 1 || cfg.size < 1 || cfg.roundTrips < 1){
+        log_error("messages, message size and round trips must be positive");
+        return 1;
+    }
+
+    printf("%-12s %12s %10s %10s %10s\n", "transport", "msgs/sec", "p50 us", "p99 us",
+            "wakeups");
+
+    result_t r = run(false, cfg);
+    printf("%-12s %12.0f %10.1f %10.1f %10s\n", "unixpacket", r.messagesPerSec,
+            r.p50Us, r.p99Us, "-");
+
+    r = run(true, cfg);
+    printf("%-12s %12.0f %10.1f %10.1f %10llu\n", "shm", r.messagesPerSec,
+            r.p50Us, r.p99Us, (unsigned long long)r.wakeups);
+
+    return 0;
+}
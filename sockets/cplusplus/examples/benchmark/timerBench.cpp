@@ -0,0 +1,210 @@
+/* Purpose:
+*   Cost of per-connection timers with TimerWheel against an ordered
+*   std::multimap, the structure the coroutine Scheduler uses.
+*
+*  Command line arguments:
+*   argv[1]  number of timers, one per simulated connection
+*   argv[2]  rounds of activity, each pushes back every idle timer
+*   argv[3]  idle timeout in milliseconds
+*
+*  Description:
+*
+*   for each structure (multimap, wheel):
+*       arms one idle timer per connection, spread over the timeout
+*       each round pushes every timer back to a full timeout from now,
+*           as a server does when a connection receives data
+*       expires everything that became due in between
+*       cancels half of the timers, as for closed connections
+*       lets the rest run out and checks that none fired early
+*
+*   prints nanoseconds per arm, per push back and per cancel, the
+*   wait until the remaining timers fired and how late the latest was
+*/
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <functional>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/timerWheel.h>
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    double armNs;
+    double pushNs;
+    double cancelNs;
+    int fired;
+    int early;
+    double maxLateMs;
+};
+
+
+/*  The same operations on a multimap keyed by expiry, one node
+*   allocation and an O(log n) search per arm.
+*/
+class MapTimers{
+    public:
+
+    using Map = std::multimap<Clock::time_point, std::function<void()>>;
+    using timer_id_t = Map::iterator;
+
+    timer_id_t schedule(int delayMs, std::function<void()> cb){
+        return timers.emplace(Clock::now() + std::chrono::milliseconds(delayMs), std::move(cb));
+    }
+
+    timer_id_t reschedule(timer_id_t id, int delayMs){
+        std::function<void()> cb = std::move(id->second);
+        timers.erase(id);
+        return schedule(delayMs, std::move(cb));
+    }
+
+    void cancel(timer_id_t id){timers.erase(id);}
+
+    int expire(){
+        Clock::time_point now = Clock::now();
+        int ran = 0;
+        while(!timers.empty() && timers.begin()->first <= now){
+            std::function<void()> cb = std::move(timers.begin()->second);
+            timers.erase(timers.begin());
+            cb();
+            ++ran;
+        }
+        return ran;
+    }
+
+    size_t size(){return timers.size();}
+
+    private:
+        Map timers;
+};
+
+
+/*  Adapts TimerWheel to the calls above. */
+class WheelTimers{
+    public:
+
+    using timer_id_t = TimerWheel::timer_id_t;
+
+    timer_id_t schedule(int delayMs, std::function<void()> cb){
+        return wheel.schedule(delayMs, std::move(cb));
+    }
+
+    timer_id_t reschedule(timer_id_t id, int delayMs){
+        wheel.reschedule(id, delayMs);
+        return id;
+    }
+
+    void cancel(timer_id_t id){wheel.cancel(id);}
+    int expire(){return wheel.expire();}
+    size_t size(){return wheel.size();}
+
+    private:
+        TimerWheel wheel;
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+double elapsed_ns(Clock::time_point start, int operations)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count()
+            / double(operations);
+}
+
+
+template <typename Timers>
+result_t run(int numTimers, int rounds, int timeoutMs)
+{
+    result_t result = {0.0, 0.0, 0.0, 0, 0, 0.0};
+    Timers timers;
+    std::vector<typename Timers::timer_id_t> ids;
+    std::vector<Clock::time_point> due(static_cast<size_t>(numTimers));
+    ids.reserve(size_t(numTimers));
+
+    auto fired = [&](int i){
+        double lateMs = std::chrono::duration<double, std::milli>(
+                            Clock::now() - due[size_t(i)]).count();
+        if(lateMs < 0){
+            ++result.early;
+        }
+        if(lateMs > result.maxLateMs){
+            result.maxLateMs = lateMs;
+        }
+        ++result.fired;
+    };
+
+    Clock::time_point start = Clock::now();
+    for(int i = 0; i < numTimers; ++i){
+        int delay = timeoutMs + i % timeoutMs;
+        due[size_t(i)] = Clock::now() + std::chrono::milliseconds(delay);
+        ids.push_back(timers.schedule(delay, [&fired, i]{fired(i);}));
+    }
+    result.armNs = elapsed_ns(start, numTimers);
+
+    // activity on every connection, a full timeout from now each time
+    start = Clock::now();
+    for(int r = 0; r < rounds; ++r){
+        for(int i = 0; i < numTimers; ++i){
+            due[size_t(i)] = Clock::now() + std::chrono::milliseconds(timeoutMs);
+            ids[size_t(i)] = timers.reschedule(ids[size_t(i)], timeoutMs);
+        }
+        timers.expire();
+    }
+    result.pushNs = elapsed_ns(start, numTimers * rounds);
+
+    // half the connections close
+    start = Clock::now();
+    for(int i = 0; i < numTimers; i += 2){
+        timers.cancel(ids[size_t(i)]);
+    }
+    result.cancelNs = elapsed_ns(start, (numTimers + 1) / 2);
+
+    while(timers.size() > 0){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        timers.expire();
+    }
+    return result;
+}
+
+
+void print(const char *name, const result_t &r)
+{
+    printf("%-10s %10.0f %10.0f %10.0f %10d %8d %12.1f\n", name, r.armNs, r.pushNs,
+            r.cancelNs, r.fired, r.early, r.maxLateMs);
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 4){
+        log_error("usage: %s <timers> <rounds> <timeout ms>", argv[0]);
+        return 1;
+    }
+
+    int numTimers = atoi(argv[1]);
+    int rounds = atoi(argv[2]);
+    int timeoutMs = atoi(argv[3]);
+
+    if(numTimers < 1 || rounds < 0 || timeoutMs < 1){
+        log_error("timers and timeout must be positive");
+        return 1;
+    }
+
+    printf("%-10s %10s %10s %10s %10s %8s %12s\n", "timers", "arm ns", "push ns",
+            "cancel ns", "fired", "early", "max late ms");
+
+    print("multimap", run<MapTimers>(numTimers, rounds, timeoutMs));
+    print("wheel", run<WheelTimers>(numTimers, rounds, timeoutMs));
+
+    return 0;
+}
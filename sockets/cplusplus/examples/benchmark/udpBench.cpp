@@ -0,0 +1,295 @@
+/* Purpose:
+*   Compare echo throughput of the batched DatagramServer with the
+*   per-message TCP path of SocketServer over loopback.
+*
+*  Command line arguments:
+*   argv[1]  first port number, each run uses the next port
+*   argv[2]  number of messages per run
+*   argv[3]  message size in bytes
+*   argv[4]  window, messages sent before waiting for their echoes
+*
+*  Description:
+*
+*   runs, each with an echo server on its own thread:
+*       udp batch 1     DatagramServer with batch size 1, one system call
+*                       per datagram in each direction
+*       udp batch 64    recvmmsg/sendmmsg, up to 64 datagrams per call
+*       udp gro+gso     batch 64 with UDP_GRO receive coalescing, replies
+*                       sent with UDP_SEGMENT
+*       tcp             SocketServer, recv/send per readiness
+*
+*   the client sends a window of messages, then waits for their echoes.
+*   UDP may drop datagrams, lost ones are counted and reported.
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>              // atoi
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>       // TCP_NODELAY
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/datagramServer.h>
+#include <mysocket/socketClient.h>
+#include <mysocket/socketServer.h>
+
+using namespace mysocket;
+using Clock = std::chrono::steady_clock;
+
+
+struct result_t{
+    long received;
+    double seconds;
+};
+
+
+/*========================= Function Definitions ==========================*/
+
+
+void set_receive_timeout(int fd, int ms)
+{
+    struct timeval tv;
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+
+// without it Nagle holds back the echo of a partial window
+void set_no_delay(int fd)
+{
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+}
+
+
+void udp_echo(DatagramServer *server, std::atomic<bool> *stop)
+{
+    while(!stop->load()){
+        int count = server->receive_batch();
+        if(count <= 0){
+            continue;           // receive timeout, check stop flag
+        }
+
+        for(int i = 0; i < count; ++i){
+            datagram_t &d = server->get_datagram(i);
+            if(d.truncated){
+                continue;       // a partial echo would only fail the check
+            }
+            if(d.segmentSize != 0 && d.length > d.segmentSize){
+                // coalesced by GRO, send back as the same datagrams
+                server->send_segmented(d.data, d.length, d.segmentSize,
+                                        d.address, d.addressLength);
+            }
+            else{
+                server->queue_send(d.data, d.length, d.address, d.addressLength);
+            }
+        }
+        server->flush();
+    }
+}
+
+
+result_t udp_client(const char *port, int numMessages, int size, int window)
+{
+    struct addrinfo hints, *info;
+    result_t result = {0, 0.0};
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if(getaddrinfo("127.0.0.1", port, &hints, &info) != 0){
+        return result;
+    }
+
+    int fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    connect(fd, info->ai_addr, info->ai_addrlen);
+    freeaddrinfo(info);
+    set_receive_timeout(fd, 100);
+
+    std::vector<uint8_t> out(size_t(size) * size_t(window), 0x5a);
+    std::vector<uint8_t> in(out.size());
+    std::vector<struct mmsghdr> headers{size_t(window)};
+    std::vector<struct iovec> iov{size_t(window)};
+
+    Clock::time_point start = Clock::now();
+    int sent = 0;
+    while(sent < numMessages){
+        int n = window < numMessages - sent ? window : numMessages - sent;
+
+        for(int i = 0; i < n; ++i){
+            iov[size_t(i)].iov_base = &out[size_t(i) * size_t(size)];
+            iov[size_t(i)].iov_len = size_t(size);
+            memset(&headers[size_t(i)], 0, sizeof(struct mmsghdr));
+            headers[size_t(i)].msg_hdr.msg_iov = &iov[size_t(i)];
+            headers[size_t(i)].msg_hdr.msg_iovlen = 1;
+        }
+        sendmmsg(fd, headers.data(), unsigned(n), 0);
+        sent += n;
+
+        int got = 0;
+        while(got < n){
+            for(int i = 0; i < n - got; ++i){
+                iov[size_t(i)].iov_base = &in[size_t(i) * size_t(size)];
+                iov[size_t(i)].iov_len = size_t(size);
+                memset(&headers[size_t(i)], 0, sizeof(struct mmsghdr));
+                headers[size_t(i)].msg_hdr.msg_iov = &iov[size_t(i)];
+                headers[size_t(i)].msg_hdr.msg_iovlen = 1;
+            }
+            int rv = recvmmsg(fd, headers.data(), unsigned(n - got), MSG_WAITFORONE, NULL);
+            if(rv <= 0){
+                break;          // timed out, the rest were dropped
+            }
+            got += rv;
+        }
+        result.received += got;
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    close(fd);
+    return result;
+}
+
+
+result_t run_udp(const char *port, int batch, bool offload, int numMessages,
+                int size, int window)
+{
+    result_t result = {0, 0.0};
+    DatagramServer server(batch);
+    std::atomic<bool> stop(false);
+
+    if(server.initialize(port) != 0){
+        return result;
+    }
+    if(offload && server.enable_gro() != 0){
+        log_warn("UDP_GRO unavailable");
+    }
+    set_receive_timeout(server.get_fd(), 100);
+
+    std::thread echo(udp_echo, &server, &stop);
+    result = udp_client(port, numMessages, size, window);
+    stop = true;
+    echo.join();
+    return result;
+}
+
+
+result_t run_tcp(const char *port, int numMessages, int size, int window)
+{
+    result_t result = {0, 0.0};
+    SocketServer server;
+
+    if(server.initialize(port, SocketServer::AUTO_BACKLOG) != 0){
+        return result;
+    }
+
+    std::thread echo([&server](){
+        client_info_t client;
+        uint8_t buffer[SocketServer::RECEIVE_BUFFER_LENGTH];
+        if(server.accept_client_connection(&client) != 0){
+            return;
+        }
+        set_no_delay(client.fd);
+        for(;;){
+            ssize_t n = server.receive_data(client.fd, buffer, sizeof(buffer));
+            if(n <= 0){
+                break;
+            }
+            server.send_data(client.fd, buffer, size_t(n));
+        }
+        close(client.fd);
+    });
+
+    SocketClient client;
+    if(client.connect_client(port, "127.0.0.1") != 0){
+        echo.join();
+        return result;
+    }
+    set_no_delay(client.get_fd());
+
+    std::vector<uint8_t> out(size_t(size) * size_t(window), 0x5a);
+    std::vector<uint8_t> in(out.size());
+
+    Clock::time_point start = Clock::now();
+    int sent = 0;
+    while(sent < numMessages){
+        int n = window < numMessages - sent ? window : numMessages - sent;
+        size_t bytes = size_t(n) * size_t(size);
+
+        client.send_data(client.get_fd(), out.data(), bytes);
+        sent += n;
+
+        size_t got = 0;
+        while(got < bytes){
+            ssize_t rv = client.receive_data(client.get_fd(), in.data() + got, bytes - got);
+            if(rv <= 0){
+                break;
+            }
+            got += size_t(rv);
+        }
+        result.received += long(got / size_t(size));
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    client.close_socket();
+    echo.join();
+    return result;
+}
+
+
+void print_result(const char *name, const result_t &r, int numMessages)
+{
+    printf("%-14s %14.0f %10ld\n", name, r.seconds > 0 ? double(r.received) / r.seconds : 0.0,
+            long(numMessages) - r.received);
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_WARN, LOG_OFF, 1);
+
+    if(argc < 5){
+        log_error("usage: %s <first port> <messages> <message size> <window>", argv[0]);
+        return 1;
+    }
+
+    int firstPort = atoi(argv[1]);
+    int numMessages = atoi(argv[2]);
+    int size = atoi(argv[3]);
+    int window = atoi(argv[4]);
+
+    if(size < 1 || size > int(DatagramServer::DATAGRAM_BUFFER_SIZE) || window < 1){
+        log_error("message size must be 1 to %d bytes, window at least 1",
+                    int(DatagramServer::DATAGRAM_BUFFER_SIZE));
+        return 1;
+    }
+
+    printf("%-14s %14s %10s\n", "path", "msgs/sec", "lost");
+
+    std::string port = std::to_string(firstPort);
+    print_result("udp batch 1", run_udp(port.c_str(), 1, false, numMessages, size, window),
+                    numMessages);
+
+    port = std::to_string(firstPort + 1);
+    print_result("udp batch 64", run_udp(port.c_str(), 64, false, numMessages, size, window),
+                    numMessages);
+
+    port = std::to_string(firstPort + 2);
+    print_result("udp gro+gso", run_udp(port.c_str(), 64, true, numMessages, size, window),
+                    numMessages);
+
+    port = std::to_string(firstPort + 3);
+    print_result("tcp", run_tcp(port.c_str(), numMessages, size, window), numMessages);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/**
+* @file coEchoServer.cpp
+*
+* @brief Echo server written with coroutines. Each connection is one
+*        straight-line function; all of them run on a single thread.
+*
+*
+*   Usage: ./coeserver <port number> [idle timeout seconds]
+*
+*       where
+*           coeserver is the executable file name
+*           port number is the service port number
+*           idle timeout closes a connection with no data for that long,
+*               default 60
+*
+*   Communication method: TCP sockets
+*
+*
+*   Order of operations:
+*
+*       initialize debug logging level
+*       verify minimum number of command line arguments
+*       initialize server socket
+*       spawn the accept loop
+*
+*       accept loop, for each connection
+*           spawn an echo coroutine
+*           on an accept error, sleep before trying again
+*
+*       echo coroutine
+*           read, suspending until data arrives or the idle timeout
+*           write everything back, suspending while the socket is full
+*
+*       run the scheduler
+*/
+#include <cstdlib>              // atoi
+#include <cerrno>
+
+#include <debuglog/debuglog.h>
+
+#include <mysocket/asyncSocket.h>
+#include <mysocket/scheduler.h>
+
+using namespace mysocket;
+
+
+/*============== Global Variable Declarations =============================*/
+
+static int idleTimeoutMs = 60000;
+
+// pause after an accept error, so a lasting one does not spin the loop
+static constexpr int ACCEPT_RETRY_MS = 1000;
+
+
+/*========================= Function Definitions ==========================*/
+
+
+Task<void> echo(AsyncConnection conn)
+{
+    uint8_t buffer[SocketServer::RECEIVE_BUFFER_LENGTH];
+
+    log_debug("fd %d connected", conn.get_fd());
+
+    for(;;){
+        ssize_t bytesRead = co_await conn.read_some(buffer, sizeof(buffer), idleTimeoutMs);
+        if(bytesRead <= 0){
+            if(bytesRead < 0 && errno == ETIMEDOUT){
+                log_info("fd %d idle, closing", conn.get_fd());
+            }
+            break;
+        }
+
+        if(co_await conn.write_all(buffer, size_t(bytesRead)) != bytesRead){
+            break;
+        }
+    }
+
+    log_debug("fd %d disconnected", conn.get_fd());
+}   // conn closes here
+
+
+Task<void> accept_loop(Scheduler &scheduler, AsyncServer &server)
+{
+    for(;;){
+        AsyncConnection conn = co_await server.accept();
+        if(conn.is_open()){
+            scheduler.spawn(echo(std::move(conn)));
+        }
+        else{
+            co_await scheduler.sleep_for(ACCEPT_RETRY_MS);
+        }
+    }
+}
+
+
+int main(int argc, char **argv){
+
+    log_init(LOG_INFO, LOG_OFF, 1);
+
+    if(argc < 2){
+        log_error("usage: %s <port number> [idle timeout seconds]", argv[0]);
+        return 1;
+    }
+    if(argc > 2){
+        idleTimeoutMs = atoi(argv[2]) * 1000;
+    }
+
+    Scheduler scheduler;
+    AsyncServer server(scheduler);
+
+    if(server.initialize(argv[1]) != 0){
+        log_fatal("server failed to initialize");
+        return 1;
+    }
+    log_info("listening on port %s", argv[1]);
+
+    scheduler.spawn(accept_loop(scheduler, server));
+    scheduler.run();
+
+    return 0;
+}
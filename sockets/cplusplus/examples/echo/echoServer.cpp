@@ -6,14 +6,33 @@
 *        echos any messages received back to the client.
 *
 *
-*   Usage: ./eserver <port number>
+*   Usage: ./eserver <port number> [-r <control address>] [-c] [-t <threads>]
 *
 *       where 
 *           eserver is the executable file name
 *           port number is the service port number
+*           -r  restartable: takes the listening socket over from the
+*               server running with the same control address, if there
+*               is one, and hands it on to the next one started with it.
+*               The control address is a unix address, e.g.
+*               unix:@eserver.9000
+*           -c  with -r, the connections that have no echo pending move
+*               to the new server as well, instead of being drained
+*           -t  thread per core: that many threads, each pinned to a cpu
+*               with its own SO_REUSEPORT listener, event loop and
+*               clients, at most one per online cpu. Not combined
+*               with -r.
+*
+*       Rolling restart without refused connections:
+*           ./eserver 9000 -r unix:@eserver.9000 &
+*           ./eserver 9000 -r unix:@eserver.9000 &     (takes over)
 *
 *   Communication method: TCP sockets
-*       
+*
+*       Readiness comes from epoll (EventLoop), which is not limited to
+*       FD_SETSIZE descriptors. The connection ceiling follows the open
+*       file limit, raised at start up to WANTED_FILE_LIMIT or as far as
+*       the hard limit allows (ulimit -Hn).
 *       
 *   Signal handling is implemented for SIGINT and SIGTERM
 *       ctrl+c produces the SIGINT
@@ -32,21 +51,44 @@
 *
 *       initialize debug logging level       
 *       verify minimum number of command line arguments 
-*       initialize server socket
+*       raise the open file limit, one descriptor per client
 *       register the signal handlers
+*
+*       with -t, start the shards, each runs the loop below on its own
+*           clients, and wait for a signal
+*
+*       take the listening socket over from the running server, or
+*           initialize server socket
+*       register the listener, and the handoff control socket, with the
+*           event loop
 *       
 *       while( no exit request from signal interrupt)
 *
-*           check for incoming client requests 
+*           wait for socket activity or the next timer, whichever is first
+*
 *           if connect request
-*               connect client
-*               add to connected client list
+*               accept every pending connection, rejecting those
+*               over the connection ceiling
+*               add admitted clients to the connection table and the
+*               event loop, arm an idle timer for each
+*
+*           a client with an echo pending is watched for writing only,
+*           every other client for reading only
 *
 *           if read request
-*               read message from client
-*               echo message back to client
+*               read messages from client until none is left, push back
+*               its idle timer
+*               echo each message back to client right away, if it cannot
+*               all be sent, keep the rest and arm a write deadline
 *
-*           remove any disconnected clients from list
+*           if write request
+*               send the rest of the pending echo
+*
+*           if a new server asks for a handoff
+*               pass the listening socket, stop accepting
+*               exit once the remaining clients are gone
+*
+*           close clients whose idle timeout or write deadline expired
 *      
 *       close socket connection
 *       
@@ -62,16 +104,21 @@
 *
 */
 
-#define _POSIX_C_SOURCE 200112L          // pselect
+#define _POSIX_C_SOURCE 200112L          // sigprocmask
 #define  _DEFAULT_SOURCE                 // psignal 
 
+#include <algorithm>                    // std::max
 #include <cerrno>
+#include <climits>                      // INT_MAX
 #include <cstdio>
+#include <cstdlib>                      // exit, strtol
 #include <iostream>
+#include <getopt.h>
 #include <signal.h>
 #include <string.h>
-#include <sys/select.h>
-#include <sys/time.h>
+#include <sys/resource.h>               // getrlimit, setrlimit
+#include <memory>
+#include <string>
 #include <vector>
 #include <unistd.h>
 
@@ -80,16 +127,76 @@
 #include <arpa/inet.h>
 
 #include <debuglog/debuglog.h>
+#include <mysocket/admissionController.h>
+#include <mysocket/bufferPool.h>
+#include <mysocket/connectionTable.h>
+#include <mysocket/eventLoop.h>
+#include <mysocket/listenerHandoff.h>
+#include <mysocket/shardedServer.h>
 #include <mysocket/socketServer.h>
+#include <mysocket/timerWheel.h>
+
+
+
+// each connection receives into a pool buffer of this size, and echoes
+// from it
+constexpr size_t RECEIVE_SIZE = 16384;
+
+// descriptors asked for at start up, one per client
+constexpr int WANTED_FILE_LIMIT = 131072;
 
+// descriptors kept out of the connection ceiling for stdin/out/err, the
+// listener, epoll, the handoff control socket and the debug log file
+constexpr int RESERVED_FDS = 16;
 
+// 0, no limit per source address
+constexpr int MAX_CONNECTIONS_PER_SOURCE = 0;
 
-constexpr int MAX_PENDING_CONNECTIONS = 3;
-constexpr int BUFFER_SIZE = 256;
+// a client that sends nothing for this long is disconnected
+constexpr int IDLE_TIMEOUT_MS = 60000;
+
+// a client that does not read its echo for this long is disconnected
+constexpr int WRITE_DEADLINE_MS = 10000;
+
+// longest event loop wait when no timer is due sooner
+constexpr int LOOP_TIMEOUT_MS = 5000;
+
+// after a handoff, clients still connected by then are closed
+constexpr int DRAIN_TIMEOUT_MS = 30000;
+
+
+// timers of one connection, 0 when not armed
+struct client_timers_t{
+    mysocket::TimerWheel::timer_id_t idle;
+    mysocket::TimerWheel::timer_id_t write;
+};
 
 
 using namespace mysocket;
 
+// one connected client
+struct connection_t{
+    client_info_t info;             // data holds the echo, numBytes its length
+    ssize_t sent;                   // bytes of the echo already sent
+    client_timers_t timers;
+};
+
+using client_table_t = ConnectionTable<connection_t>;
+
+// the clients of one event loop and what serving them takes. The server
+// runs one, or one per shard thread with -t
+struct echo_context_t{
+    EventLoop *loop;
+    SocketServer *server;               // receive_data and send_data
+    BufferPool *pool;                   // shared by the shards
+    AdmissionController admission;
+    client_table_t clients;             // by fd
+
+    echo_context_t(EventLoop &l, SocketServer &s, BufferPool &p,
+                   const admission_config_t &config)
+        : loop(&l), server(&s), pool(&p), admission(config){}
+};
+
 
 /*============== Global Variable Declarations =============================*/
 
@@ -134,6 +241,51 @@ static void signal_handler_term(int sig)
     
 }
 
+/**
+* @brief Raises the soft limit on open descriptors to wanted, and the hard
+*        limit with it when the process may (CAP_SYS_RESOURCE). Otherwise
+*        the soft limit goes as far as the hard limit allows.
+*
+* @return the soft limit now in effect, -1 upon failure
+*/
+int raise_file_limit(rlim_t wanted)
+{
+    struct rlimit limit;
+
+    /** int getrlimit(int resource, struct rlimit *rlim);
+    *
+    *   RLIMIT_NOFILE is one more than the largest descriptor the process
+    *   may open. rlim_cur, the soft limit, is enforced; an unprivileged
+    *   process may raise it up to rlim_max, the hard limit. Many systems
+    *   start processes with a soft limit of 1024.
+    */
+    if(getrlimit(RLIMIT_NOFILE, &limit) != 0){
+        std::cerr << "error: " << __func__ << ", getrlimit, "
+                << strerror(errno) << std::endl;
+        return -1;
+    }
+    if(limit.rlim_cur >= wanted){
+        return limit.rlim_cur > rlim_t(INT32_MAX) ? INT32_MAX : int(limit.rlim_cur);
+    }
+
+    struct rlimit raised;
+    raised.rlim_cur = wanted;
+    raised.rlim_max = limit.rlim_max > wanted ? limit.rlim_max : wanted;
+
+    // above the hard limit, or above fs.nr_open, fails with EPERM
+    if(setrlimit(RLIMIT_NOFILE, &raised) != 0){
+        raised.rlim_cur = limit.rlim_max;
+        raised.rlim_max = limit.rlim_max;
+        if(setrlimit(RLIMIT_NOFILE, &raised) != 0){
+            std::cerr << "error: " << __func__ << ", setrlimit, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+    }
+    return raised.rlim_cur > rlim_t(INT32_MAX) ? INT32_MAX : int(raised.rlim_cur);
+}
+
+
 void init_new_connection(client_info_t *cl)
 {
     cl->data = nullptr;
@@ -144,7 +296,7 @@ void init_new_connection(client_info_t *cl)
 
 void free_client_data(client_info_t *client)
 {
-    free(client->data);
+    BufferPool::release(client->data);
     client->data = nullptr;
     client->numBytes = 0;
     client->writeFlag = false;
@@ -152,55 +304,337 @@ void free_client_data(client_info_t *client)
 
 
 
-void build_client_list(std::vector<client_info_t> &clients)
+void cancel_client_timers(TimerWheel &timers, client_timers_t *t)
+{
+    timers.cancel(t->idle);
+    timers.cancel(t->write);
+    t->idle = 0;
+    t->write = 0;
+}
+
+
+
+/**
+* @brief Sends the client's pending echo, straight from the buffer it was
+*        received into. What the socket does not take stays pending, to
+*        be sent when the event loop reports the socket writable. The
+*        buffer is kept for the next receive.
+*
+* @return 0 when nothing is left pending, 1 when some is, -1 when the
+*         connection failed
+*/
+int flush_client(SocketServer &server, connection_t *conn)
+{
+    client_info_t *cl = &conn->info;
+
+    // send_data reports an error through errno only, a value left over
+    // from an earlier call must not pass for this one's EAGAIN
+    errno = 0;
+    ssize_t bytesSent = server.send_data(cl->fd, cl->data + conn->sent,
+                                         size_t(cl->numBytes - conn->sent));
+
+    // send_data stops at EAGAIN, a full socket buffer, or at an error
+    if(bytesSent == 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+        return -1;
+    }
+
+    conn->sent += bytesSent;
+    if(conn->sent == cl->numBytes){
+        log_trace("all bytes sent to client");
+        cl->numBytes = 0;
+        cl->writeFlag = false;
+        conn->sent = 0;
+        return 0;
+    }
+
+    log_trace("client fd: %d, %zd of %zd bytes sent", cl->fd, conn->sent, cl->numBytes);
+    return 1;
+}
+
+
+
+
+// printable source address of a client, inet_ntoa is not thread safe
+std::string client_address(const client_info_t *cl)
+{
+    char text[INET_ADDRSTRLEN];
+    if(inet_ntop(AF_INET, &cl->address.sin_addr, text, sizeof(text)) == NULL){
+        return "?";
+    }
+    return text;
+}
+
+
+
+// Close the socket and remove it from the table and the event loop
+void close_client(echo_context_t *ctx, int fd)
+{
+    connection_t *conn = ctx->clients.find(fd);
+    if(conn == nullptr){
+        return;
+    }
+    if(conn->info.data != nullptr){
+        free_client_data(&conn->info);
+    }
+    cancel_client_timers(ctx->loop->get_timers(), &conn->timers);
+    ctx->loop->remove(fd);
+    ctx->admission.release(fd);
+    close(fd);
+    ctx->clients.erase(fd);
+}
+
+
+
+// Timers hold the client's handle, the fd may have been reused by then
+void expire_client(echo_context_t *ctx, client_table_t::handle_t handle, const char *reason)
 {
-    // create a copy of clients
-    std::vector<client_info_t> temp(clients);
-                             
-    int length = int(temp.size());
-
-    // Removes all elements from the vector (which are destroyed), 
-    // leaving the container with a size of 0.
-    clients.clear();  
-
-    for(int i= 0; i < length; ++i){
-        
-        if(temp[i].fd != -1){
-            log_info("add client with fd: %d to list", temp[i].fd);
-            clients.push_back(temp[i]);
+    log_info("client fd: %d, %s", client_table_t::fd_of(handle), reason);
+    if(ctx->clients.get(handle) != nullptr){
+        close_client(ctx, client_table_t::fd_of(handle));
+    }
+}
+
+
+
+/**
+* @brief Readiness of one client. Edge-triggered epoll reports a socket
+*        once per change, so input is read until recv reports EAGAIN. A
+*        client whose echo did not fit in its socket buffer is watched for
+*        writing only, and not read meanwhile, which pushes back on a
+*        client that sends faster than it reads.
+*/
+void serve_client(echo_context_t *ctx, int fd, uint32_t events)
+{
+    TimerWheel &timers = ctx->loop->get_timers();
+    connection_t *conn = ctx->clients.find(fd);
+    if(conn == nullptr){
+        return;
+    }
+    client_info_t *cl = &conn->info;
+
+    // the rest of a pending echo, the socket has room again
+    if(cl->writeFlag){
+        log_trace("client fd: %d is writeable, events: %x", fd, events);
+
+        int flushed = flush_client(*ctx->server, conn);
+        if(flushed < 0){
+            log_info("client fd: %d, send failed", fd);
+            close_client(ctx, fd);
+        }
+        else if(flushed == 0){
+            timers.cancel(conn->timers.write);
+            conn->timers.write = 0;
+            free_client_data(cl);
+
+            // re-arming reports input that arrived meanwhile
+            ctx->loop->modify(fd, EventLoop::READ);
         }
-        else // temp[i].fd == -1), disconnected client
-        {
-            log_trace("detected fd -1, this client will be removed, index: %d", i);
-
-            // free data from disconnected clients
-            if(clients[i].data != nullptr){
-                log_trace("need to free client data");
-                free_client_data(&temp[i]);
+        return;
+    }
+
+    /* The data is received straight into the buffer it is echoed
+    *  from: no staging buffer to clear, no copy. The buffer is drawn
+    *  once per readiness event, from this thread's pool cache, and
+    *  reused for every receive until recv reports EAGAIN.
+    */
+    if(cl->data == nullptr){
+        cl->data = static_cast<uint8_t*>(ctx->pool->allocate(RECEIVE_SIZE));
+        if(cl->data == nullptr){
+            log_error("client fd: %d, buffer pool allocation failed", fd);
+            close_client(ctx, fd);
+            return;
+        }
+    }
+
+    while(true){
+        ssize_t bytesRead = ctx->server->receive_data(fd, cl->data, RECEIVE_SIZE);
+
+        log_trace("bytesRead: %zd", bytesRead);
+        log_trace("client fd: %d", fd);
+
+        if(bytesRead > 0){
+            timers.reschedule(conn->timers.idle, IDLE_TIMEOUT_MS);
+            cl->numBytes = bytesRead;
+
+            // this is an echo server, the read drives the write: the
+            // echo goes out now
+            int flushed = flush_client(*ctx->server, conn);
+            if(flushed < 0){
+                log_info("client fd: %d, send failed", fd);
+                close_client(ctx, fd);
+                return;
             }
+            if(flushed > 0){
+                // set write flag so that the rest will be echoed
+                // when the socket is writable, within the deadline
+                cl->writeFlag = true;
+                client_table_t::handle_t handle = ctx->clients.get_handle(fd);
+                conn->timers.write = timers.schedule(WRITE_DEADLINE_MS, [ctx, handle]{
+                    expire_client(ctx, handle, "write deadline missed");
+                });
+                ctx->loop->modify(fd, EventLoop::WRITE);
+                return;
+            }
+        }
+        else if(bytesRead == 0){ // disconnected
+            log_debug("Disconnected from ip %s, port %d",  
+                  client_address(cl).c_str(), ntohs(cl->address.sin_port));
+            
+            close_client(ctx, fd);
+            return;
+        }
+        else if(errno == EINTR){
+            continue;
+        }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK){
+            // read everything there was, an idle client holds no buffer
+            free_client_data(cl);
+            return;
+        }
+        else{
+            log_info("client fd: %d, receive failed, %s", fd, strerror(errno));
+            close_client(ctx, fd);
+            return;
         }
     }
 }
 
 
 
+// adds a client passed by the admission controller
+void admit_client(echo_context_t *ctx, client_info_t &newClient)
+{
+    log_debug("new connection, fd: %d, ip: %s, port: %d", newClient.fd,
+                client_address(&newClient).c_str(), ntohs(newClient.address.sin_port));
+
+    int fd = newClient.fd;
+    init_new_connection(&newClient);
+    client_table_t::handle_t handle = ctx->clients.insert(fd, connection_t{newClient, 0, {0, 0}});
+
+    // the callback holds one pointer, small enough to be stored in the
+    // std::function itself rather than allocated
+    if(handle == 0 || ctx->loop->add(fd, EventLoop::READ,
+                [ctx](int cfd, uint32_t events){serve_client(ctx, cfd, events);}) != 0){
+        log_warn("client fd: %d, cannot be watched", fd);
+        ctx->clients.erase(fd);
+        ctx->admission.release(fd);
+        close(fd);
+        return;
+    }
+
+    ctx->clients.find(fd)->timers.idle = ctx->loop->get_timers().schedule(IDLE_TIMEOUT_MS,
+        [ctx, handle]{
+            expire_client(ctx, handle, "idle timeout");
+        });
+}
+
+
+
+// accepts the pending connections, as many as one drain allows
+void drain_listener(echo_context_t *ctx, int listenfd)
+{
+    int admitted = ctx->admission.drain(listenfd, [ctx](client_info_t &newClient){
+        admit_client(ctx, newClient);
+    });
+
+    if(admitted < 0){
+        log_warn("connection request failed");
+    }
+    log_trace("admitted %d, active %d, rejected %lu", admitted,
+                ctx->admission.get_active(), ctx->admission.get_rejected());
+
+    // stopped at the per drain limit, no new edge announces the rest
+    if(ctx->admission.has_more()){
+        ctx->loop->get_timers().schedule(0, [ctx, listenfd]{
+            drain_listener(ctx, listenfd);
+        });
+    }
+}
+
+
+/**
+* @brief A read event on the listening socket must be an incoming
+*        connection request. Every pending connection is accepted, not
+*        just one, so the listen queue does not overflow during reconnect
+*        storms, and because the edge is not reported again until a new
+*        one arrives.
+*
+* @return 0 upon success, -1 upon failure
+*/
+int watch_listener(echo_context_t *ctx, int listenfd)
+{
+    return ctx->loop->add(listenfd, EventLoop::READ, [ctx](int fd, uint32_t){
+        drain_listener(ctx, fd);
+    });
+}
+
+
+
+// at exit, the event loop may be gone already
+void close_all_clients(echo_context_t *ctx)
+{
+    for(connection_t &conn : ctx->clients){
+        if(conn.info.data != nullptr){
+            free_client_data(&conn.info);
+        }
+        close(conn.info.fd);
+    }
+}
 
-bool transfer_buffer(client_info_t *cl, const void *buffer, size_t len)
+
+
+/**
+* @brief Thread per core: numShards threads, each pinned to a cpu with its
+*        own SO_REUSEPORT listener, EventLoop and clients. The kernel
+*        spreads new connections across the listeners, and a connection
+*        stays on its shard, so a busy client only delays the clients of
+*        its own shard. The shards share the buffer pool only, which keeps
+*        a cache per thread.
+*
+* @return 0 upon a requested exit, 1 upon failure
+*/
+int run_sharded(const char *port, int numShards, const admission_config_t &config,
+                BufferPool &pool, const sigset_t *emptyMask)
 {
-    if(cl->data != nullptr){
-        log_trace("freeing client data before transfer");
-        free_client_data(cl);
+    ShardedServer sharded;
+    std::vector<std::unique_ptr<echo_context_t>> contexts(static_cast<size_t>(numShards));
+
+    // each shard admits its share of the connections, at least one, 0
+    // stays unlimited
+    admission_config_t shardConfig = config;
+    if(config.maxConnections > 0){
+        shardConfig.maxConnections = std::max(1, config.maxConnections / numShards);
     }
 
-    cl->data = (uint8_t*)malloc(len*sizeof(uint8_t));
-    if(cl->data == nullptr){
-        log_error("memory allocation, %d bytes failed",len);
-        return false;
-    } 
+    // runs on the shard's thread, before its loop
+    int rv = sharded.start(port, numShards, SocketServer::AUTO_BACKLOG, true,
+        [&](ShardedServer::shard_t &shard){
+            echo_context_t *ctx = new echo_context_t(shard.loop, shard.server, pool, shardConfig);
+            contexts[size_t(shard.index)].reset(ctx);
 
-    memcpy((void*)cl->data, buffer, len);
-    cl->numBytes = len;
-    return true;
+            if(watch_listener(ctx, shard.server.get_fd()) != 0){
+                log_error("shard %d, listener registration failure", shard.index);
+            }
+        });
+    if(rv != 0){
+        log_fatal("sharded server start failure");
+        return 1;
+    }
+
+    // the shard threads inherited the blocked signals, they are taken here
+    while(exitRequest == 0){
+        sigsuspend(emptyMask);
+    }
+    log_info("received exit request");
+
+    sharded.stop();
+
+    for(std::unique_ptr<echo_context_t> &ctx : contexts){
+        if(ctx){
+            close_all_clients(ctx.get());
+        }
+    }
+    return 0;
 }
 
 
@@ -210,26 +644,17 @@ int main(int argc, char **argv){
 
     /** Declarations **/
     SocketServer server;
-    bool serverWrite;
-
-    // client connections
-    std::vector<struct client_info_t> clients; 
-    std::vector<int> deletionList;
-    int length;
-    bool deleteClient;
 
-    // file descriptor handling
-    fd_set readfds;                     // read file descriptor set
-    fd_set writefds;                    // write file descriptor set
+    // readiness of the listener and every client, and their timers
+    EventLoop loop;
+    TimerWheel &timers = loop.get_timers();
 
-    int maxfd;                          // largest file descriptor value             
-            
-    int selectReturn;                   // number read/write file descriptors pending
-    struct timespec timeout;            // timeout for pselect
+    admission_config_t admissionConfig;
+    int fileLimit;
 
-    ssize_t bytesRead;
-    ssize_t bytesSent;
-    uint8_t readBuffer[BUFFER_SIZE];
+    // receive buffers, held by a client while it has input or an echo
+    // pending, released back when it has neither
+    BufferPool pool;
 
     // signal handling 
     sigset_t sigmask;
@@ -238,8 +663,20 @@ int main(int argc, char **argv){
     struct sigaction saterm;            // SIGTERM raised by this program or another
     struct sigaction saint;             // SIGINT caused by ctrl + c
     
+    // restart by handoff
+    ListenerHandoff handoff;
+    const char *controlAddress = nullptr;
+    bool passConnections = false;
+    bool draining = false;              // listener handed off
+    std::vector<int> takenListeners;
+    std::vector<int> takenConnections;
+    int takeover = 0;
+
+    // 0, one thread without ShardedServer
+    int numThreads = 0;
+
     // miscellaneous
-    int i;
+    int opt;
     
     /* Initialize logging levels
     *  LOG_TRACE - show all messages at console level, 
@@ -248,25 +685,57 @@ int main(int argc, char **argv){
     */
     log_init(LOG_INFO, LOG_OFF, 1);
 
+    while((opt = getopt(argc, argv, "r:ct:")) != -1){
+        switch(opt){
+            case 'r':
+                controlAddress = optarg;
+                break;
+            case 'c':
+                passConnections = true;
+                break;
+            case 't':{
+                // a whole number, "4x" or "abc" is not silently 4 or 0
+                char *end = nullptr;
+                errno = 0;
+                long n = strtol(optarg, &end, 10);
+                if(errno != 0 || end == optarg || *end != '\0' || n < 1 || n > INT_MAX){
+                    log_fatal("-t takes a number of threads of at least 1, not %s", optarg);
+                    return 1;
+                }
+                numThreads = int(n);
+
+                // a thread per core, more threads than cores only share them
+                long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+                if(numCpus > 0 && numThreads > numCpus){
+                    log_warn("-t %d is more than the %ld online cpus, using %ld",
+                                numThreads, numCpus, numCpus);
+                    numThreads = int(numCpus);
+                }
+                break;
+            }
+            default:
+                log_fatal("usage: %s port [-r control address] [-c] [-t threads]", argv[0]);
+                return 1;
+        }
+    }
+
     // Verify the minimum number of arguments were passed to main
-    if(argc < 2){
-        log_fatal("usage: %s port", argv[0]);
+    if(optind >= argc){
+        log_fatal("usage: %s port [-r control address] [-c] [-t threads]", argv[0]);
         return 1;
     }
-
-    if(server.initialize(argv[1], MAX_PENDING_CONNECTIONS) != 0){
-        log_fatal("server initialize failure");
+    if(numThreads > 0 && controlAddress != nullptr){
+        log_fatal("-r hands off one listening socket, it cannot be used with -t");
         return 1;
     }
 
-    // pselect does not change the timeout argument, so we only need to
-    // initialize it here. If the code is changed to use select instead
-    // of pselect, then this initialization should be moved inside the
-    // while loop, as select updates the timeout argument, deducting
-    // elapsed time from it. 
-    // reference: http://man7.org/linux/man-pages/man2/select.2.html 
-    timeout.tv_sec = 5;                     // seconds
-    timeout.tv_nsec = 0;                    // nanoseconds   
+    // every client holds a descriptor, the default limit is 1024
+    fileLimit = raise_file_limit(WANTED_FILE_LIMIT);
+    if(fileLimit <= RESERVED_FDS){
+        log_fatal("file descriptor limit %d is too low", fileLimit);
+        return 1;
+    }
+    log_info("file descriptor limit %d", fileLimit);
 
 
     // register the SIGTERM signal handler function
@@ -297,199 +766,169 @@ int main(int argc, char **argv){
     sigaddset(&sigmask, SIGTERM);
     sigaddset(&sigmask, SIGINT);
 
-    // set as blocking so that pselect can receive event
+    // blocked, except while the event loop waits, so a signal can only
+    // interrupt the wait. Threads started from here on inherit the mask.
     if(sigprocmask(SIG_BLOCK, &sigmask, NULL) < 0){
         log_fatal("sigprocmask, errno: %s", strerror(errno));
         return 1;
     }
 
+    // client sockets are non-blocking, each is read until EAGAIN and a
+    // client that does not read its echo must not stall the others
+    admissionConfig.maxConnections = fileLimit - RESERVED_FDS;
+    admissionConfig.maxPerSource = MAX_CONNECTIONS_PER_SOURCE;
+    admissionConfig.acceptFlags = SOCK_NONBLOCK | SOCK_CLOEXEC;
 
-    // SIGINT (ctrl + c) or SIGTERM causes loop exit
-    while(exitRequest == 0){
+    if(numThreads > 0){
+        return run_sharded(argv[optind], numThreads, admissionConfig, pool, &empty_mask);
+    }
 
-        // clear file descriptor sets
-        FD_ZERO(&readfds);
-        FD_ZERO(&writefds); 
-
-        serverWrite = false;          
-        
-        // add the server socket to the read set
-        FD_SET(server.get_fd(), &readfds);
-        //FD_SET(server.get_fd(), &writefds);
-        maxfd = server.get_fd();
-
-        // add connected client sockets to set
-        length = int(clients.size());
-        log_trace("number of clients: %d", length);
-        for(i = 0; i < length; ++i){
-            log_trace("adding client %d, fd: %d to readfds",i, clients[i].fd);
-            // add all clients to read set 
-            FD_SET(clients[i].fd, &readfds);
-            FD_SET(clients[i].fd, &writefds);
-
-            // select function requires largest file descriptor number
-            if(clients[i].fd > maxfd){
-                maxfd = clients[i].fd;
-            }
-        } 
+    /* A server already running with this control address passes its
+    *  listening socket, so no connection is refused while this one
+    *  starts. Without one, this is a fresh start.
+    */
+    if(controlAddress != nullptr){
+        takeover = handoff.take_over(controlAddress, &takenListeners, &takenConnections);
+        if(takeover < 0){
+            log_fatal("takeover from %s failed", controlAddress);
+            return 1;
+        }
+    }
 
+    if(takeover == 1){
+        if(takenListeners.empty() || server.adopt(takenListeners[0]) != 0){
+            log_fatal("no listening socket in the handoff");
+            return 1;
+        }
+        for(size_t n = 1; n < takenListeners.size(); ++n){
+            close(takenListeners[n]);
+        }
+    }
+    else{
+        if(server.initialize(argv[optind], SocketServer::AUTO_BACKLOG) != 0){
+            log_fatal("server initialize failure");
+            return 1;
+        }
+        if(controlAddress != nullptr && handoff.initialize(controlAddress) != 0){
+            log_fatal("handoff control %s failure", controlAddress);
+            return 1;
+        }
+    }
 
-        // pselect requires an argument that is 1 more than
-        // the largest file descriptor value
-        selectReturn = pselect(maxfd+1, &readfds, &writefds, NULL, &timeout, &empty_mask); 
+    // edge-triggered, the listener is drained until accept4 reports EAGAIN
+    if(set_nonblocking(server.get_fd()) != 0){
+        log_fatal("listener non-blocking mode failure");
+        return 1;
+    }
 
-        log_trace("back from pselect, selectReturn: %d", selectReturn);
-        
-        // signal may have occurred during pselect call
-        if(exitRequest == 1){
-            log_info("received exit request");
-            break;
-        } 
+    // the clients of this thread's loop
+    echo_context_t ctx(loop, server, pool, admissionConfig);
 
-        if(selectReturn < 0){
-            log_fatal("select error, selectReturn: %d", selectReturn);
-            break;
-        }
-        else if(selectReturn == 0){
-            // nothing to read or write
-            log_debug("nothing to read or write, selectReturn: %d", selectReturn);
+    /* connections passed along with the listener, non-blocking for the
+    *  edge-triggered loop whatever the previous server left them as
+    */
+    for(int fd : takenConnections){
+        if(set_nonblocking(fd) != 0){
+            log_error("adopted fd %d non-blocking mode failure", fd);
+            close(fd);
             continue;
         }
+        ctx.admission.adopt(fd, [&ctx](client_info_t &newClient){
+            admit_client(&ctx, newClient);
+        });
+    }
 
-        /* A read request on the server socket file descriptor must 
-        *  be an incoming connection request
-        */
-        if(FD_ISSET(server.get_fd(), &readfds)){
-
-            /* Note that it is possible this client has previously connected
-            *  and is already in the connectedfd list here. Disconnected
-            *  clients are removed from the list as they are discovered, later
-            *  in this loop.
-            */
-            client_info_t newClient;
-            // newClient fd and address are set by accept function
-            if( server.accept_client_connection(&newClient) != -1){
-                log_info("new connection, fd: %d, ip: %s, port: %d", newClient.fd,
-                            inet_ntoa(newClient.address.sin_addr), 
-                            ntohs(newClient.address.sin_port));
-
-                init_new_connection(&newClient);
-                clients.push_back(newClient);
-            }
-            else{
-                log_warn("connection request failed");
+    if(watch_listener(&ctx, server.get_fd()) != 0){
+        log_fatal("listener registration failure");
+        return 1;
+    }
+
+    /* A new server started with the same control address. Once it
+    *  confirms, it accepts from the shared listen queue and this one
+    *  stops; both hold the same socket, so no connection is refused
+    *  in between. Clients without a pending echo move along with -c,
+    *  the rest are served here until they leave.
+    */
+    EventLoop::Callback on_handoff = [&](int controlfd, uint32_t){
+        std::vector<int> listeners(1, server.get_fd());
+        std::vector<int> connections;
+
+        if(passConnections){
+            for(const connection_t &conn : ctx.clients){
+                if(!conn.info.writeFlag){
+                    connections.push_back(conn.info.fd);
+                }
             }
         }
 
-        // read messages from connected clients
-        // not updating the length as the new connection add above
-        // will not an entry in readfds 
-        for(i = 0; i < length; ++i){
-            if(FD_ISSET(clients[i].fd, &readfds)){
-
-                memset(readBuffer, 0, BUFFER_SIZE);
-                
-                bytesRead = server.receive_data(clients[i].fd, readBuffer, BUFFER_SIZE);
-                
-                log_info("bytesRead: %d", bytesRead);
-                log_info("client fd: %d", clients[i].fd);
-
-                if(bytesRead > 0){
-                    // this is an echo server that sends data back to client
-                    // serverWrite flag set to true so that the data may be sent
-                    // later
-                    serverWrite = true;
-
-                    // transfer data to client buffer for further processing
-                    if(transfer_buffer(&clients[i], readBuffer, bytesRead)){
-                        log_trace("buffer transfer completed");
-                        // set write flag so that the data will be echoed to client
-                        clients[i].writeFlag = true;
-                    }
-                    else{
-                        log_warn("client fd: %d, received data lost due to memory"
-                            " allocation error", clients[i].fd);
-                    }
-                }
-                else if(bytesRead == 0){ // disconnected
-                    log_info("Disconnected from ip %s, port %d",  
-                          inet_ntoa(clients[i].address.sin_addr) , 
-                          ntohs(clients[i].address.sin_port));
-                    
-                    deleteClient = true;
-
-                    // free any data 
-                    if(clients[i].data != nullptr){
-                        log_warn("freeing data buffer");
-                        free(clients[i].data);
-                        clients[i].data = nullptr;
-                        clients[i].numBytes = 0;
-                    }   
-                         
-                    //Close the socket and mark as 0 in list for reuse  
-                    close( clients[i].fd );
-                    clients[i].fd = -1; 
-                }
-                else{
-                    log_info("server did not echo bytes received");
-                }
+        /** hand_off closes the control socket, remove it from the loop
+        *   first. The descriptor is gone once closed, but the successor
+        *   holds the same open file, which keeps it in the epoll set and
+        *   keeps waking this loop.
+        */
+        loop.remove(controlfd);
+        if(handoff.hand_off(listeners, connections) != 0){
+            log_warn("handoff failed, still serving");
+            if(loop.add(controlfd, EventLoop::READ, on_handoff) != 0){
+                log_error("handoff control registration failure");
             }
+            return;
         }
 
-        // server echos data to client
-        if(serverWrite)
-        {
-            log_trace("serverWrite is true");
-            for(i = 0; i < length; ++i){
-
-                if(FD_ISSET(clients[i].fd, &writefds)){
-                    log_trace("client[%d].fd: %d is writeable", i, clients[i].fd);
-
-                    // echo back if there is data
-                    if(clients[i].writeFlag){
-
-                        log_trace("client fd: %d, writeFlag set", clients[i].fd);
-                        bytesSent = server.send_data(clients[i].fd, clients[i].data, clients[i].numBytes);
-                        if(bytesSent > 0){
-                            if(bytesSent != clients[i].numBytes){
-                                log_warn("bytesSent: %d != numBytes: %d", bytesSent, clients[i].numBytes);
-                                log_warn("freeing client data, even though all bytes were not sent");
-                            }
-                            else{
-                                log_trace("all bytes sent to client")
-                            }
-
-                            free_client_data(&clients[i]);
-                        }
-                        else{
-                            log_trace("no bytes sent to client[%d].fd: %d", i, clients[i].fd);
-                            log_trace("will try again next time through loop");
-                        }
-                    }
-                }
-            } // end for
-        } // end if serverwrite
-        
-        // rebuild client list to handle disconnects
-        if(deleteClient){
-            build_client_list(clients);
-            deleteClient = false;
+        loop.remove(server.get_fd());
+        close(server.release());
+        draining = true;
+
+        // the new server holds them now, close only this copy
+        for(int fd : connections){
+            close_client(&ctx, fd);
+        }
+
+        timers.schedule(DRAIN_TIMEOUT_MS, []{
+            log_warn("drain timeout, closing the remaining clients");
+            exitRequest = 1;
+        });
+        log_info("listening socket handed off, draining");
+    };
+    if(handoff.is_ready() && loop.add(handoff.get_fd(), EventLoop::READ, on_handoff) != 0){
+        log_fatal("handoff control registration failure");
+        return 1;
+    }
+
+
+    // SIGINT (ctrl + c) or SIGTERM causes loop exit
+    while(exitRequest == 0){
+
+        // after a handoff the last client leaving ends the program
+        if(draining && ctx.clients.empty()){
+            log_info("drained, exiting");
+            break;
+        }
+
+        /* Wait for socket activity or the next timer, whichever is first,
+        *  then run the callbacks of the ready sockets and the due timers.
+        *  epoll_pwait installs empty_mask for the wait as pselect did.
+        *  Unlike select, epoll keeps the interest set in the kernel and
+        *  returns only the ready descriptors, so a wakeup costs the same
+        *  with 50 or 50,000 clients, and descriptors are not limited to
+        *  FD_SETSIZE.
+        */
+        if(loop.run_once(LOOP_TIMEOUT_MS, &empty_mask) < 0){
+            log_fatal("event loop failure");
+            break;
+        }
+
+        // signal may have occurred during the wait
+        if(exitRequest == 1){
+            log_info("received exit request");
+            break;
         }
-            
     } // end while
 
     log_trace("exited while loop");
 
     // close connected client socket and free memory
-     length = int(clients.size());
-     for(i = 0; i < length; ++i){
-         if(clients[i].data != nullptr){
-            free_client_data(&clients[i]);
-         }
-         if(clients[i].fd != -1){
-             close(clients[i].fd);
-         }
-     }
+    close_all_clients(&ctx);
 
     /* Note the socket server class destructor takes care 
     *  of closing the socket. Thus, a call to close_socket 
@@ -0,0 +1,213 @@
+#include <cstring>              // memset, memcpy, strerror
+#include <unistd.h>             // close
+#include <fcntl.h>              // open
+
+#include <iostream>
+#include <cerrno>
+
+#include <netinet/in.h>
+
+#include <debuglog/debuglog.h>
+
+#include "admissionController.h"
+
+
+namespace mysocket{
+
+    AdmissionController::AdmissionController(const admission_config_t &cfg){
+        config = cfg;
+        active = 0;
+        rejected = 0;
+        more = false;
+
+        /** When the process runs out of descriptors, accept fails with
+        *   EMFILE but the connection stays in the listen queue, so the
+        *   listener stays readable and the event loop spins. A descriptor
+        *   held in reserve is released to accept and reject it.
+        */
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+
+    AdmissionController::~AdmissionController(){
+        if(spareFd != -1){
+            close(spareFd);
+        }
+    }
+
+    std::string AdmissionController::source_key(const struct sockaddr_storage &address){
+        if(address.ss_family == AF_INET){
+            const struct sockaddr_in *in = (const struct sockaddr_in*)(const void*)&address;
+            return std::string((const char*)&in->sin_addr, sizeof(in->sin_addr));
+        }
+        if(address.ss_family == AF_INET6){
+            const struct sockaddr_in6 *in6 = (const struct sockaddr_in6*)(const void*)&address;
+            return std::string((const char*)&in6->sin6_addr, sizeof(in6->sin6_addr));
+        }
+        return std::string();
+    }
+
+    void AdmissionController::reject(int fd){
+        /** SO_LINGER with a zero timeout makes close send RST and free the
+        *   connection at once instead of a FIN handshake that would keep
+        *   server resources busy while we are overloaded.
+        */
+        struct linger lg;
+        lg.l_onoff = 1;
+        lg.l_linger = 0;
+        setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+        close(fd);
+        ++rejected;
+    }
+
+    bool AdmissionController::shed_one(int listenfd){
+        if(spareFd == -1){
+            return false;
+        }
+
+        close(spareFd);
+        int fd = accept(listenfd, NULL, NULL);
+        if(fd != -1){
+            reject(fd);
+        }
+        spareFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        return fd != -1;
+    }
+
+    int AdmissionController::drain(int listenfd, AdmitCallback onAdmit){
+        int admitted = 0;
+        int accepted = 0;
+
+        more = false;
+        for(;;){
+            if(config.maxAcceptsPerDrain > 0 && accepted >= config.maxAcceptsPerDrain){
+                more = true;
+                break;
+            }
+
+            struct sockaddr_storage address;
+            socklen_t addressLength = sizeof(address);
+            memset(&address, 0, sizeof(address));
+
+            /** int accept4(int sockfd, struct sockaddr *addr,
+            *               socklen_t *addrlen, int flags);
+            *
+            *   Same as accept, plus flags applied to the new socket in the
+            *   same system call: SOCK_NONBLOCK saves an fcntl per connection
+            *   and SOCK_CLOEXEC closes the race with a concurrent exec.
+            */
+            int fd = accept4(listenfd, (struct sockaddr*)&address, &addressLength,
+                            config.acceptFlags);
+            if(fd == -1){
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    break;          // queue drained
+                }
+                if(errno == EINTR || errno == ECONNABORTED || errno == EPROTO){
+                    continue;       // that connection is gone, try the next
+                }
+                if(errno == EMFILE || errno == ENFILE){
+                    log_warn("out of file descriptors, shedding connection");
+                    if(shed_one(listenfd)){
+                        continue;
+                    }
+                    break;
+                }
+                std::cerr << "error: " << __func__ << ", accept4, "
+                        << strerror(errno) << std::endl;
+                return -1;
+            }
+            ++accepted;
+
+            // connection ceiling reached, fast reject
+            if(config.maxConnections > 0 && active >= config.maxConnections){
+                log_debug("connection ceiling %d reached, rejecting fd %d",
+                            config.maxConnections, fd);
+                reject(fd);
+                continue;
+            }
+
+            std::string key;
+            if(config.maxPerSource > 0){
+                key = source_key(address);
+                if(perSource[key] >= config.maxPerSource){
+                    log_debug("per source cap %d reached, rejecting fd %d",
+                                config.maxPerSource, fd);
+                    reject(fd);
+                    continue;
+                }
+            }
+
+            ++admitted;
+            admit(fd, address, key, onAdmit);
+        }
+
+        return admitted;
+    }
+
+    int AdmissionController::adopt(int fd, AdmitCallback onAdmit){
+        struct sockaddr_storage address;
+        socklen_t addressLength = sizeof(address);
+
+        memset(&address, 0, sizeof(address));
+        if(getpeername(fd, (struct sockaddr*)&address, &addressLength) != 0){
+            log_debug("getpeername fd %d, %s", fd, strerror(errno));
+        }
+
+        std::string key;
+        if(config.maxPerSource > 0){
+            key = source_key(address);
+        }
+        if((config.maxConnections > 0 && active >= config.maxConnections) ||
+                (config.maxPerSource > 0 && perSource[key] >= config.maxPerSource)){
+            log_debug("limit reached, rejecting adopted fd %d", fd);
+            reject(fd);
+            return 0;
+        }
+
+        admit(fd, address, key, onAdmit);
+        return 1;
+    }
+
+    void AdmissionController::admit(int fd, const struct sockaddr_storage &address,
+                                    const std::string &key, AdmitCallback &onAdmit){
+        // without a per source cap the count is all that is needed
+        if(config.maxPerSource > 0){
+            ++perSource[key];
+            sourceOf[fd] = key;
+        }
+        ++active;
+
+        client_info_t client;
+        client.fd = fd;
+        memset(&client.address, 0, sizeof(client.address));
+        if(address.ss_family == AF_INET){
+            memcpy(&client.address, &address, sizeof(client.address));
+        }
+        client.data = nullptr;
+        client.numBytes = 0;
+        client.writeFlag = false;
+
+        onAdmit(client);
+    }
+
+    void AdmissionController::release(int fd){
+        if(config.maxPerSource <= 0){
+            if(active > 0){
+                --active;
+            }
+            return;
+        }
+
+        auto it = sourceOf.find(fd);
+        if(it == sourceOf.end()){
+            return;
+        }
+
+        auto source = perSource.find(it->second);
+        if(source != perSource.end() && --source->second <= 0){
+            perSource.erase(source);
+        }
+        sourceOf.erase(it);
+        --active;
+    }
+
+} // end namespace
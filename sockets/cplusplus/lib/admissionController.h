@@ -0,0 +1,100 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <sys/socket.h>
+
+#include "socketServer.h"
+
+namespace mysocket{
+
+    struct admission_config_t{
+        // total admitted connections, 0 is unlimited
+        int maxConnections = 0;
+
+        // admitted connections per source IP address, 0 is unlimited
+        int maxPerSource = 0;
+
+        // accepts per drain call, bounds the time spent accepting so
+        // established connections are not starved, 0 is unlimited.
+        // See has_more.
+        int maxAcceptsPerDrain = 0;
+
+        // flags for accept4
+        int acceptFlags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    };
+
+
+    /*  Connection admission for a listening socket.
+    *
+    *   drain accepts every connection waiting in the listen queue with
+    *   accept4 in a loop, rather than one per readiness event, so the queue
+    *   empties as fast as it fills during reconnect storms. Connections
+    *   over the total ceiling or over the per-source cap are rejected with
+    *   an immediate RST, which costs the server one accept and one close
+    *   and leaves no TIME_WAIT state behind.
+    *
+    *   The listening socket must be non-blocking.
+    */
+    class AdmissionController{
+        public:
+
+        using AdmitCallback = std::function<void(client_info_t &client)>;
+
+        explicit AdmissionController(const admission_config_t &config);
+        ~AdmissionController();
+
+        // returns the number of connections admitted, -1 on listener error
+        int drain(int listenfd, AdmitCallback onAdmit);
+
+        // true when the last drain stopped at maxAcceptsPerDrain. The rest
+        // of the listen queue was announced by the edge already consumed,
+        // so call drain again once other ready descriptors are served,
+        // e.g. from a zero delay timer, or watch the listener level
+        // triggered.
+        bool has_more(){return more;}
+
+        // admits a connection that was accepted elsewhere, e.g. received
+        // in a ListenerHandoff, under the same limits.
+        // returns 1 when admitted, 0 when rejected (fd is closed)
+        int adopt(int fd, AdmitCallback onAdmit);
+
+        // call when an admitted connection is closed, and only then
+        void release(int fd);
+
+        int get_active(){return active;}
+        uint64_t get_rejected(){return rejected;}
+
+        // disable copy semantics
+        AdmissionController(const AdmissionController&) = delete;
+        AdmissionController& operator=(const AdmissionController&) = delete;
+
+
+        private:
+            admission_config_t config;
+            int active;
+            uint64_t rejected;
+            bool more;
+
+            // descriptor held in reserve for the EMFILE case
+            int spareFd;
+
+            // kept only when maxPerSource is set
+            std::unordered_map<std::string, int> perSource;
+            std::unordered_map<int, std::string> sourceOf;
+
+            static std::string source_key(const struct sockaddr_storage &address);
+
+            void reject(int fd);
+            void admit(int fd, const struct sockaddr_storage &address,
+                       const std::string &key, AdmitCallback &onAdmit);
+            bool shed_one(int listenfd);
+    };
+}
+
+
+#endif
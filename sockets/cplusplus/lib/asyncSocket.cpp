@@ -0,0 +1,262 @@
+#include <cstring>              // memset, strerror
+#include <unistd.h>             // close
+
+#include <iostream>
+#include <cerrno>
+#include <chrono>
+#include <utility>
+
+#include <netdb.h>
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include "asyncSocket.h"
+
+
+namespace mysocket{
+
+    using Clock = std::chrono::steady_clock;
+
+    // wait before accepting again when out of descriptors or memory
+    static constexpr int ACCEPT_BACKOFF_MS = 100;
+
+    // milliseconds left until deadline, -1 when there is no deadline
+    static int remaining_ms(bool hasDeadline, Clock::time_point deadline){
+        if(!hasDeadline){
+            return -1;
+        }
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        deadline - Clock::now()).count();
+        return left < 0 ? 0 : int(left);
+    }
+
+
+    AsyncConnection::AsyncConnection(){
+        scheduler = nullptr;
+        socketfd = -1;
+    }
+
+    AsyncConnection::AsyncConnection(Scheduler &s, int fd){
+        scheduler = &s;
+        socketfd = fd;
+        if(scheduler->watch(fd) != 0){
+            close(fd);
+            socketfd = -1;
+        }
+    }
+
+    AsyncConnection::~AsyncConnection(){
+        close_socket();
+    }
+
+    AsyncConnection::AsyncConnection(AsyncConnection &&other) noexcept{
+        scheduler = other.scheduler;
+        socketfd = std::exchange(other.socketfd, -1);
+    }
+
+    AsyncConnection& AsyncConnection::operator=(AsyncConnection &&other) noexcept{
+        if(this != &other){
+            close_socket();
+            scheduler = other.scheduler;
+            socketfd = std::exchange(other.socketfd, -1);
+        }
+        return *this;
+    }
+
+    void AsyncConnection::close_socket(){
+        if(socketfd != -1){
+            scheduler->unwatch(socketfd);
+            close(socketfd);
+            socketfd = -1;
+        }
+    }
+
+    Task<ssize_t> AsyncConnection::read_some(void *buf, size_t len, int timeoutMs){
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        for(;;){
+            // try first, the data is often already there
+            ssize_t n = recv(socketfd, buf, len, 0);
+            if(n >= 0){
+                co_return n;
+            }
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                co_return -1;
+            }
+
+            if(co_await scheduler->readable(socketfd, remaining_ms(timeoutMs >= 0, deadline)) != 0){
+                co_return -1;
+            }
+        }
+    }
+
+    Task<ssize_t> AsyncConnection::write_all(const void *buf, size_t len, int timeoutMs){
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        const uint8_t *data = (const uint8_t*)buf;
+        size_t sent = 0;
+
+        while(sent < len){
+            ssize_t n = send(socketfd, data + sent, len - sent, MSG_NOSIGNAL);
+            if(n > 0){
+                sent += size_t(n);
+                continue;
+            }
+            if(n < 0 && errno == EINTR){
+                continue;
+            }
+            if(n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)){
+                break;
+            }
+
+            if(co_await scheduler->writable(socketfd, remaining_ms(timeoutMs >= 0, deadline)) != 0){
+                break;
+            }
+        }
+        co_return ssize_t(sent);
+    }
+
+    Task<AsyncConnection> AsyncConnection::connect(Scheduler &s, const char *port,
+                                            const char *ipAddress, int timeoutMs){
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        struct addrinfo hints, *servinfo, *ptr;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        // getaddrinfo blocks on DNS, pass numeric addresses from coroutines
+        int rv = getaddrinfo(ipAddress, port, &hints, &servinfo);
+        if(rv != 0){
+            std::cerr << "error: " << __func__ << ", getaddrinfo: "
+                    << gai_strerror(rv) << std::endl;
+            co_return AsyncConnection();
+        }
+
+        AsyncConnection conn;
+        for(ptr = servinfo; ptr != NULL && !conn.is_open(); ptr = ptr->ai_next){
+            int fd = socket(ptr->ai_family, ptr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                            ptr->ai_protocol);
+            if(fd == -1){
+                continue;
+            }
+
+            AsyncConnection attempt(s, fd);
+            if(!attempt.is_open()){
+                continue;
+            }
+
+            /** A non-blocking connect returns EINPROGRESS; the socket turns
+            *   writable when the handshake completes and SO_ERROR holds the
+            *   outcome.
+            */
+            if(::connect(fd, ptr->ai_addr, ptr->ai_addrlen) != 0){
+                if(errno != EINPROGRESS){
+                    log_debug("connect attempt failed: %s", strerror(errno));
+                    continue;
+                }
+                if(co_await s.writable(fd, remaining_ms(timeoutMs >= 0, deadline)) != 0){
+                    log_debug("connect attempt timed out");
+                    break;
+                }
+
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if(error != 0){
+                    log_debug("connect attempt failed: %s", strerror(error));
+                    continue;
+                }
+            }
+            conn = std::move(attempt);
+        }
+
+        freeaddrinfo(servinfo);
+        if(!conn.is_open()){
+            std::cerr << "error: " << __func__ << ", failed to connect\n";
+        }
+        co_return conn;
+    }
+
+
+    AsyncServer::AsyncServer(Scheduler &s){
+        scheduler = &s;
+        watched = false;
+        backingOff = false;
+    }
+
+    AsyncServer::~AsyncServer(){
+        close_socket();
+    }
+
+    int AsyncServer::initialize(const char *port, int maxpending, bool reusePort){
+        if(server.initialize(port, maxpending, reusePort) != 0){
+            return -1;
+        }
+        if(scheduler->watch(server.get_fd()) != 0){
+            server.close_socket();
+            return -1;
+        }
+        watched = true;
+        return 0;
+    }
+
+    Task<AsyncConnection> AsyncServer::accept(int timeoutMs){
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+
+        for(;;){
+            int fd = accept4(server.get_fd(), NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(fd != -1){
+                backingOff = false;
+                co_return AsyncConnection(*scheduler, fd);
+            }
+            if(errno == EINTR || errno == ECONNABORTED){
+                continue;
+            }
+            if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM){
+                /** The connection stays in the listen queue and the listener
+                *   stays readable, so accepting again at once fails the same
+                *   way. Sleep and let other connections close first, logging
+                *   the error only once.
+                */
+                if(!backingOff){
+                    std::cerr << "error: " << __func__ << ", accept4, "
+                            << strerror(errno) << ", backing off" << std::endl;
+                    backingOff = true;
+                }
+                int waitMs = remaining_ms(timeoutMs >= 0, deadline);
+                if(waitMs == 0){
+                    errno = ETIMEDOUT;
+                    co_return AsyncConnection();
+                }
+                if(waitMs == -1 || waitMs > ACCEPT_BACKOFF_MS){
+                    waitMs = ACCEPT_BACKOFF_MS;
+                }
+                co_await scheduler->sleep_for(waitMs);
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                std::cerr << "error: " << __func__ << ", accept4, "
+                        << strerror(errno) << std::endl;
+                co_return AsyncConnection();
+            }
+
+            if(co_await scheduler->readable(server.get_fd(),
+                                remaining_ms(timeoutMs >= 0, deadline)) != 0){
+                co_return AsyncConnection();
+            }
+        }
+    }
+
+    void AsyncServer::close_socket(){
+        if(watched){
+            scheduler->unwatch(server.get_fd());
+            watched = false;
+        }
+        server.close_socket();
+    }
+
+} // end namespace
@@ -0,0 +1,122 @@
+#ifndef ASYNC_SOCKET_H
+#define ASYNC_SOCKET_H
+
+#include <cstdint>
+
+#include <sys/types.h>
+
+#include "scheduler.h"
+#include "socketServer.h"
+#include "task.h"
+
+namespace mysocket{
+
+    /*  Connected socket for coroutines, requires C++20.
+    *
+    *   Every operation is awaited and suspends only the calling coroutine
+    *   while the socket is not ready, never the thread:
+    *
+    *       Task<void> echo(AsyncConnection conn){
+    *           uint8_t buf[2048];
+    *           for(;;){
+    *               ssize_t n = co_await conn.read_some(buf, sizeof(buf), 30000);
+    *               if(n <= 0){
+    *                   break;          // closed, error or 30 s idle
+    *               }
+    *               if(co_await conn.write_all(buf, size_t(n)) != n){
+    *                   break;
+    *               }
+    *           }
+    *       }
+    *
+    *   timeoutMs bounds the whole operation, -1 waits indefinitely. On
+    *   timeout the result is -1 with errno ETIMEDOUT.
+    *
+    *   The object must not be moved or destroyed while an operation on it
+    *   is pending.
+    */
+    class AsyncConnection{
+        public:
+
+        AsyncConnection();
+
+        // takes ownership of the connected socket fd
+        AsyncConnection(Scheduler &scheduler, int fd);
+
+        ~AsyncConnection();
+
+        // move semantics transfer ownership of the socket
+        AsyncConnection(AsyncConnection&&) noexcept;
+        AsyncConnection& operator=(AsyncConnection&&) noexcept;
+
+        // returns bytes read (at most len), 0 when the peer closed the
+        // connection, -1 on error
+        Task<ssize_t> read_some(void *buf, size_t len, int timeoutMs = -1);
+
+        // returns len once every byte is sent, fewer on error or timeout
+        Task<ssize_t> write_all(const void *buf, size_t len, int timeoutMs = -1);
+
+        // non-blocking connect to the first address of ip that answers.
+        // the result is not open on failure, see is_open
+        static Task<AsyncConnection> connect(Scheduler &scheduler, const char *port,
+                                            const char *ipAddress, int timeoutMs = -1);
+
+        bool is_open(){return socketfd != -1;}
+        int get_fd(){return socketfd;}
+        void close_socket();
+
+        // disable copy semantics
+        AsyncConnection(const AsyncConnection&) = delete;
+        AsyncConnection& operator=(const AsyncConnection&) = delete;
+
+
+        private:
+            Scheduler *scheduler;
+            int socketfd;
+    };
+
+
+    /*  Listening socket for coroutines.
+    *
+    *       Task<void> serve(Scheduler &s, AsyncServer &server){
+    *           for(;;){
+    *               AsyncConnection conn = co_await server.accept();
+    *               if(conn.is_open()){
+    *                   s.spawn(echo(std::move(conn)));
+    *               }
+    *           }
+    *       }
+    */
+    class AsyncServer{
+        public:
+
+        explicit AsyncServer(Scheduler &scheduler);
+        ~AsyncServer();
+
+        // see SocketServer::initialize, returns 0 upon success, -1 upon failure
+        int initialize(const char *port, int maxpending = SocketServer::AUTO_BACKLOG,
+                        bool reusePort = false);
+
+        // the next connection, not open on error or timeout. While out of
+        // descriptors or memory, EMFILE and the like, keeps retrying every
+        // 100 ms until a connection is accepted or timeoutMs passes.
+        Task<AsyncConnection> accept(int timeoutMs = -1);
+
+        int get_fd(){return server.get_fd();}
+        void close_socket();
+
+        // disable copy semantics
+        AsyncServer(const AsyncServer&) = delete;
+        AsyncServer& operator=(const AsyncServer&) = delete;
+
+
+        private:
+            Scheduler *scheduler;
+            SocketServer server;
+            bool watched;
+            bool backingOff;                // accept4 ran out of resources
+    };
+}
+
+
+#endif
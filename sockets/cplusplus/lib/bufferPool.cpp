@@ -0,0 +1,285 @@
+#include <cstring>              // strerror
+
+#include <iostream>
+#include <cerrno>
+#include <atomic>
+#include <unordered_map>
+
+#include <sys/mman.h>           // mmap, munmap, madvise
+
+#include <debuglog/debuglog.h>
+
+#include "bufferPool.h"
+
+
+namespace mysocket{
+
+    // pools alive, for the thread exit flush
+    static std::mutex registryLock;
+    static std::unordered_map<uint32_t, BufferPool*> livePools;
+    static std::atomic<uint32_t> nextPoolId(0);
+
+    thread_local BufferPool::thread_caches_t BufferPool::threadCaches;
+
+    /** The cache of the pool this thread used last, most programs have
+    *   one. threadCaches has a destructor, so every access to it goes
+    *   through a call that checks it was constructed; these two are
+    *   constant initialized and need no check. initial-exec places them
+    *   in the static TLS block, at a fixed offset from the thread pointer
+    *   instead of a __tls_get_addr call, fine for a library linked at
+    *   start up rather than loaded with dlopen.
+    */
+    __attribute__((tls_model("initial-exec")))
+    static thread_local uint32_t lastPoolId = UINT32_MAX;
+
+    __attribute__((tls_model("initial-exec")))
+    static thread_local void *lastPoolCache = nullptr;
+
+
+    BufferPool::BufferPool(bool huge){
+        id = nextPoolId.fetch_add(1);
+        hugePages = huge;
+        hugeSlabs = 0;
+        for(central_t &c : central){
+            c.freeList = nullptr;
+            c.freeCount = 0;
+        }
+
+        std::lock_guard<std::mutex> guard(registryLock);
+        livePools[id] = this;
+    }
+
+    BufferPool::~BufferPool(){
+        {
+            std::lock_guard<std::mutex> guard(registryLock);
+            livePools.erase(id);
+        }
+
+        // blocks cached by this thread point into the slabs unmapped below
+        if(id < threadCaches.byPool.size()){
+            threadCaches.byPool[id].reset();
+        }
+        if(lastPoolId == id){
+            lastPoolId = UINT32_MAX;
+            lastPoolCache = nullptr;
+        }
+
+        std::lock_guard<std::mutex> guard(slabLock);
+        for(void *slab : slabs){
+            munmap(slab, SLAB_SIZE);
+        }
+        slabs.clear();
+    }
+
+    void* BufferPool::allocate(size_t len){
+        if(len > MAX_BLOCK_SIZE){
+            errno = EMSGSIZE;
+            return nullptr;
+        }
+
+        int sizeClass = size_class(len);
+        class_cache_t &cache = local_cache().classes[sizeClass];
+
+        if(cache.count == 0 && refill(sizeClass, cache) == 0){
+            errno = ENOMEM;
+            return nullptr;
+        }
+        return cache.blocks[--cache.count];
+    }
+
+    void BufferPool::release(void *buf){
+        if(buf == nullptr){
+            return;
+        }
+
+        slab_t *slab = slab_of(buf);
+        if(slab->magic != SLAB_MAGIC){
+            log_error("release of a buffer not allocated from a BufferPool");
+            return;
+        }
+
+        int sizeClass = int(slab->sizeClass);
+        class_cache_t &cache = slab->pool->local_cache().classes[sizeClass];
+
+        if(cache.count == CACHE_BLOCKS){
+            slab->pool->flush(sizeClass, cache, CACHE_BLOCKS / 2);
+        }
+        cache.blocks[cache.count++] = buf;
+    }
+
+    size_t BufferPool::capacity(const void *buf){
+        return MIN_BLOCK_SIZE << slab_of(buf)->sizeClass;
+    }
+
+    size_t BufferPool::get_slabs(){
+        std::lock_guard<std::mutex> guard(slabLock);
+        return slabs.size();
+    }
+
+    size_t BufferPool::get_huge_slabs(){
+        std::lock_guard<std::mutex> guard(slabLock);
+        return hugeSlabs;
+    }
+
+    int BufferPool::size_class(size_t len){
+        if(len <= MIN_BLOCK_SIZE){
+            return 0;
+        }
+        // bits needed for len - 1, less the 8 bits of MIN_BLOCK_SIZE
+        return 64 - __builtin_clzll(uint64_t(len - 1)) - 8;
+    }
+
+    BufferPool::slab_t* BufferPool::slab_of(const void *buf){
+        return reinterpret_cast<slab_t*>(reinterpret_cast<uintptr_t>(buf) & ~uintptr_t(SLAB_SIZE - 1));
+    }
+
+    BufferPool::pool_cache_t& BufferPool::local_cache(){
+        if(lastPoolId == id){
+            return *static_cast<pool_cache_t*>(lastPoolCache);
+        }
+
+        std::vector<std::unique_ptr<pool_cache_t>> &byPool = threadCaches.byPool;
+
+        if(id >= byPool.size()){
+            byPool.resize(id + 1);
+        }
+        if(!byPool[id]){
+            byPool[id] = std::make_unique<pool_cache_t>();
+            for(class_cache_t &c : byPool[id]->classes){
+                c.count = 0;
+            }
+        }
+        lastPoolId = id;
+        lastPoolCache = byPool[id].get();
+        return *byPool[id];
+    }
+
+    int BufferPool::refill(int sizeClass, class_cache_t &cache){
+        central_t &c = central[sizeClass];
+        std::lock_guard<std::mutex> guard(c.lock);
+
+        if(c.freeList == nullptr && grow(sizeClass) != 0){
+            return 0;
+        }
+
+        while(cache.count < CACHE_BLOCKS / 2 && c.freeList != nullptr){
+            free_block_t *block = c.freeList;
+            c.freeList = block->next;
+            --c.freeCount;
+            cache.blocks[cache.count++] = block;
+        }
+        return cache.count;
+    }
+
+    void BufferPool::flush(int sizeClass, class_cache_t &cache, int n){
+        central_t &c = central[sizeClass];
+        std::lock_guard<std::mutex> guard(c.lock);
+
+        while(n-- > 0 && cache.count > 0){
+            free_block_t *block = static_cast<free_block_t*>(cache.blocks[--cache.count]);
+            block->next = c.freeList;
+            c.freeList = block;
+            ++c.freeCount;
+        }
+    }
+
+    // caller holds central[sizeClass].lock
+    int BufferPool::grow(int sizeClass){
+        void *mem = map_slab();
+        if(mem == nullptr){
+            return -1;
+        }
+
+        slab_t *slab = static_cast<slab_t*>(mem);
+        slab->magic = SLAB_MAGIC;
+        slab->sizeClass = uint32_t(sizeClass);
+        slab->pool = this;
+
+        // the first block holds the slab header
+        size_t blockSize = MIN_BLOCK_SIZE << sizeClass;
+        uint8_t *base = static_cast<uint8_t*>(mem);
+        central_t &c = central[sizeClass];
+
+        for(size_t offset = SLAB_SIZE - blockSize; offset >= blockSize; offset -= blockSize){
+            free_block_t *block = reinterpret_cast<free_block_t*>(base + offset);
+            block->next = c.freeList;
+            c.freeList = block;
+            ++c.freeCount;
+        }
+
+        log_debug("buffer pool slab for %lu byte blocks", blockSize);
+        return 0;
+    }
+
+    void* BufferPool::map_slab(){
+        void *mem;
+        bool huge = false;
+
+        /** MAP_HUGETLB takes the slab from the huge pages reserved with
+        *   vm.nr_hugepages, naturally aligned to their 2 MB size. It fails
+        *   with ENOMEM when none are free.
+        */
+        mem = MAP_FAILED;
+        if(hugePages){
+            mem = mmap(NULL, SLAB_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            huge = mem != MAP_FAILED;
+        }
+
+        if(mem == MAP_FAILED){
+
+            /** mmap only promises page alignment. Twice the size is mapped
+            *   and the parts before and after an aligned slab are unmapped.
+            */
+            uint8_t *raw = static_cast<uint8_t*>(mmap(NULL, 2 * SLAB_SIZE,
+                            PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if(raw == MAP_FAILED){
+                std::cerr << "error: " << __func__ << ", mmap, "
+                        << strerror(errno) << std::endl;
+                return nullptr;
+            }
+
+            uintptr_t start = (reinterpret_cast<uintptr_t>(raw) + SLAB_SIZE - 1)
+                                & ~uintptr_t(SLAB_SIZE - 1);
+            uint8_t *aligned = reinterpret_cast<uint8_t*>(start);
+            size_t before = size_t(aligned - raw);
+
+            if(before > 0){
+                munmap(raw, before);
+            }
+            munmap(aligned + SLAB_SIZE, SLAB_SIZE - before);
+            mem = aligned;
+
+            // transparent huge pages, a hint only
+            if(hugePages && madvise(mem, SLAB_SIZE, MADV_HUGEPAGE) != 0){
+                log_debug("madvise MADV_HUGEPAGE, %s", strerror(errno));
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(slabLock);
+        slabs.push_back(mem);
+        if(huge){
+            ++hugeSlabs;
+        }
+        return mem;
+    }
+
+
+    BufferPool::thread_caches_t::~thread_caches_t(){
+        std::lock_guard<std::mutex> guard(registryLock);
+
+        for(size_t i = 0; i < byPool.size(); ++i){
+            if(!byPool[i]){
+                continue;
+            }
+            auto it = livePools.find(uint32_t(i));
+            if(it == livePools.end()){
+                continue;
+            }
+            for(int c = 0; c < NUM_CLASSES; ++c){
+                it->second->flush(c, byPool[i]->classes[c], CACHE_BLOCKS);
+            }
+        }
+    }
+
+} // end namespace
@@ -0,0 +1,130 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace mysocket{
+
+    /*  Size-classed pool of I/O buffers for connections.
+    *
+    *   Buffers come in powers of two from 256 bytes to 64 KB. Each size
+    *   class carves fixed size blocks out of 2 MB slabs mapped with mmap;
+    *   a slab is aligned to its size, so release finds the slab, and with
+    *   it the size class and owning pool, from the buffer address alone.
+    *   Slabs are kept until the pool is destroyed.
+    *
+    *   Every thread keeps a small cache of free blocks per size class.
+    *   allocate and release take from and give back to that cache, with
+    *   no lock and no system call; only a cache that runs empty or full
+    *   moves a batch of blocks to or from the pool's shared free list.
+    *   A buffer may be released on another thread than the one that
+    *   allocated it.
+    *
+    *   With hugePages, slabs are mapped from the reserved huge pages
+    *   (vm.nr_hugepages) when there are any, otherwise transparent huge
+    *   pages are requested with madvise. One TLB entry then covers a slab
+    *   instead of 512.
+    *
+    *   Buffers are not zeroed. Only pointers returned by allocate may be
+    *   passed to release and capacity.
+    */
+    class BufferPool{
+        public:
+
+        static constexpr size_t MIN_BLOCK_SIZE = 256;
+        static constexpr size_t MAX_BLOCK_SIZE = 64 * 1024;
+        static constexpr int NUM_CLASSES = 9;          // 256 .. 64K
+        static constexpr size_t SLAB_SIZE = 2 * 1024 * 1024;
+
+        // blocks kept per thread and size class, half move at a time
+        static constexpr int CACHE_BLOCKS = 64;
+
+        // constructor
+        explicit BufferPool(bool hugePages = false);
+
+        // unmaps every slab. Buffers still in use become invalid.
+        ~BufferPool();
+
+        // returns a buffer of at least len bytes, nullptr with errno
+        // EMSGSIZE when len exceeds MAX_BLOCK_SIZE, or ENOMEM
+        void* allocate(size_t len);
+
+        // returns buf to the pool that allocated it, nullptr is ignored
+        static void release(void *buf);
+
+        // usable size of a buffer from allocate
+        static size_t capacity(const void *buf);
+
+        size_t get_slabs();
+        size_t get_huge_slabs();        // mapped from reserved huge pages
+
+        // disable copy semantics
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator=(const BufferPool&) = delete;
+
+
+        private:
+
+            static constexpr uint32_t SLAB_MAGIC = 0x62756670;     // "bufp"
+
+            // first block of each slab, never handed out
+            struct slab_t{
+                uint32_t magic;
+                uint32_t sizeClass;
+                BufferPool *pool;
+            };
+
+            // a free block holds the link to the next one
+            struct free_block_t{
+                free_block_t *next;
+            };
+
+            struct central_t{
+                std::mutex lock;
+                free_block_t *freeList;
+                size_t freeCount;
+            };
+
+            struct class_cache_t{
+                int count;
+                void *blocks[CACHE_BLOCKS];
+            };
+
+            struct pool_cache_t{
+                class_cache_t classes[NUM_CLASSES];
+            };
+
+            // one per thread, indexed by pool id. Gives the cached blocks
+            // back to pools that still exist when the thread exits.
+            struct thread_caches_t{
+                std::vector<std::unique_ptr<pool_cache_t>> byPool;
+                ~thread_caches_t();
+            };
+
+            static thread_local thread_caches_t threadCaches;
+
+            uint32_t id;                    // never reused, stale caches miss
+            bool hugePages;
+            central_t central[NUM_CLASSES];
+
+            std::mutex slabLock;
+            std::vector<void*> slabs;
+            size_t hugeSlabs;
+
+            static int size_class(size_t len);
+            static slab_t* slab_of(const void *buf);
+
+            pool_cache_t& local_cache();
+            int refill(int sizeClass, class_cache_t &cache);
+            void flush(int sizeClass, class_cache_t &cache, int n);
+            int grow(int sizeClass);
+            void* map_slab();
+    };
+}
+
+
+#endif
@@ -0,0 +1,163 @@
+#include <cerrno>
+
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include "connectionPool.h"
+
+
+namespace mysocket{
+
+    ConnectionPool::Lease::Lease(){
+        pool = nullptr;
+        broken = false;
+    }
+
+    ConnectionPool::Lease::~Lease(){
+        release();
+    }
+
+    ConnectionPool::Lease::Lease(Lease&& other) noexcept
+        : pool(other.pool), key(std::move(other.key)),
+          client(std::move(other.client)), broken(other.broken){
+        other.pool = nullptr;
+    }
+
+    ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other) noexcept{
+        if(this != &other){
+            release();
+            pool = other.pool;
+            key = std::move(other.key);
+            client = std::move(other.client);
+            broken = other.broken;
+            other.pool = nullptr;
+        }
+        return *this;
+    }
+
+    void ConnectionPool::Lease::release(){
+        if(pool == nullptr){
+            return;
+        }
+        if(broken || !client.get_connect_state()){
+            client.close_socket();
+        }
+        else{
+            pool->give_back(key, std::move(client));
+        }
+        pool = nullptr;
+    }
+
+
+    ConnectionPool::ConnectionPool(size_t maxIdlePerHost, int connectTimeoutMs, int maxIdleMs){
+        maxIdle = maxIdlePerHost;
+        connectTimeout = connectTimeoutMs;
+        maxIdleTime = std::chrono::milliseconds(maxIdleMs);
+    }
+
+    ConnectionPool::~ConnectionPool(){
+        clear();
+    }
+
+    std::string ConnectionPool::make_key(const char* host, const char* port){
+        return std::string(host) + ":" + port;
+    }
+
+    bool ConnectionPool::is_usable(SocketClient &client){
+        uint8_t byte;
+
+        /** Peek without blocking. A healthy idle connection has nothing to
+        *   read (EAGAIN). 0 means the server closed it while it sat in the
+        *   pool, and unread data means a previous user left a response
+        *   behind; neither may be handed out.
+        */
+        ssize_t n = recv(client.get_fd(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    ConnectionPool::Lease ConnectionPool::acquire(const char* host, const char* port){
+        Lease lease;
+        std::string key = make_key(host, port);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::vector<idle_t> &list = idle[key];
+            Clock::time_point now = Clock::now();
+
+            // most recently returned first, it is the least likely to have
+            // been closed by the server's own idle timeout
+            while(!list.empty()){
+                idle_t entry = std::move(list.back());
+                list.pop_back();
+
+                if(now - entry.since > maxIdleTime || !is_usable(entry.client)){
+                    log_debug("discarding stale connection to %s", key.c_str());
+                    continue;
+                }
+
+                lease.pool = this;
+                lease.key = key;
+                lease.client = std::move(entry.client);
+                return lease;
+            }
+        }
+
+        // no warm connection, connect outside the lock
+        SocketClient client;
+        if(client.connect_client(port, host, connectTimeout) != 0){
+            log_warn("pool connect to %s failed", key.c_str());
+            return lease;
+        }
+
+        lease.pool = this;
+        lease.key = key;
+        lease.client = std::move(client);
+        return lease;
+    }
+
+    size_t ConnectionPool::prewarm(const char* host, const char* port, size_t count){
+        std::string key = make_key(host, port);
+        size_t have = idle_count(host, port);
+
+        if(count > maxIdle){
+            count = maxIdle;
+        }
+
+        for(; have < count; ++have){
+            SocketClient client;
+            if(client.connect_client(port, host, connectTimeout) != 0){
+                break;
+            }
+            give_back(key, std::move(client));
+        }
+        return idle_count(host, port);
+    }
+
+    size_t ConnectionPool::idle_count(const char* host, const char* port){
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = idle.find(make_key(host, port));
+        return it == idle.end() ? 0 : it->second.size();
+    }
+
+    void ConnectionPool::give_back(const std::string &key, SocketClient client){
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<idle_t> &list = idle[key];
+
+        // full, the SocketClient destructor closes the connection
+        if(list.size() >= maxIdle){
+            return;
+        }
+
+        idle_t entry;
+        entry.client = std::move(client);
+        entry.since = Clock::now();
+        list.push_back(std::move(entry));
+    }
+
+    void ConnectionPool::clear(){
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.clear();
+    }
+
+} // end namespace
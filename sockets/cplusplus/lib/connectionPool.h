@@ -0,0 +1,110 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "socketClient.h"
+
+namespace mysocket{
+
+    /*  Keeps warm client connections keyed by "host:port".
+    *
+    *   acquire hands out a Lease that owns one connected SocketClient.
+    *   When the lease goes out of scope the connection returns to the
+    *   pool for the next request, so the request path only pays for a
+    *   TCP handshake when no idle connection is available. Call
+    *   mark_broken on a lease after a protocol or I/O error so the
+    *   connection is closed rather than reused.
+    *
+    *   The pool is thread safe. It must outlive every lease it issued.
+    */
+    class ConnectionPool{
+        public:
+
+        class Lease{
+            public:
+
+            Lease();
+            ~Lease();
+
+            // move-only, exactly one owner per connection
+            Lease(Lease&&) noexcept;
+            Lease& operator=(Lease&&) noexcept;
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+
+            // false when acquire could not provide a connection
+            explicit operator bool() const {return pool != nullptr;}
+
+            SocketClient& get(){return client;}
+            SocketClient* operator->(){return &client;}
+
+            // close instead of returning to the pool
+            void mark_broken(){broken = true;}
+
+            // return to the pool now
+            void release();
+
+
+            private:
+                friend class ConnectionPool;
+
+                ConnectionPool *pool;
+                std::string key;
+                SocketClient client;
+                bool broken;
+        };
+
+        // maxIdlePerHost  idle connections kept per key, extra are closed
+        // connectTimeoutMs  deadline for each new connection
+        // maxIdleMs  idle connections older than this are discarded
+        ConnectionPool(size_t maxIdlePerHost = 8, int connectTimeoutMs = 1000,
+                        int maxIdleMs = 60000);
+        ~ConnectionPool();
+
+        // returns a connected lease, or an empty lease upon failure
+        Lease acquire(const char* host, const char* port);
+
+        // opens connections ahead of time until count are idle.
+        // returns the number of idle connections for host:port
+        size_t prewarm(const char* host, const char* port, size_t count);
+
+        size_t idle_count(const char* host, const char* port);
+
+        // closes every idle connection
+        void clear();
+
+        // disable copy semantics
+        ConnectionPool(const ConnectionPool&) = delete;
+        ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+
+        private:
+            using Clock = std::chrono::steady_clock;
+
+            struct idle_t{
+                SocketClient client;
+                Clock::time_point since;
+            };
+
+            size_t maxIdle;
+            int connectTimeout;
+            std::chrono::milliseconds maxIdleTime;
+
+            std::mutex mutex;
+            std::unordered_map<std::string, std::vector<idle_t>> idle;
+
+            static std::string make_key(const char* host, const char* port);
+            static bool is_usable(SocketClient &client);
+
+            void give_back(const std::string &key, SocketClient client);
+    };
+}
+
+
+#endif
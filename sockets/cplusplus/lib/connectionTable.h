@@ -0,0 +1,157 @@
+#ifndef CONNECTION_TABLE_H
+#define CONNECTION_TABLE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace mysocket{
+
+    /*  Table of connection state keyed by file descriptor, a slot map.
+    *
+    *   Values are stored densely, in one vector without holes, so walking
+    *   the connections touches only live ones. A second vector indexed by
+    *   descriptor holds each one's position in the dense vector, so find,
+    *   insert and erase are O(1). erase moves the last value into the hole
+    *   left behind instead of shifting or copying the rest.
+    *
+    *   The descriptor is the slot. The kernel hands out the lowest free
+    *   descriptor, which keeps the slot vector as short as the number of
+    *   open files and serves as its free list. Each slot also counts the
+    *   connections it has held. A handle combines that generation with
+    *   the descriptor: once the connection is erased, and its descriptor
+    *   perhaps reused by a new one, the handle no longer finds anything.
+    *   Timers and queued work refer to a connection by handle, so they
+    *   cannot act on the wrong client.
+    *
+    *   Values move on erase, pointers and references into the table are
+    *   good until the next insert or erase. To erase while walking, walk
+    *   backwards: the value moved into position i has been visited.
+    *
+    *       for(size_t i = table.size(); i-- > 0;){
+    *           if(done(table[i])){
+    *               table.erase(table.fd_at(i));
+    *           }
+    *       }
+    *
+    *   Not thread safe.
+    */
+    template<typename T>
+    class ConnectionTable{
+        public:
+
+        // 0 is never a valid handle, use it for "no connection"
+        using handle_t = uint64_t;
+
+        ConnectionTable() = default;
+
+        // adds the connection on fd. returns its handle, 0 when fd is
+        // negative or already in the table
+        handle_t insert(int fd, T value){
+            if(fd < 0){
+                return 0;
+            }
+            if(size_t(fd) >= slots.size()){
+                slots.resize(size_t(fd) + 1, slot_t{NIL, 1});
+            }
+
+            slot_t &slot = slots[size_t(fd)];
+            if(slot.index != NIL){
+                return 0;
+            }
+
+            slot.index = uint32_t(values.size());
+            values.push_back(std::move(value));
+            fds.push_back(fd);
+            return make_handle(fd, slot.generation);
+        }
+
+        // returns true when fd was in the table. Handles to it go stale.
+        bool erase(int fd){
+            if(fd < 0 || size_t(fd) >= slots.size() || slots[size_t(fd)].index == NIL){
+                return false;
+            }
+
+            slot_t &slot = slots[size_t(fd)];
+            uint32_t last = uint32_t(values.size() - 1);
+
+            // the last value fills the hole
+            if(slot.index != last){
+                values[slot.index] = std::move(values[last]);
+                fds[slot.index] = fds[last];
+                slots[size_t(fds[last])].index = slot.index;
+            }
+            values.pop_back();
+            fds.pop_back();
+
+            slot.index = NIL;
+            if(++slot.generation == 0){
+                slot.generation = 1;
+            }
+            return true;
+        }
+
+        // nullptr when fd is not in the table
+        T* find(int fd){
+            if(fd < 0 || size_t(fd) >= slots.size() || slots[size_t(fd)].index == NIL){
+                return nullptr;
+            }
+            return &values[slots[size_t(fd)].index];
+        }
+
+        // nullptr when the connection was erased since the handle was made
+        T* get(handle_t handle){
+            int fd = fd_of(handle);
+            T *value = find(fd);
+            if(value == nullptr || slots[size_t(fd)].generation != uint32_t(handle >> 32)){
+                return nullptr;
+            }
+            return value;
+        }
+
+        // 0 when fd is not in the table
+        handle_t get_handle(int fd){
+            if(find(fd) == nullptr){
+                return 0;
+            }
+            return make_handle(fd, slots[size_t(fd)].generation);
+        }
+
+        static int fd_of(handle_t handle){return int(uint32_t(handle));}
+
+        // dense walk, in no particular order
+        T& operator[](size_t i){return values[i];}
+        int fd_at(size_t i){return fds[i];}
+
+        typename std::vector<T>::iterator begin(){return values.begin();}
+        typename std::vector<T>::iterator end(){return values.end();}
+
+        size_t size(){return values.size();}
+        bool empty(){return values.empty();}
+
+        // disable copy semantics
+        ConnectionTable(const ConnectionTable&) = delete;
+        ConnectionTable& operator=(const ConnectionTable&) = delete;
+
+
+        private:
+
+            static constexpr uint32_t NIL = UINT32_MAX;
+
+            struct slot_t{
+                uint32_t index;             // into values, NIL when free
+                uint32_t generation;        // bumped on erase, stale handles miss
+            };
+
+            std::vector<slot_t> slots;      // indexed by fd
+            std::vector<T> values;
+            std::vector<int> fds;           // fd of values[i]
+
+            static handle_t make_handle(int fd, uint32_t generation){
+                return (handle_t(generation) << 32) | uint32_t(fd);
+            }
+    };
+}
+
+
+#endif
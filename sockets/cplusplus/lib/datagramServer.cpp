@@ -0,0 +1,289 @@
+#include <cstring>              // memset, memcpy, strerror
+#include <unistd.h>             // close
+
+#include <iostream>
+#include <cerrno>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>        // UDP_GRO, UDP_SEGMENT
+
+#include <debuglog/debuglog.h>
+
+#include "datagramServer.h"
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+
+
+namespace mysocket{
+
+    // room for one UDP_GRO control message per datagram
+    static constexpr size_t CONTROL_SIZE = 64;
+
+    DatagramServer::DatagramServer(int batch){
+        socketfd = -1;
+        batchSize = batch > 0 ? batch : BATCH_SIZE;
+        bufferSize = DATAGRAM_BUFFER_SIZE;
+        groEnabled = false;
+        queued = 0;
+        truncatedCount = 0;
+
+        sendHeaders.resize(size_t(batchSize));
+        sendIov.resize(size_t(batchSize));
+        sendAddress.resize(size_t(batchSize));
+
+        allocate_receive_buffers();
+    }
+
+    DatagramServer::~DatagramServer(){
+        close_socket();
+    }
+
+    void DatagramServer::allocate_receive_buffers(){
+        size_t n = size_t(batchSize);
+
+        receiveMemory.assign(n * bufferSize, 0);
+        receiveHeaders.assign(n, mmsghdr());
+        receiveIov.resize(n);
+        receiveControl.assign(n * CONTROL_SIZE, 0);
+        datagrams.resize(n);
+
+        for(size_t i = 0; i < n; ++i){
+            receiveIov[i].iov_base = &receiveMemory[i * bufferSize];
+            receiveIov[i].iov_len = bufferSize;
+        }
+    }
+
+    int DatagramServer::initialize(const char* port){
+        int rv;
+        struct addrinfo hints, *serverinfo, *p;
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+
+        /// SOCK_DGRAM provides connectionless, unreliable messages of a fixed maximum length
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = AI_PASSIVE;
+
+        rv = getaddrinfo(NULL, port, &hints, &serverinfo);
+        if(rv != 0){
+            std::cerr << "error: " << __func__ << ", getaddrinfo, " << gai_strerror(rv)
+                           << std::endl;
+            return -1;
+        }
+
+        for(p = serverinfo; p != NULL; p = p->ai_next){
+            socketfd = socket(p->ai_family, p->ai_socktype | SOCK_CLOEXEC, p->ai_protocol);
+            if(socketfd == -1){
+                continue;
+            }
+
+            if(bind(socketfd, p->ai_addr, p->ai_addrlen) == 0){
+                break;
+            }
+
+            std::cerr << "error: " << __func__ << ", bind "
+                << strerror(errno) << std::endl;
+            close_socket();
+        }
+
+        freeaddrinfo(serverinfo);
+
+        if(p == NULL){
+            std::cerr << "error: " << __func__ << ", initialize server failure\n";
+            return -1;
+        }
+        return 0;
+    }
+
+    int DatagramServer::enable_gro(){
+        int yes = 1;
+
+        /** UDP_GRO (Linux 5.0): the kernel may coalesce consecutive
+        *   datagrams of one flow into a single receive buffer. The segment
+        *   size arrives in a UDP_GRO control message.
+        */
+        if(setsockopt(socketfd, SOL_UDP, UDP_GRO, &yes, sizeof(yes)) != 0){
+            std::cerr << "error: " << __func__ << ", setsockopt UDP_GRO, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        groEnabled = true;
+        bufferSize = GRO_BUFFER_SIZE;
+        allocate_receive_buffers();
+        return 0;
+    }
+
+    int DatagramServer::receive_batch(int flags){
+        size_t n = size_t(batchSize);
+
+        // the kernel overwrites lengths, reset every header
+        for(size_t i = 0; i < n; ++i){
+            struct msghdr &hdr = receiveHeaders[i].msg_hdr;
+            memset(&hdr, 0, sizeof(hdr));
+            hdr.msg_name = &datagrams[i].address;
+            hdr.msg_namelen = sizeof(datagrams[i].address);
+            hdr.msg_iov = &receiveIov[i];
+            hdr.msg_iovlen = 1;
+            if(groEnabled){
+                hdr.msg_control = &receiveControl[i * CONTROL_SIZE];
+                hdr.msg_controllen = CONTROL_SIZE;
+            }
+            receiveHeaders[i].msg_len = 0;
+        }
+
+        /** int recvmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+        *                int flags, struct timespec *timeout);
+        *
+        *   Receives up to vlen datagrams in one system call. MSG_WAITFORONE
+        *   blocks for the first datagram only, then returns whatever else is
+        *   already queued instead of waiting for the batch to fill.
+        */
+        int count = recvmmsg(socketfd, receiveHeaders.data(), unsigned(n),
+                        flags | MSG_WAITFORONE, NULL);
+        if(count < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                std::cerr << "error: " << __func__ << ", recvmmsg, "
+                        << strerror(errno) << std::endl;
+            }
+            return -1;
+        }
+
+        for(int i = 0; i < count; ++i){
+            datagram_t &d = datagrams[size_t(i)];
+            struct msghdr &hdr = receiveHeaders[size_t(i)].msg_hdr;
+
+            d.data = (uint8_t*)receiveIov[size_t(i)].iov_base;
+            d.length = receiveHeaders[size_t(i)].msg_len;
+            d.addressLength = hdr.msg_namelen;
+            d.segmentSize = 0;
+
+            // recvmmsg reports a datagram cut to fit the buffer only here
+            d.truncated = (hdr.msg_flags & MSG_TRUNC) != 0;
+            if(d.truncated){
+                ++truncatedCount;
+                log_debug("datagram of fd %d truncated to %zu bytes", socketfd, d.length);
+            }
+
+            if(groEnabled){
+                for(struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr); cm != NULL; cm = CMSG_NXTHDR(&hdr, cm)){
+                    if(cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO){
+                        int segment;
+                        memcpy(&segment, CMSG_DATA(cm), sizeof(segment));
+                        d.segmentSize = uint16_t(segment);
+                    }
+                }
+            }
+        }
+
+        log_trace("received %d datagrams", count);
+        return count;
+    }
+
+    int DatagramServer::queue_send(const void *buf, size_t len,
+                const struct sockaddr_storage &to, socklen_t toLength){
+
+        if(queued == batchSize && flush() < 0){
+            return -1;
+        }
+
+        size_t i = size_t(queued);
+        memcpy(&sendAddress[i], &to, toLength);
+
+        sendIov[i].iov_base = const_cast<void*>(buf);
+        sendIov[i].iov_len = len;
+
+        struct msghdr &hdr = sendHeaders[i].msg_hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &sendAddress[i];
+        hdr.msg_namelen = toLength;
+        hdr.msg_iov = &sendIov[i];
+        hdr.msg_iovlen = 1;
+
+        ++queued;
+        return 0;
+    }
+
+    int DatagramServer::flush(){
+        int sent = 0;
+
+        while(sent < queued){
+
+            /** int sendmmsg(int sockfd, struct mmsghdr *msgvec, unsigned int vlen,
+            *                int flags);
+            *
+            *   Sends vlen datagrams in one system call. The return value may
+            *   be smaller than vlen, the remainder is sent by the next pass.
+            */
+            int rv = sendmmsg(socketfd, &sendHeaders[size_t(sent)], unsigned(queued - sent), 0);
+            if(rv < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                std::cerr << "error: " << __func__ << ", sendmmsg, "
+                        << strerror(errno) << std::endl;
+                queued = 0;
+                return sent > 0 ? sent : -1;
+            }
+            sent += rv;
+        }
+
+        queued = 0;
+        return sent;
+    }
+
+    ssize_t DatagramServer::send_segmented(const void *buf, size_t len, uint16_t segmentSize,
+                const struct sockaddr_storage &to, socklen_t toLength){
+        struct msghdr msg;
+        struct iovec iov;
+        uint8_t control[CMSG_SPACE(sizeof(uint16_t))];
+
+        iov.iov_base = const_cast<void*>(buf);
+        iov.iov_len = len;
+
+        memset(&msg, 0, sizeof(msg));
+        memset(control, 0, sizeof(control));
+        msg.msg_name = const_cast<struct sockaddr_storage*>(&to);
+        msg.msg_namelen = toLength;
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        /** UDP_SEGMENT (Linux 4.18): one send of up to 64 KB that the stack
+        *   (or the NIC) splits into datagrams of segmentSize bytes, so the
+        *   per-datagram work of the send path is done once per buffer.
+        */
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_UDP;
+        cm->cmsg_type = UDP_SEGMENT;
+        cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cm), &segmentSize, sizeof(segmentSize));
+
+        ssize_t rv = sendmsg(socketfd, &msg, 0);
+        if(rv < 0){
+            std::cerr << "error: " << __func__ << ", sendmsg UDP_SEGMENT, "
+                    << strerror(errno) << std::endl;
+        }
+        return rv;
+    }
+
+    void DatagramServer::close_socket(){
+        if(socketfd != -1){
+            close(socketfd);
+            socketfd = -1;
+        }
+    }
+
+} // end namespace
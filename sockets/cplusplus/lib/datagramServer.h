@@ -0,0 +1,122 @@
+#ifndef DATAGRAM_SERVER_H
+#define DATAGRAM_SERVER_H
+
+#include <cstdint>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>                    // struct iovec
+
+namespace mysocket{
+
+    struct datagram_t{
+        uint8_t *data;                  // points into the server's buffers
+        size_t length;
+        struct sockaddr_storage address;
+        socklen_t addressLength;
+
+        // with GRO enabled, several datagrams from one sender may arrive
+        // coalesced in one buffer, each segmentSize bytes long except
+        // possibly the last. 0 when the buffer holds a single datagram.
+        uint16_t segmentSize;
+
+        // the datagram was longer than the receive buffer, the rest was
+        // discarded by the kernel and length is the buffer size
+        bool truncated;
+    };
+
+
+    /*  UDP server that moves datagrams in batches.
+    *
+    *   receive_batch fills up to batchSize datagrams with one recvmmsg
+    *   call. Replies are queued with queue_send and transmitted together
+    *   by flush with one sendmmsg call. At high packet rates the system
+    *   call, not the copy, dominates the per-packet cost, so batching
+    *   divides most of it by the batch size.
+    *
+    *   Optional kernel offloads:
+    *       GRO  (UDP_GRO)      coalesces consecutive datagrams from one
+    *                           flow into one receive buffer
+    *       GSO  (UDP_SEGMENT)  send_segmented hands one large buffer to
+    *                           the kernel, which splits it into datagrams
+    */
+    class DatagramServer{
+        public:
+
+        // constants
+        static constexpr int BATCH_SIZE = 64;
+        static constexpr size_t DATAGRAM_BUFFER_SIZE = 2048;
+        static constexpr size_t GRO_BUFFER_SIZE = 65536;
+
+        // constructor
+        explicit DatagramServer(int batchSize = BATCH_SIZE);
+
+        // destructor
+        ~DatagramServer();
+
+        // binds a UDP socket to port, returns 0 upon success, -1 upon failure
+        int initialize(const char* port);
+
+        // enable UDP_GRO, call after initialize. Receive buffers grow to
+        // GRO_BUFFER_SIZE. returns 0 upon success, -1 upon failure
+        int enable_gro();
+
+        // receives up to batchSize datagrams, blocks for the first one
+        // unless flags has MSG_DONTWAIT. Returned datagrams stay valid
+        // until the next receive_batch call.
+        // returns number received, -1 upon failure
+        int receive_batch(int flags = 0);
+
+        datagram_t& get_datagram(int index){return datagrams[size_t(index)];}
+
+        // datagrams received truncated so far, see datagram_t
+        uint64_t get_truncated(){return truncatedCount;}
+
+        // queues one datagram, buf must stay valid until flush.
+        // a full queue is flushed first. returns 0 upon success, -1 upon failure
+        int queue_send(const void *buf, size_t len, const struct sockaddr_storage &to,
+                        socklen_t toLength);
+
+        // sends all queued datagrams, returns the number sent, -1 upon failure
+        int flush();
+
+        // one sendmsg with UDP_SEGMENT, the kernel splits buf into
+        // segmentSize datagrams. returns bytes sent, -1 upon failure
+        ssize_t send_segmented(const void *buf, size_t len, uint16_t segmentSize,
+                        const struct sockaddr_storage &to, socklen_t toLength);
+
+        int get_fd(){return socketfd;}
+
+        // disable copy semantics
+        DatagramServer(const DatagramServer&) = delete;
+        DatagramServer& operator=(const DatagramServer&) = delete;
+
+        void close_socket();
+
+
+        private:
+            int socketfd;
+            int batchSize;
+            size_t bufferSize;
+            bool groEnabled;
+
+            // receive side
+            std::vector<uint8_t> receiveMemory;
+            std::vector<struct mmsghdr> receiveHeaders;
+            std::vector<struct iovec> receiveIov;
+            std::vector<uint8_t> receiveControl;
+            std::vector<datagram_t> datagrams;
+            uint64_t truncatedCount;
+
+            // send side
+            std::vector<struct mmsghdr> sendHeaders;
+            std::vector<struct iovec> sendIov;
+            std::vector<struct sockaddr_storage> sendAddress;
+            int queued;
+
+            void allocate_receive_buffers();
+    };
+}
+
+
+#endif
@@ -0,0 +1,267 @@
+#include <cstring>              // memset, strerror
+#include <unistd.h>             // close
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include "epollEngine.h"
+
+
+namespace mysocket{
+
+    EpollEngine::EpollEngine(){
+    }
+
+    EpollEngine::~EpollEngine(){
+        for(auto &entry : connections){
+            loop.remove(entry.first);
+        }
+    }
+
+    EpollEngine::connection_t* EpollEngine::register_fd(int fd){
+        auto it = connections.find(fd);
+        if(it != connections.end()){
+            return &it->second;
+        }
+
+        if(set_nonblocking(fd) != 0){
+            return nullptr;
+        }
+
+        if(loop.add(fd, 0, [this](int readyfd, uint32_t events){
+                    handle_event(readyfd, events);}) != 0){
+            return nullptr;
+        }
+
+        return &connections[fd];
+    }
+
+    void EpollEngine::update_interest(int fd, connection_t *c){
+        uint32_t interest = 0;
+
+        if(c->accept || c->receive){
+            interest |= EventLoop::READ;
+        }
+        if(!c->sendQueue.empty()){
+            interest |= EventLoop::WRITE;
+        }
+        loop.modify(fd, interest);
+    }
+
+    int EpollEngine::accept_multishot(int listenfd, AcceptCallback cb){
+        connection_t *c = register_fd(listenfd);
+        if(c == nullptr){
+            return -1;
+        }
+        c->accept = std::move(cb);
+        update_interest(listenfd, c);
+
+        // connections may already be waiting, the edge has passed
+        handle_accept(listenfd);
+        return 0;
+    }
+
+    int EpollEngine::receive_multishot(int fd, ReceiveCallback cb){
+        connection_t *c = register_fd(fd);
+        if(c == nullptr){
+            return -1;
+        }
+        c->receive = std::move(cb);
+        update_interest(fd, c);
+
+        handle_receive(fd);
+        return 0;
+    }
+
+    int EpollEngine::send_data(int fd, const void *buf, size_t len, SendCallback cb){
+        connection_t *c = register_fd(fd);
+        if(c == nullptr){
+            return -1;
+        }
+
+        send_request_t request;
+        request.data.assign((const uint8_t*)buf, (const uint8_t*)buf + len);
+        request.offset = 0;
+        request.callback = std::move(cb);
+
+        bool wasIdle = c->sendQueue.empty();
+        c->sendQueue.push_back(std::move(request));
+
+        // try to send right away, write interest is only needed when the
+        // socket send buffer fills
+        if(wasIdle){
+            flush(fd, c);
+        }
+        return 0;
+    }
+
+    void EpollEngine::flush(int fd, connection_t *c){
+        while(!c->sendQueue.empty()){
+            send_request_t &request = c->sendQueue.front();
+
+            ssize_t bytesSent = send(fd, request.data.data() + request.offset,
+                            request.data.size() - request.offset,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+
+            if(bytesSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                break;
+            }
+
+            if(bytesSent < 0){
+                // fail every queued request
+                ssize_t result = -errno;
+                for(send_request_t &r : c->sendQueue){
+                    completions.push_back({fd, result, std::move(r.callback)});
+                }
+                c->sendQueue.clear();
+                break;
+            }
+
+            request.offset += size_t(bytesSent);
+            if(request.offset == request.data.size()){
+                completions.push_back({fd, ssize_t(request.data.size()),
+                            std::move(request.callback)});
+                c->sendQueue.pop_front();
+            }
+        }
+        update_interest(fd, c);
+    }
+
+    void EpollEngine::handle_event(int fd, uint32_t events){
+        auto it = connections.find(fd);
+        if(it == connections.end()){
+            return;
+        }
+
+        if(it->second.accept){
+            handle_accept(fd);
+            return;
+        }
+
+        if(events & (EPOLLOUT | EPOLLERR)){
+            flush(fd, &it->second);
+        }
+
+        if(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)){
+            handle_receive(fd);
+        }
+    }
+
+    void EpollEngine::handle_accept(int fd){
+        struct sockaddr_storage address;
+        socklen_t addressLength;
+
+        for(;;){
+            auto it = connections.find(fd);
+            if(it == connections.end() || !it->second.accept){
+                return;
+            }
+
+            addressLength = sizeof(address);
+            memset(&address, 0, sizeof(address));
+            int connfd = accept4(fd, (struct sockaddr*)&address, &addressLength,
+                            SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if(connfd == -1){
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    return;
+                }
+                if(errno == EINTR || errno == ECONNABORTED){
+                    continue;
+                }
+
+                /** The connections stay in the listen queue, but the edge
+                *   that announced them has passed and no new one comes
+                *   until another client connects. Accept again after a
+                *   pause, by then other connections may have closed.
+                */
+                int error = errno;
+                if(it->second.acceptRetry == 0){
+                    it->second.acceptRetry = loop.get_timers().schedule(ACCEPT_BACKOFF_MS,
+                                [this, fd]{
+                        auto retry = connections.find(fd);
+                        if(retry != connections.end()){
+                            retry->second.acceptRetry = 0;
+                            handle_accept(fd);
+                        }
+                    });
+                }
+
+                // copy, the callback may cancel fd
+                AcceptCallback cb = it->second.accept;
+                cb(-error, address);
+                return;
+            }
+
+            AcceptCallback cb = it->second.accept;
+            cb(connfd, address);
+        }
+    }
+
+    void EpollEngine::handle_receive(int fd){
+        for(;;){
+            auto it = connections.find(fd);
+            if(it == connections.end() || !it->second.receive){
+                return;
+            }
+
+            ssize_t bytesRead = recv(fd, receiveBuffer, BUFFER_SIZE, 0);
+            if(bytesRead < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                return;
+            }
+            if(bytesRead < 0 && errno == EINTR){
+                continue;
+            }
+
+            ReceiveCallback cb = it->second.receive;
+            if(bytesRead <= 0){
+                // end of stream or error, receiving stops
+                ssize_t result = bytesRead < 0 ? -errno : 0;
+                it->second.receive = nullptr;
+                update_interest(fd, &it->second);
+                cb(fd, receiveBuffer, result);
+                return;
+            }
+
+            cb(fd, receiveBuffer, bytesRead);
+        }
+    }
+
+    int EpollEngine::cancel(int fd){
+        auto it = connections.find(fd);
+        if(it == connections.end()){
+            return -1;
+        }
+        if(it->second.acceptRetry != 0){
+            loop.get_timers().cancel(it->second.acceptRetry);
+        }
+        connections.erase(it);
+        return loop.remove(fd);
+    }
+
+    int EpollEngine::run_once(int timeoutMs){
+        int count = 0;
+
+        // do not block while completions are waiting to be reported
+        int rv = loop.run_once(completions.empty() ? timeoutMs : 0);
+        if(rv < 0){
+            return -1;
+        }
+        count += rv;
+
+        std::vector<completion_t> ready;
+        ready.swap(completions);
+        for(completion_t &done : ready){
+            if(done.callback){
+                done.callback(done.fd, done.result);
+            }
+            ++count;
+        }
+        return count;
+    }
+
+} // end namespace
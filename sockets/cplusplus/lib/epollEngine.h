@@ -0,0 +1,78 @@
+#ifndef EPOLL_ENGINE_H
+#define EPOLL_ENGINE_H
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "eventLoop.h"
+#include "ioEngine.h"
+
+namespace mysocket{
+
+    /*  IoEngine implemented with readiness notifications from EventLoop.
+    *   Each readiness event is followed by accept4/recv/send calls until
+    *   they return EAGAIN. Used when io_uring is unavailable.
+    */
+    class EpollEngine : public IoEngine{
+        public:
+
+        // wait before accepting again after accept4 fails, EMFILE and the like
+        static constexpr int ACCEPT_BACKOFF_MS = 100;
+
+        EpollEngine();
+        ~EpollEngine() override;
+
+        const char* name() override {return "epoll";}
+
+        int accept_multishot(int listenfd, AcceptCallback cb) override;
+        int receive_multishot(int fd, ReceiveCallback cb) override;
+        int send_data(int fd, const void *buf, size_t len, SendCallback cb = nullptr) override;
+        int cancel(int fd) override;
+        int run_once(int timeoutMs) override;
+
+        // disable copy semantics
+        EpollEngine(const EpollEngine&) = delete;
+        EpollEngine& operator=(const EpollEngine&) = delete;
+
+
+        private:
+
+            struct send_request_t{
+                std::vector<uint8_t> data;
+                size_t offset;
+                SendCallback callback;
+            };
+
+            struct completion_t{
+                int fd;
+                ssize_t result;
+                SendCallback callback;
+            };
+
+            struct connection_t{
+                AcceptCallback accept;
+                ReceiveCallback receive;
+                std::deque<send_request_t> sendQueue;
+                TimerWheel::timer_id_t acceptRetry = 0;     // backing off
+            };
+
+            EventLoop loop;
+            std::unordered_map<int, connection_t> connections;
+
+            // send completions waiting to be reported by run_once
+            std::vector<completion_t> completions;
+
+            uint8_t receiveBuffer[BUFFER_SIZE];
+
+            connection_t* register_fd(int fd);
+            void update_interest(int fd, connection_t *c);
+            void handle_event(int fd, uint32_t events);
+            void handle_accept(int fd);
+            void handle_receive(int fd);
+            void flush(int fd, connection_t *c);
+    };
+}
+
+
+#endif
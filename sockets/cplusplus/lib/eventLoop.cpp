@@ -0,0 +1,193 @@
+#include <cstring>              // strerror
+#include <unistd.h>             // close
+#include <fcntl.h>              // fcntl
+
+#include <iostream>
+#include <cerrno>
+
+#include <debuglog/debuglog.h>
+
+#include "eventLoop.h"
+
+
+namespace mysocket{
+
+    EventLoop::EventLoop(){
+        running = false;
+        nextGeneration = 0;
+
+        /** int epoll_create1(int flags);
+        *
+        *   Creates an epoll instance and returns a file descriptor referring
+        *   to it. EPOLL_CLOEXEC keeps the descriptor from leaking into
+        *   child processes created with exec.
+        */
+        epollfd = epoll_create1(EPOLL_CLOEXEC);
+        if(epollfd == -1){
+            std::cerr << "error: " << __func__ << ", epoll_create1, "
+                    << strerror(errno) << std::endl;
+        }
+    }
+
+    EventLoop::~EventLoop(){
+        if(epollfd != -1){
+            close(epollfd);
+            epollfd = -1;
+        }
+    }
+
+    int EventLoop::add(int fd, uint32_t interest, Callback cb){
+        struct epoll_event ev;
+
+        if(epollfd == -1 || handlers.count(fd) != 0){
+            std::cerr << "error: " << __func__ << ", fd " << fd
+                    << " cannot be added" << std::endl;
+            return -1;
+        }
+
+        std::shared_ptr<handler_t> h = std::make_shared<handler_t>();
+        h->callback = std::move(cb);
+        h->interest = interest;
+        h->generation = nextGeneration++;
+
+        /** The generation is packed next to the fd in the event data. A
+        *   descriptor that is closed and reused by a later accept within
+        *   the same batch of events gets a new generation, so stale events
+        *   for the old connection are discarded in run_once.
+        */
+        memset(&ev, 0, sizeof(ev));
+        ev.events = interest | EPOLLET;
+        ev.data.u64 = (uint64_t(h->generation) << 32) | uint32_t(fd);
+
+        if(epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev) != 0){
+            std::cerr << "error: " << __func__ << ", epoll_ctl add fd " << fd
+                    << ", " << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        handlers[fd] = std::move(h);
+        return 0;
+    }
+
+    int EventLoop::modify(int fd, uint32_t interest){
+        struct epoll_event ev;
+
+        auto it = handlers.find(fd);
+        if(it == handlers.end()){
+            return -1;
+        }
+
+        // nothing to do, avoid the system call
+        if(it->second->interest == interest){
+            return 0;
+        }
+
+        /** Re-arming with EPOLL_CTL_MOD also re-reports a readiness state
+        *   that is already true, e.g. adding WRITE interest on a socket
+        *   with send buffer space produces an EPOLLOUT edge right away.
+        */
+        memset(&ev, 0, sizeof(ev));
+        ev.events = interest | EPOLLET;
+        ev.data.u64 = (uint64_t(it->second->generation) << 32) | uint32_t(fd);
+
+        if(epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &ev) != 0){
+            std::cerr << "error: " << __func__ << ", epoll_ctl mod fd " << fd
+                    << ", " << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        it->second->interest = interest;
+        return 0;
+    }
+
+    int EventLoop::remove(int fd){
+        auto it = handlers.find(fd);
+        if(it == handlers.end()){
+            return -1;
+        }
+        handlers.erase(it);
+
+        /** Remove before closing fd. The epoll set holds the open file,
+        *   not the descriptor: close drops the entry only when no other
+        *   descriptor, a dup or a copy passed to another process, still
+        *   refers to that file. Otherwise the entry stays and keeps
+        *   reporting events, and EPOLL_CTL_DEL on the closed fd fails with
+        *   EBADF. ENOENT/EBADF are tolerated for callers that closed fd
+        *   first knowing it was not shared.
+        */
+        if(epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL) != 0 &&
+                errno != ENOENT && errno != EBADF){
+            std::cerr << "error: " << __func__ << ", epoll_ctl del fd " << fd
+                    << ", " << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    int EventLoop::run_once(int timeoutMs, const sigset_t *sigmask){
+        struct epoll_event events[MAX_EVENTS];
+        int numEvents;
+
+        // wake up in time for the next timer
+        int timerMs = timers.next_timeout_ms();
+        if(timerMs >= 0 && (timeoutMs < 0 || timerMs < timeoutMs)){
+            timeoutMs = timerMs;
+        }
+
+        numEvents = epoll_pwait(epollfd, events, MAX_EVENTS, timeoutMs, sigmask);
+        if(numEvents < 0){
+            if(errno == EINTR){
+                // a steady stream of signals must not hold the timers back
+                timers.expire();
+                return 0;
+            }
+            std::cerr << "error: " << __func__ << ", epoll_pwait, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        int dispatched = 0;
+        for(int i = 0; i < numEvents; ++i){
+            int fd = int(uint32_t(events[i].data.u64));
+            uint32_t generation = uint32_t(events[i].data.u64 >> 32);
+
+            auto it = handlers.find(fd);
+            if(it == handlers.end() || it->second->generation != generation){
+                log_trace("discarding stale event, fd: %d", fd);
+                continue;
+            }
+
+            // hold a reference, the callback may remove its own fd
+            std::shared_ptr<handler_t> h = it->second;
+            h->callback(fd, events[i].events);
+            ++dispatched;
+        }
+
+        timers.expire();
+        return dispatched;
+    }
+
+    void EventLoop::run(){
+        running = true;
+        while(running){
+            if(run_once(-1) < 0){
+                break;
+            }
+        }
+    }
+
+
+    int set_nonblocking(int fd){
+        int flags = fcntl(fd, F_GETFL, 0);
+        if(flags == -1){
+            return -1;
+        }
+        if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1){
+            std::cerr << "error: " << __func__ << ", fcntl, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+} // end namespace
@@ -0,0 +1,104 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+#include <signal.h>                     // sigset_t
+#include <sys/epoll.h>
+
+#include "timerWheel.h"
+
+namespace mysocket{
+
+    /*  Edge-triggered epoll reactor.
+    *
+    *   Each registered file descriptor has an interest mask (READ, WRITE or
+    *   both) and a callback. run_once waits for readiness and invokes the
+    *   callback of each ready descriptor only, so the cost of a wakeup is
+    *   proportional to the number of ready sockets rather than the number
+    *   of registered sockets.
+    *
+    *   Edge-triggered mode reports a transition to ready once. Callbacks
+    *   must read (or write) until the call fails with EAGAIN, which means
+    *   registered descriptors must be non-blocking. See set_nonblocking.
+    *
+    *   Timers armed on get_timers() run from run_once as well, which
+    *   shortens its wait to the next one due.
+    */
+    class EventLoop{
+        public:
+
+        // interest flags
+        static constexpr uint32_t READ = EPOLLIN | EPOLLRDHUP;
+        static constexpr uint32_t WRITE = EPOLLOUT;
+
+        // maximum number of events returned by one epoll_wait call
+        static constexpr int MAX_EVENTS = 256;
+
+        // events is the ready mask reported by epoll (EPOLLIN, EPOLLOUT,
+        // EPOLLRDHUP, EPOLLHUP, EPOLLERR)
+        using Callback = std::function<void(int fd, uint32_t events)>;
+
+        // constructor
+        EventLoop();
+
+        // destructor
+        ~EventLoop();
+
+        // returns 0 upon success, -1 upon failure
+        int add(int fd, uint32_t interest, Callback cb);
+        int modify(int fd, uint32_t interest);
+        int remove(int fd);
+
+        // waits up to timeoutMs milliseconds (-1 blocks indefinitely) and
+        // dispatches ready callbacks, then due timers. sigmask, when not null, is installed
+        // for the duration of the wait as with pselect.
+        // returns the number of descriptor callbacks run, stale events of
+        // removed descriptors and timers are not counted. 0 on timeout or
+        // when a signal interrupted the wait, -1 on error
+        int run_once(int timeoutMs, const sigset_t *sigmask = nullptr);
+
+        // dispatches events until stop is called
+        void run();
+        void stop(){running = false;}
+
+        int get_fd(){return epollfd;}
+        bool is_registered(int fd){return handlers.count(fd) != 0;}
+        size_t size(){return handlers.size();}
+
+        // idle timeouts, heartbeats and deadlines for the registered sockets
+        TimerWheel& get_timers(){return timers;}
+
+        // disable copy semantics
+        EventLoop(const EventLoop&) = delete;
+        EventLoop& operator=(const EventLoop&) = delete;
+
+
+        private:
+
+            struct handler_t{
+                Callback callback;
+                uint32_t interest;
+                uint32_t generation;
+            };
+
+            int epollfd;
+            bool running;
+            uint32_t nextGeneration;
+            TimerWheel timers;
+
+            // shared_ptr keeps a handler alive while its callback runs,
+            // even if the callback removes its own descriptor
+            std::unordered_map<int, std::shared_ptr<handler_t>> handlers;
+    };
+
+
+    // sets O_NONBLOCK on fd, returns 0 upon success, -1 upon failure
+    int set_nonblocking(int fd);
+}
+
+
+#endif
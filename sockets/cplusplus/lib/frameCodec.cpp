@@ -0,0 +1,100 @@
+#include <cstring>              // strerror
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <debuglog/debuglog.h>
+
+#include "frameCodec.h"
+#include "socketIO.h"
+
+
+namespace mysocket{
+
+    void encode_frame_header(uint8_t *header, uint32_t length){
+        header[0] = uint8_t(length >> 24);
+        header[1] = uint8_t(length >> 16);
+        header[2] = uint8_t(length >> 8);
+        header[3] = uint8_t(length);
+    }
+
+    ssize_t send_frame(int fd, const void *payload, uint32_t length){
+        uint8_t header[FRAME_HEADER_SIZE];
+        struct iovec iov[2];
+
+        encode_frame_header(header, length);
+
+        iov[0].iov_base = header;
+        iov[0].iov_len = FRAME_HEADER_SIZE;
+        iov[1].iov_base = const_cast<void*>(payload);
+        iov[1].iov_len = length;
+
+        return send_iov(fd, iov, length > 0 ? 2 : 1);
+    }
+
+    FrameReader::FrameReader(int fd, size_t capacity) : ring(capacity){
+        socketfd = fd;
+        pendingConsume = 0;
+    }
+
+    ssize_t FrameReader::fill(){
+        ring.consume(pendingConsume);
+        pendingConsume = 0;
+
+        if(ring.writable() == 0){
+            // next has not been called to drain the complete frames
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        /** The mirrored mapping makes the free space contiguous, so one
+        *   recv fills all of it even when it wraps around the ring.
+        */
+        ssize_t n = recv(socketfd, ring.write_ptr(), ring.writable(), 0);
+        if(n < 0){
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                std::cerr << "error: " << __func__ << ", recv, "
+                        << strerror(errno) << std::endl;
+            }
+            return -1;
+        }
+
+        ring.commit(size_t(n));
+        log_trace("fd %d buffered %zd bytes, %zu total", socketfd, n, ring.readable());
+        return n;
+    }
+
+    int FrameReader::next(frame_view_t &frame){
+        ring.consume(pendingConsume);
+        pendingConsume = 0;
+
+        if(ring.readable() < FRAME_HEADER_SIZE){
+            return 0;
+        }
+
+        const uint8_t *p = ring.read_ptr();
+        uint32_t length = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16)
+                        | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+
+        if(length > max_frame_size()){
+            std::cerr << "error: " << __func__ << ", fd " << socketfd
+                    << " frame length " << length << " exceeds "
+                    << max_frame_size() << std::endl;
+            return -1;
+        }
+
+        if(ring.readable() < FRAME_HEADER_SIZE + length){
+            return 0;
+        }
+
+        // contiguous even across the wrap point, see RingBuffer
+        frame.data = p + FRAME_HEADER_SIZE;
+        frame.length = length;
+        pendingConsume = FRAME_HEADER_SIZE + length;
+        return 1;
+    }
+
+} // end namespace
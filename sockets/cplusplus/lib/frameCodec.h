@@ -0,0 +1,78 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <cstdint>
+
+#include <sys/types.h>
+
+#include "ringBuffer.h"
+
+namespace mysocket{
+
+    // frame layout: 4 byte big endian payload length, then the payload
+    constexpr size_t FRAME_HEADER_SIZE = 4;
+
+    struct frame_view_t{
+        const uint8_t *data;            // points into the reader's ring buffer
+        uint32_t length;
+    };
+
+    // writes the big endian length header for a payload of length bytes
+    void encode_frame_header(uint8_t *header, uint32_t length);
+
+    // sends header and payload together with one sendmsg, no copy into a
+    // staging buffer. returns bytes sent including the header, -1 on error
+    ssize_t send_frame(int fd, const void *payload, uint32_t length);
+
+
+    /*  Reassembles length-prefixed frames from a stream socket.
+    *
+    *   fill reads as many bytes as fit into a per-connection ring buffer
+    *   with one recv, however many frames that covers. next then returns
+    *   each complete frame as a view into the ring, so a burst of small
+    *   messages costs one system call and no allocation or copy. A frame
+    *   split across reads stays in the ring until the rest arrives.
+    *
+    *   Views returned by next stay valid until the next fill call.
+    */
+    class FrameReader{
+        public:
+
+        // constants
+        static constexpr size_t DEFAULT_CAPACITY = 65536;
+
+        // the largest accepted payload is capacity - FRAME_HEADER_SIZE
+        FrameReader(int fd, size_t capacity = DEFAULT_CAPACITY);
+
+        bool is_ready(){return ring.is_ready();}
+
+        // reads from the socket into the free space of the ring.
+        // returns bytes read, 0 when the peer closed the connection,
+        // -1 on error (errno EAGAIN on a drained non-blocking socket)
+        ssize_t fill();
+
+        // returns 1 and sets frame when a complete frame is buffered,
+        // 0 when more bytes are needed, -1 when the length header exceeds
+        // max_frame_size, after which the stream cannot be resynchronized
+        int next(frame_view_t &frame);
+
+        size_t max_frame_size(){return ring.get_capacity() - FRAME_HEADER_SIZE;}
+        size_t buffered(){return ring.readable();}
+
+        // disable copy semantics
+        FrameReader(const FrameReader&) = delete;
+        FrameReader& operator=(const FrameReader&) = delete;
+
+
+        private:
+            int socketfd;
+            RingBuffer ring;
+
+            // bytes of the frame last returned by next, released on the
+            // following call to next or fill
+            size_t pendingConsume;
+    };
+}
+
+
+#endif
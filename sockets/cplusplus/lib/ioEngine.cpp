@@ -0,0 +1,21 @@
+#include <debuglog/debuglog.h>
+
+#include "ioEngine.h"
+#include "epollEngine.h"
+#include "uringEngine.h"
+
+
+namespace mysocket{
+
+    std::unique_ptr<IoEngine> IoEngine::create(bool preferUring){
+        if(preferUring){
+            std::unique_ptr<UringEngine> uring(new UringEngine());
+            if(uring->is_ready()){
+                return uring;
+            }
+            log_info("io_uring not available, falling back to epoll");
+        }
+        return std::unique_ptr<IoEngine>(new EpollEngine());
+    }
+
+} // end namespace
@@ -0,0 +1,81 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include <sys/types.h>                  // ssize_t
+#include <sys/socket.h>                 // struct sockaddr_storage
+
+namespace mysocket{
+
+    /*  Asynchronous accept/receive/send interface.
+    *
+    *   An engine owns all socket I/O for the descriptors handed to it.
+    *   Operations are queued and completed from run_once, which invokes
+    *   the callbacks. Two implementations exist:
+    *
+    *       UringEngine   io_uring, batched submission, registered buffers,
+    *                     multishot accept and receive
+    *       EpollEngine   EventLoop based, used when the running kernel
+    *                     lacks the io_uring features UringEngine needs
+    *
+    *   IoEngine::create picks the best one available.
+    */
+    class IoEngine{
+        public:
+
+        // size of each receive/send buffer owned by an engine. Large
+        // enough that a busy stream moves a full socket buffer's worth
+        // of bytes in a few operations.
+        static constexpr size_t BUFFER_SIZE = 16384;
+
+        // number of receive buffers and number of send buffers, together
+        // 4 MB, within the default RLIMIT_MEMLOCK of 8 MB
+        static constexpr unsigned NUM_BUFFERS = 128;
+
+        // fd of the new connection, or a negative errno value upon failure
+        using AcceptCallback = std::function<void(int fd, const struct sockaddr_storage &address)>;
+
+        // data is only valid for the duration of the callback
+        // numBytes == 0, peer closed the connection
+        // numBytes < 0, negative errno value
+        using ReceiveCallback = std::function<void(int fd, const uint8_t *data, ssize_t numBytes)>;
+
+        // result is the number of bytes sent or a negative errno value
+        using SendCallback = std::function<void(int fd, ssize_t result)>;
+
+        virtual ~IoEngine() = default;
+
+        virtual const char* name() = 0;
+
+        // keeps accepting connections on listenfd until cancel(listenfd)
+        // returns 0 upon success, -1 upon failure
+        virtual int accept_multishot(int listenfd, AcceptCallback cb) = 0;
+
+        // keeps receiving on fd until the peer closes, an error occurs,
+        // or cancel(fd), returns 0 upon success, -1 upon failure
+        virtual int receive_multishot(int fd, ReceiveCallback cb) = 0;
+
+        // buf is copied, the caller may reuse it when send_data returns.
+        // Sends on the same fd complete in order. cb may be null.
+        // returns 0 upon success, -1 upon failure
+        virtual int send_data(int fd, const void *buf, size_t len, SendCallback cb = nullptr) = 0;
+
+        // stops all operations on fd, call before closing fd
+        virtual int cancel(int fd) = 0;
+
+        // submits queued operations, waits up to timeoutMs milliseconds
+        // (-1 blocks) for completions and dispatches callbacks.
+        // returns the number of completions, -1 on error
+        virtual int run_once(int timeoutMs) = 0;
+
+        // io_uring when the kernel supports it, otherwise epoll
+        static std::unique_ptr<IoEngine> create(bool preferUring = true);
+    };
+}
+
+
+#endif
@@ -0,0 +1,327 @@
+#include <cstring>              // memset, strerror
+#include <unistd.h>             // close, unlink, geteuid
+
+#include <algorithm>            // std::min
+#include <iostream>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/stat.h>           // lstat
+#include <sys/time.h>           // struct timeval
+
+#include <debuglog/debuglog.h>
+
+#include "listenerHandoff.h"
+#include "unixSocket.h"
+
+
+namespace mysocket{
+
+    // bounds blocking sends and receives on the control connection
+    static int set_timeout(int fd, int timeoutMs){
+        struct timeval tv;
+        tv.tv_sec = timeoutMs / 1000;
+        tv.tv_usec = (timeoutMs % 1000) * 1000;
+
+        if(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) != 0 ||
+                setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) != 0){
+            std::cerr << "error: " << __func__ << ", setsockopt, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    static void close_all(std::vector<int> *fds){
+        for(int fd : *fds){
+            close(fd);
+        }
+        fds->clear();
+    }
+
+
+    ListenerHandoff::ListenerHandoff(){
+        socketfd = -1;
+    }
+
+    ListenerHandoff::~ListenerHandoff(){
+        close_socket();
+    }
+
+    int ListenerHandoff::initialize(const char *controlAddress){
+        unix_address_t ua;
+        struct stat st;
+
+        if(parse_unix_address(controlAddress, &ua) != 0){
+            return -1;
+        }
+
+        // a process answering on the address is alive, do not steal it
+        int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if(probe != -1){
+            if(connect(probe, (const struct sockaddr*)(const void*)&ua.address, ua.length) == 0){
+                close(probe);
+                std::cerr << "error: " << __func__ << ", " << ua.name
+                        << " is served by another process" << std::endl;
+                errno = EADDRINUSE;
+                return -1;
+            }
+            close(probe);
+        }
+
+        // left behind by a process that exited without close_socket
+        if(!ua.abstract && lstat(ua.name.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)){
+            unlink(ua.name.c_str());
+        }
+
+        // non-blocking, a readiness report that went stale must not block
+        // hand_off in accept
+        socketfd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(socketfd == -1){
+            std::cerr << "error: " << __func__ << ", socket, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        if(bind(socketfd, (const struct sockaddr*)(const void*)&ua.address, ua.length) != 0){
+            std::cerr << "error: " << __func__ << ", bind " << ua.name << ", "
+                    << strerror(errno) << std::endl;
+            close_socket();
+            return -1;
+        }
+        if(!ua.abstract){
+            unixPath = ua.name;
+        }
+
+        if(listen(socketfd, 1) != 0){
+            std::cerr << "error: " << __func__ << ", listen, "
+                    << strerror(errno) << std::endl;
+            close_socket();
+            return -1;
+        }
+
+        log_debug("handoff control on %s", controlAddress);
+        return 0;
+    }
+
+    int ListenerHandoff::take_over(const char *controlAddress, std::vector<int> *listeners,
+                                   std::vector<int> *connections, int timeoutMs){
+        unix_address_t ua;
+        int control = -1;
+        bool done = false;
+
+        listeners->clear();
+        connections->clear();
+
+        if(parse_unix_address(controlAddress, &ua) != 0){
+            return -1;
+        }
+
+        int peer = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if(peer == -1){
+            std::cerr << "error: " << __func__ << ", socket, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        if(connect(peer, (const struct sockaddr*)(const void*)&ua.address, ua.length) != 0){
+            int error = errno;
+            close(peer);
+
+            // nothing to take over, the caller starts from scratch
+            if(error == ENOENT || error == ECONNREFUSED){
+                log_debug("no process on %s", controlAddress);
+                return 0;
+            }
+            std::cerr << "error: " << __func__ << ", connect " << ua.name << ", "
+                    << strerror(error) << std::endl;
+            return -1;
+        }
+
+        if(!same_user(peer) || set_timeout(peer, timeoutMs) != 0){
+            close(peer);
+            return -1;
+        }
+
+        while(!done){
+            message_t msg;
+            int fds[MAX_PASSED_FDS];
+            int count;
+
+            ssize_t n = receive_fds(peer, fds, MAX_PASSED_FDS, &count, &msg, sizeof(msg));
+            if(n != ssize_t(sizeof(msg)) || msg.magic != HANDOFF_MAGIC ||
+                    msg.count != uint32_t(count)){
+                log_error("handoff from %s failed, %s", controlAddress,
+                            n < 0 ? strerror(errno) : "unexpected message");
+                for(int i = 0; i < count; ++i){
+                    close(fds[i]);
+                }
+                break;
+            }
+
+            switch(msg.kind){
+                case CONTROL:
+                    if(count < 1 || control != -1){
+                        for(int i = 0; i < count; ++i){
+                            close(fds[i]);
+                        }
+                        n = -1;
+                        break;
+                    }
+                    control = fds[0];
+                    listeners->insert(listeners->end(), fds + 1, fds + count);
+                    break;
+                case CONNECTIONS:
+                    connections->insert(connections->end(), fds, fds + count);
+                    break;
+                case END:
+                    done = true;
+                    break;
+                default:
+                    for(int i = 0; i < count; ++i){
+                        close(fds[i]);
+                    }
+                    n = -1;
+                    break;
+            }
+            if(n == -1){
+                log_error("handoff from %s failed, unexpected message", controlAddress);
+                break;
+            }
+        }
+
+        /** The running process keeps serving until it reads the
+        *   confirmation. Without it, nothing was taken over, and the
+        *   descriptors are given up again.
+        */
+        if(!done || control == -1 || send_message(peer, CONFIRM, NULL, 0) != 0){
+            if(control != -1){
+                close(control);
+            }
+            close_all(listeners);
+            close_all(connections);
+            close(peer);
+            return -1;
+        }
+        close(peer);
+
+        close_socket();
+        socketfd = control;
+
+        // a control socket bound to a path is now this process's to remove
+        if(!ua.abstract){
+            unixPath = ua.name;
+        }
+
+        log_info("took over %lu listeners and %lu connections from %s",
+                    listeners->size(), connections->size(), controlAddress);
+        return 1;
+    }
+
+    int ListenerHandoff::hand_off(const std::vector<int> &listeners,
+                                  const std::vector<int> &connections, int timeoutMs){
+        int fds[MAX_PASSED_FDS];
+        message_t confirm;
+
+        if(socketfd == -1 || listeners.size() > size_t(MAX_PASSED_FDS - 1)){
+            errno = EINVAL;
+            return -1;
+        }
+
+        int peer = accept4(socketfd, NULL, NULL, SOCK_CLOEXEC);
+        if(peer == -1){
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                std::cerr << "error: " << __func__ << ", accept4, "
+                        << strerror(errno) << std::endl;
+            }
+            return -1;
+        }
+
+        if(!same_user(peer) || set_timeout(peer, timeoutMs) != 0){
+            close(peer);
+            return -1;
+        }
+
+        // the control socket goes first, so the successor can be replaced too
+        fds[0] = socketfd;
+        for(size_t i = 0; i < listeners.size(); ++i){
+            fds[i + 1] = listeners[i];
+        }
+        if(send_message(peer, CONTROL, fds, int(listeners.size()) + 1) != 0){
+            close(peer);
+            return -1;
+        }
+
+        for(size_t i = 0; i < connections.size(); i += MAX_PASSED_FDS){
+            int count = int(std::min(connections.size() - i, size_t(MAX_PASSED_FDS)));
+            if(send_message(peer, CONNECTIONS, connections.data() + i, count) != 0){
+                close(peer);
+                return -1;
+            }
+        }
+
+        if(send_message(peer, END, NULL, 0) != 0){
+            close(peer);
+            return -1;
+        }
+
+        ssize_t n = recv(peer, &confirm, sizeof(confirm), 0);
+        close(peer);
+        if(n != ssize_t(sizeof(confirm)) || confirm.magic != HANDOFF_MAGIC ||
+                confirm.kind != CONFIRM){
+            log_warn("successor did not confirm the handoff, %s",
+                        n < 0 ? strerror(errno) : "connection closed");
+            return -1;
+        }
+
+        // the successor owns the control socket now, and its path
+        close(socketfd);
+        socketfd = -1;
+        unixPath.clear();
+
+        log_info("handed off %lu listeners and %lu connections",
+                    listeners.size(), connections.size());
+        return 0;
+    }
+
+    void ListenerHandoff::close_socket(){
+        if(socketfd != -1){
+            close(socketfd);
+            socketfd = -1;
+        }
+        if(!unixPath.empty()){
+            unlink(unixPath.c_str());
+            unixPath.clear();
+        }
+    }
+
+    bool ListenerHandoff::same_user(int peerfd){
+        struct ucred cred;
+        socklen_t length = sizeof(cred);
+
+        /** SO_PEERCRED returns the pid, uid and gid of the process at the
+        *   other end, as recorded by the kernel at connect. An abstract
+        *   name can be reached by any user on the host, whoever connects
+        *   would receive the listening sockets.
+        */
+        if(getsockopt(peerfd, SOL_SOCKET, SO_PEERCRED, &cred, &length) != 0){
+            std::cerr << "error: " << __func__ << ", getsockopt SO_PEERCRED, "
+                    << strerror(errno) << std::endl;
+            return false;
+        }
+        if(cred.uid != geteuid()){
+            log_warn("handoff refused, peer pid %d runs as uid %u", cred.pid, cred.uid);
+            return false;
+        }
+        return true;
+    }
+
+    int ListenerHandoff::send_message(int peerfd, kind_t kind, const int *fds, int count){
+        message_t msg;
+        msg.magic = HANDOFF_MAGIC;
+        msg.kind = kind;
+        msg.count = uint32_t(count);
+        return send_fds(peerfd, fds, count, &msg, sizeof(msg));
+    }
+
+} // end namespace
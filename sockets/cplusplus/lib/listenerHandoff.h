@@ -0,0 +1,109 @@
+#ifndef LISTENER_HANDOFF_H
+#define LISTENER_HANDOFF_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mysocket{
+
+    /*  Restart without refusing connections: a new process takes the
+    *   listening sockets over from the running one.
+    *
+    *   Closing a listener and binding a new one, even with SO_REUSEADDR,
+    *   leaves a window in which connections are refused, and throws away
+    *   those already waiting in the listen queue. Here the listening
+    *   socket itself moves: the running process passes it over a unix
+    *   socket with SCM_RIGHTS, and both processes then hold the same
+    *   socket with the same queue. The new process starts accepting, the
+    *   old one stops and drains its connections. Established connections
+    *   may be passed too, when the application keeps no state for them
+    *   that would have to move with them.
+    *
+    *       running process                 new process
+    *       initialize(control)
+    *       ... serves, watches get_fd()
+    *                                       take_over(control, &l, &c) == 1
+    *       get_fd() readable
+    *       hand_off(listeners, conns) --->
+    *                                  <--- confirmation
+    *       == 0: stop accepting, drain     adopts l[0], serves
+    *
+    *   The control socket is passed along as well, so the new process can
+    *   itself be replaced later. Only a process running as the same user
+    *   is served, the peer credentials are checked on both sides.
+    *
+    *   The control address is a unix address, "unix:/run/app.handoff" or
+    *   "unix:@app.handoff", see unixSocket.h. A SOCK_SEQPACKET socket is
+    *   used either way, so each message arrives whole with its descriptors.
+    */
+    class ListenerHandoff{
+        public:
+
+        static constexpr int DEFAULT_TIMEOUT_MS = 5000;
+
+        // constructor
+        ListenerHandoff();
+
+        // destructor
+        ~ListenerHandoff();
+
+        // running process: listens on controlAddress for a successor.
+        // returns 0 upon success, -1 upon failure, errno EADDRINUSE when
+        // another process already listens there
+        int initialize(const char *controlAddress);
+
+        // new process: connects to the process listening on
+        // controlAddress and receives its listeners and connections,
+        // which the caller then owns, and its control socket, which this
+        // object then owns. returns 1 when taken over, 0 when no process
+        // listens there (start normally, then initialize), -1 upon failure
+        int take_over(const char *controlAddress, std::vector<int> *listeners,
+                      std::vector<int> *connections, int timeoutMs = DEFAULT_TIMEOUT_MS);
+
+        // running process, when get_fd() is readable: accepts the successor
+        // and passes it listeners (at most 15) and connections. returns 0
+        // once the successor confirmed, then stop accepting, close the
+        // listeners without unlinking their paths (SocketServer::release)
+        // and drain. returns -1 upon failure, keep serving.
+        int hand_off(const std::vector<int> &listeners, const std::vector<int> &connections,
+                     int timeoutMs = DEFAULT_TIMEOUT_MS);
+
+        // readable when a successor connects, for select, poll or EventLoop
+        int get_fd(){return socketfd;}
+        bool is_ready(){return socketfd != -1;}
+
+        void close_socket();
+
+        // disable copy semantics
+        ListenerHandoff(const ListenerHandoff&) = delete;
+        ListenerHandoff& operator=(const ListenerHandoff&) = delete;
+
+
+        private:
+
+            static constexpr uint32_t HANDOFF_MAGIC = 0x68616e64;   // "hand"
+
+            enum kind_t : uint32_t{
+                CONTROL = 1,            // control socket, then the listeners
+                CONNECTIONS = 2,
+                END = 3,
+                CONFIRM = 4             // successor to running process
+            };
+
+            struct message_t{
+                uint32_t magic;
+                uint32_t kind;
+                uint32_t count;         // descriptors attached
+            };
+
+            int socketfd;               // control listener
+            std::string unixPath;       // removed by close_socket, when bound to a path
+
+            static bool same_user(int peerfd);
+            static int send_message(int peerfd, kind_t kind, const int *fds, int count);
+    };
+}
+
+
+#endif
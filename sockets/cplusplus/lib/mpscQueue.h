@@ -0,0 +1,112 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+
+namespace mysocket{
+
+    /*  Unbounded lock-free multi-producer single-consumer queue.
+    *
+    *   A linked list with a stub node (Dmitry Vyukov's design). push
+    *   swaps the new node into head with one atomic exchange and then
+    *   links the previous head to it, so producers never wait for each
+    *   other or for the consumer. pop is called by one thread only and
+    *   follows the links from tail.
+    *
+    *   Between a producer's exchange and its link the list is briefly
+    *   cut: pop then reports empty although the element is on its way.
+    *   Callers that sleep on an empty queue pair it with a wakeup that the
+    *   producer signals after push returns, see SubmissionQueue.
+    *
+    *   Elements pushed by one thread are popped in the order pushed.
+    */
+    template<typename T>
+    class MpscQueue{
+        public:
+
+        MpscQueue() : head(&stub), tail(&stub){
+            stub.next.store(nullptr, std::memory_order_relaxed);
+        }
+
+        // frees the elements still queued, no producer may be running
+        ~MpscQueue(){
+            T discard;
+            while(pop(discard)){
+            }
+        }
+
+        // any thread
+        void push(T value){
+            node_t *n = new node_t(std::move(value));
+            link(n);
+        }
+
+        // consumer thread only. returns false when empty
+        bool pop(T &value){
+            node_t *t = tail;
+            node_t *next = t->next.load(std::memory_order_acquire);
+
+            // skip the stub, it carries no value
+            if(t == &stub){
+                if(next == nullptr){
+                    return false;
+                }
+                tail = next;
+                t = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+
+            if(next != nullptr){
+                tail = next;
+                value = std::move(t->value);
+                delete t;
+                return true;
+            }
+
+            // t is the last linked node; it can only be taken once the
+            // stub is queued behind it, otherwise head would dangle
+            if(t != head.load(std::memory_order_acquire)){
+                return false;                   // a push is half done
+            }
+            link(&stub);
+
+            next = t->next.load(std::memory_order_acquire);
+            if(next != nullptr){
+                tail = next;
+                value = std::move(t->value);
+                delete t;
+                return true;
+            }
+            return false;
+        }
+
+        // disable copy semantics
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+
+        private:
+
+            struct node_t{
+                std::atomic<node_t*> next;
+                T value;
+
+                node_t() : next(nullptr){}
+                explicit node_t(T v) : next(nullptr), value(std::move(v)){}
+            };
+
+            std::atomic<node_t*> head;          // last pushed, producers
+            node_t *tail;                       // next to pop, consumer
+            node_t stub;
+
+            void link(node_t *n){
+                n->next.store(nullptr, std::memory_order_relaxed);
+                node_t *prev = head.exchange(n, std::memory_order_acq_rel);
+                prev->next.store(n, std::memory_order_release);
+            }
+    };
+}
+
+
+#endif
@@ -0,0 +1,185 @@
+#include <cstring>              // strerror
+#include <climits>              // IOV_MAX
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include "outboundQueue.h"
+
+
+namespace mysocket{
+
+    OutboundQueue::OutboundQueue(int fd, EventLoop *eventLoop, uint32_t interest){
+        socketfd = fd;
+        loop = eventLoop;
+        readInterest = interest;
+        writeArmed = false;
+        frontOffset = 0;
+        pendingBytes = 0;
+    }
+
+    void OutboundQueue::append(const uint8_t *data, size_t len){
+        if(len == 0){
+            return;
+        }
+        if(!buffers.empty() && buffers.back().size() + len <= COALESCE_LIMIT){
+            buffers.back().insert(buffers.back().end(), data, data + len);
+        }
+        else{
+            buffers.emplace_back(data, data + len);
+        }
+        pendingBytes += len;
+    }
+
+    void OutboundQueue::consume(size_t n){
+        pendingBytes -= n;
+        while(n > 0){
+            size_t left = buffers.front().size() - frontOffset;
+            if(n < left){
+                frontOffset += n;
+                return;
+            }
+            n -= left;
+            buffers.pop_front();
+            frontOffset = 0;
+        }
+    }
+
+    int OutboundQueue::update_interest(){
+        bool wantWrite = pendingBytes > 0;
+
+        if(loop == nullptr || wantWrite == writeArmed){
+            return 0;
+        }
+
+        // a writable socket with nothing to send would wake the loop for
+        // nothing, so WRITE is only registered while data is queued
+        uint32_t interest = wantWrite ? readInterest | EventLoop::WRITE : readInterest;
+        if(loop->modify(socketfd, interest) != 0){
+            return -1;
+        }
+        writeArmed = wantWrite;
+        return 0;
+    }
+
+    int OutboundQueue::send(const void *buf, size_t len){
+        struct iovec iov;
+        iov.iov_base = const_cast<void*>(buf);
+        iov.iov_len = len;
+        return send(&iov, 1);
+    }
+
+    int OutboundQueue::send(const struct iovec *iov, int iovcnt){
+        struct iovec vec[IOV_MAX];
+        int first = 0;
+        size_t skip = 0;            // bytes of iov[first] already sent
+
+        // nothing queued, try the socket first so the common case copies nothing
+        while(pendingBytes == 0 && first < iovcnt){
+            int count = iovcnt - first;
+            if(count > IOV_MAX){
+                count = IOV_MAX;
+            }
+            memcpy(vec, &iov[first], size_t(count) * sizeof(struct iovec));
+            vec[0].iov_base = (uint8_t*)vec[0].iov_base + skip;
+            vec[0].iov_len -= skip;
+
+            ssize_t bytesSent = send_vector(vec, count);
+            if(bytesSent < 0){
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    break;
+                }
+                return -1;
+            }
+            if(bytesSent == 0){
+                break;
+            }
+
+            // advance past what the socket took
+            size_t n = size_t(bytesSent);
+            while(first < iovcnt && n >= iov[first].iov_len - skip){
+                n -= iov[first].iov_len - skip;
+                skip = 0;
+                ++first;
+            }
+            skip += n;
+        }
+
+        // queue whatever is left
+        for(; first < iovcnt; ++first){
+            append((const uint8_t*)iov[first].iov_base + skip, iov[first].iov_len - skip);
+            skip = 0;
+        }
+
+        if(pendingBytes > 0){
+            log_trace("fd %d queued, %zu bytes pending", socketfd, pendingBytes);
+        }
+        return update_interest();
+    }
+
+    ssize_t OutboundQueue::send_vector(struct iovec *vec, int count){
+        struct msghdr msg;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = vec;
+        msg.msg_iovlen = size_t(count);
+
+        /** sendmsg rather than writev: same gather write, plus MSG_NOSIGNAL
+        *   so a peer that closed the connection yields EPIPE instead of
+        *   SIGPIPE killing the process.
+        */
+        for(;;){
+            ssize_t bytesSent = sendmsg(socketfd, &msg, MSG_NOSIGNAL);
+            if(bytesSent >= 0){
+                return bytesSent;
+            }
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno != EAGAIN && errno != EWOULDBLOCK){
+                std::cerr << "error: " << __func__ << ", sendmsg, "
+                        << strerror(errno) << std::endl;
+            }
+            return -1;
+        }
+    }
+
+    int OutboundQueue::flush(){
+        struct iovec iov[IOV_MAX];
+
+        while(pendingBytes > 0){
+            int count = 0;
+            for(auto it = buffers.begin(); it != buffers.end() && count < IOV_MAX; ++it){
+                size_t offset = count == 0 ? frontOffset : 0;
+                iov[count].iov_base = it->data() + offset;
+                iov[count].iov_len = it->size() - offset;
+                ++count;
+            }
+
+            /** Writes all queued buffers in one system call. Replies that
+            *   piled up while the peer was slow leave together instead of
+            *   one send per reply.
+            */
+            ssize_t bytesSent = send_vector(iov, count);
+            if(bytesSent < 0){
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    break;          // wait for the next EPOLLOUT
+                }
+                return -1;
+            }
+            if(bytesSent == 0){
+                break;
+            }
+
+            consume(size_t(bytesSent));
+            log_trace("fd %d flushed %zd bytes, %zu pending", socketfd, bytesSent, pendingBytes);
+        }
+
+        return update_interest();
+    }
+
+} // end namespace
@@ -0,0 +1,81 @@
+#ifndef OUTBOUND_QUEUE_H
+#define OUTBOUND_QUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>                    // struct iovec
+
+#include "eventLoop.h"
+
+namespace mysocket{
+
+    /*  Non-blocking send queue for one connection.
+    *
+    *   send writes directly to the socket while nothing is queued. Bytes
+    *   the socket does not take are copied into the queue instead of being
+    *   retried in a loop, so a slow peer costs memory, not time on the
+    *   event loop thread. flush writes every queued buffer with one gather
+    *   write, up to IOV_MAX buffers at a time.
+    *
+    *   With an EventLoop, WRITE interest is registered only while the queue
+    *   holds data. The connection callback calls flush on EPOLLOUT:
+    *
+    *       loop.add(fd, EventLoop::READ, [&](int fd, uint32_t events){
+    *           if(events & EPOLLOUT){
+    *               queue.flush();
+    *           }
+    *           ...
+    *       });
+    *
+    *   The socket must be non-blocking.
+    */
+    class OutboundQueue{
+        public:
+
+        // small sends are appended to the last queued buffer up to this size
+        static constexpr size_t COALESCE_LIMIT = 16384;
+
+        // loop may be null, then the caller decides when to flush.
+        // readInterest is the interest kept while the queue is empty
+        OutboundQueue(int fd, EventLoop *loop = nullptr,
+                        uint32_t readInterest = EventLoop::READ);
+
+        // sends or queues all of buf. returns 0 upon success, -1 when the
+        // connection failed and should be closed
+        int send(const void *buf, size_t len);
+        int send(const struct iovec *iov, int iovcnt);
+
+        // writes queued bytes until the queue is empty or the socket is full.
+        // returns 0 upon success, -1 when the connection failed
+        int flush();
+
+        bool empty(){return pendingBytes == 0;}
+        size_t pending_bytes(){return pendingBytes;}
+
+        // disable copy semantics
+        OutboundQueue(const OutboundQueue&) = delete;
+        OutboundQueue& operator=(const OutboundQueue&) = delete;
+
+
+        private:
+            int socketfd;
+            EventLoop *loop;
+            uint32_t readInterest;
+            bool writeArmed;
+
+            std::deque<std::vector<uint8_t>> buffers;
+            size_t frontOffset;             // bytes of buffers.front() already sent
+            size_t pendingBytes;
+
+            void append(const uint8_t *data, size_t len);
+            void consume(size_t n);
+            ssize_t send_vector(struct iovec *vec, int count);
+            int update_interest();
+    };
+}
+
+
+#endif
@@ -0,0 +1,86 @@
+#include <cstring>              // strerror
+#include <unistd.h>             // close, ftruncate, sysconf
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/mman.h>           // mmap, memfd_create
+
+#include <debuglog/debuglog.h>
+
+#include "ringBuffer.h"
+
+
+namespace mysocket{
+
+    RingBuffer::RingBuffer(size_t size){
+        base = nullptr;
+        head = tail = 0;
+
+        // power of two pages so offsets wrap with a mask
+        size_t page = size_t(sysconf(_SC_PAGESIZE));
+        capacity = page;
+        while(capacity < size){
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+
+        /** int memfd_create(const char *name, unsigned int flags);
+        *
+        *   Creates an anonymous file that lives in memory. Unlike anonymous
+        *   mmap memory, a file can be mapped more than once, which is what
+        *   the second view of the ring needs.
+        */
+        int fd = memfd_create("mysocket-ring", MFD_CLOEXEC);
+        if(fd == -1){
+            std::cerr << "error: " << __func__ << ", memfd_create, "
+                    << strerror(errno) << std::endl;
+            return;
+        }
+
+        if(ftruncate(fd, off_t(capacity)) != 0){
+            std::cerr << "error: " << __func__ << ", ftruncate, "
+                    << strerror(errno) << std::endl;
+            close(fd);
+            return;
+        }
+
+        // reserve 2 * capacity of address space, then map the file over
+        // both halves with MAP_FIXED
+        void *region = mmap(NULL, 2 * capacity, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(region == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap reserve, "
+                    << strerror(errno) << std::endl;
+            close(fd);
+            return;
+        }
+
+        uint8_t *p = (uint8_t*)region;
+        void *first = mmap(p, capacity, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_FIXED, fd, 0);
+        void *second = mmap(p + capacity, capacity, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_FIXED, fd, 0);
+
+        // the mappings hold a reference to the file
+        close(fd);
+
+        if(first == MAP_FAILED || second == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap mirror, "
+                    << strerror(errno) << std::endl;
+            munmap(region, 2 * capacity);
+            return;
+        }
+
+        base = p;
+        log_trace("ring buffer of %zu bytes at %p", capacity, (void*)base);
+    }
+
+    RingBuffer::~RingBuffer(){
+        if(base != nullptr){
+            munmap(base, 2 * capacity);
+            base = nullptr;
+        }
+    }
+
+} // end namespace
@@ -0,0 +1,64 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace mysocket{
+
+    /*  Byte ring buffer mapped twice, back to back, in virtual memory.
+    *
+    *   The same physical pages appear at [base, base + capacity) and again
+    *   at [base + capacity, base + 2 * capacity), so the readable bytes and
+    *   the free space are each one contiguous range even when they wrap
+    *   around the end of the buffer. A recv can fill all free space in one
+    *   call and a parser can read a message that straddles the wrap point
+    *   in place, without copying it out first.
+    *
+    *   capacity is rounded up to a power-of-two number of pages, so
+    *   offsets wrap with a mask: 5000 bytes become 8 KB, 20 KB become
+    *   32 KB with 4 KB pages. get_capacity returns the rounded value.
+    */
+    class RingBuffer{
+        public:
+
+        explicit RingBuffer(size_t capacity);
+        ~RingBuffer();
+
+        // false if the mapping could not be created
+        bool is_ready(){return base != nullptr;}
+
+        // readable bytes start at read_ptr, free space at write_ptr
+        uint8_t* read_ptr(){return base + (head & mask);}
+        uint8_t* write_ptr(){return base + (tail & mask);}
+
+        size_t readable(){return size_t(tail - head);}
+        size_t writable(){return capacity - readable();}
+        size_t get_capacity(){return capacity;}
+
+        // marks n bytes at write_ptr as filled, n <= writable()
+        void commit(size_t n){tail += n;}
+
+        // releases n bytes at read_ptr, n <= readable()
+        void consume(size_t n){head += n;}
+
+        void clear(){head = tail = 0;}
+
+        // disable copy semantics
+        RingBuffer(const RingBuffer&) = delete;
+        RingBuffer& operator=(const RingBuffer&) = delete;
+
+
+        private:
+            uint8_t *base;
+            size_t capacity;
+            size_t mask;
+
+            // free running counters, offsets are taken modulo capacity
+            uint64_t head;
+            uint64_t tail;
+    };
+}
+
+
+#endif
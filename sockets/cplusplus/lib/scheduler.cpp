@@ -0,0 +1,209 @@
+#include <cstring>              // strerror
+
+#include <iostream>
+#include <cerrno>
+
+#include <debuglog/debuglog.h>
+
+#include "scheduler.h"
+
+
+namespace mysocket{
+
+    /*  Frame that owns a spawned Task. It is registered in roots before it
+    *   starts and removes itself when the task finishes, so whatever is
+    *   left in roots at destruction is a suspended task to tear down.
+    */
+    struct Scheduler::root_task{
+        struct promise_type{
+            Scheduler *scheduler;
+
+            promise_type(Scheduler *s, Task<void>&) : scheduler(s) {}
+
+            struct final_awaiter{
+                bool await_ready() noexcept {return false;}
+
+                // returning false continues to the end of the coroutine,
+                // which destroys the frame
+                bool await_suspend(std::coroutine_handle<promise_type> h) noexcept{
+                    h.promise().scheduler->roots.erase(h.address());
+                    return false;
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            root_task get_return_object() noexcept{
+                return root_task{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+            std::suspend_always initial_suspend() noexcept {return {};}
+            final_awaiter final_suspend() noexcept {return {};}
+            void return_void() noexcept {}
+            void unhandled_exception() noexcept {std::terminate();}
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+
+    Scheduler::root_task Scheduler::run_root(Scheduler *scheduler, Task<void> task){
+        (void)scheduler;
+        co_await task;
+    }
+
+
+    int Scheduler::wait_awaiter::await_resume(){
+        if(result != 0){
+            errno = error;
+        }
+        return result;
+    }
+
+
+    Scheduler::Scheduler(){
+        running = false;
+    }
+
+    Scheduler::~Scheduler(){
+        // destroying a root destroys the Task it awaits, and with it every
+        // frame down the await chain and the objects they own
+        std::unordered_set<void*> pending;
+        pending.swap(roots);
+        for(void *frame : pending){
+            std::coroutine_handle<>::from_address(frame).destroy();
+        }
+        timers.clear();
+    }
+
+    void Scheduler::spawn(Task<void> task){
+        root_task root = run_root(this, std::move(task));
+        roots.insert(root.handle.address());
+        root.handle.resume();
+    }
+
+    int Scheduler::watch(int fd){
+        if(set_nonblocking(fd) != 0){
+            return -1;
+        }
+        if(loop.add(fd, EventLoop::READ | EventLoop::WRITE,
+                [this](int readyfd, uint32_t events){on_event(readyfd, events);}) != 0){
+            return -1;
+        }
+        fds[fd] = fd_state_t();
+        return 0;
+    }
+
+    void Scheduler::unwatch(int fd){
+        fds.erase(fd);
+        loop.remove(fd);
+    }
+
+    bool Scheduler::suspend(wait_awaiter &w, std::coroutine_handle<> h){
+        w.handle = h;
+
+        if(w.kind != wait_awaiter::SLEEP_WAIT){
+            auto it = fds.find(w.fd);
+            if(it == fds.end()){
+                w.result = -1;
+                w.error = EBADF;
+                return false;       // resume at once
+            }
+
+            wait_awaiter *&slot = w.kind == wait_awaiter::READ_WAIT
+                                    ? it->second.reader : it->second.writer;
+            if(slot != nullptr){
+                w.result = -1;
+                w.error = EBUSY;
+                return false;
+            }
+            slot = &w;
+        }
+
+        if(w.timeoutMs >= 0){
+            w.timer = timers.emplace(Clock::now() + std::chrono::milliseconds(w.timeoutMs), &w);
+            w.hasTimer = true;
+        }
+        return true;
+    }
+
+    void Scheduler::wake(wait_awaiter *w, int result, int error){
+        if(w->hasTimer){
+            timers.erase(w->timer);
+            w->hasTimer = false;
+        }
+        w->result = result;
+        w->error = error;
+        w->handle.resume();
+    }
+
+    void Scheduler::on_event(int fd, uint32_t events){
+        auto it = fds.find(fd);
+        if(it != fds.end() && it->second.reader != nullptr &&
+                (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))){
+            wait_awaiter *w = it->second.reader;
+            it->second.reader = nullptr;
+            wake(w, 0, 0);
+        }
+
+        // the reader may have closed fd, look it up again
+        it = fds.find(fd);
+        if(it != fds.end() && it->second.writer != nullptr &&
+                (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))){
+            wait_awaiter *w = it->second.writer;
+            it->second.writer = nullptr;
+            wake(w, 0, 0);
+        }
+    }
+
+    void Scheduler::fire_timers(){
+        Clock::time_point now = Clock::now();
+
+        while(!timers.empty() && timers.begin()->first <= now){
+            wait_awaiter *w = timers.begin()->second;
+            timers.erase(timers.begin());
+            w->hasTimer = false;
+
+            if(w->kind == wait_awaiter::SLEEP_WAIT){
+                wake(w, 0, 0);
+                continue;
+            }
+
+            auto it = fds.find(w->fd);
+            if(it != fds.end()){
+                if(it->second.reader == w) it->second.reader = nullptr;
+                if(it->second.writer == w) it->second.writer = nullptr;
+            }
+            wake(w, -1, ETIMEDOUT);
+        }
+    }
+
+    int Scheduler::run_once(int maxWaitMs){
+        int timeoutMs = maxWaitMs;
+
+        // sleep no longer than the earliest timer
+        if(!timers.empty()){
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            timers.begin()->first - Clock::now()).count();
+            int untilTimer = wait < 0 ? 0 : int(wait) + 1;
+            if(timeoutMs < 0 || untilTimer < timeoutMs){
+                timeoutMs = untilTimer;
+            }
+        }
+
+        int count = loop.run_once(timeoutMs);
+        fire_timers();
+        return count;
+    }
+
+    void Scheduler::run(){
+        running = true;
+        while(running && !roots.empty()){
+            if(run_once() < 0){
+                std::cerr << "error: " << __func__ << ", event loop failed" << std::endl;
+                break;
+            }
+        }
+        running = false;
+    }
+
+} // end namespace
@@ -0,0 +1,135 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "eventLoop.h"
+#include "task.h"
+
+namespace mysocket{
+
+    /*  Runs coroutines on one thread over an EventLoop, requires C++20.
+    *
+    *   A coroutine that would block on a socket suspends on readable or
+    *   writable instead; the scheduler resumes it from the event loop when
+    *   epoll reports the descriptor ready, or when its timeout expires.
+    *   Thousands of connections, each written as straight-line code,
+    *   share one thread and one epoll instance.
+    *
+    *   Descriptors are registered once, edge-triggered for both READ and
+    *   WRITE, so waiting costs no epoll_ctl call. Each descriptor has at
+    *   most one waiting reader and one waiting writer.
+    *
+    *   Not thread safe, every call is made from the thread running run.
+    */
+    class Scheduler{
+        public:
+
+        using Clock = std::chrono::steady_clock;
+
+        struct wait_awaiter;
+        using TimerMap = std::multimap<Clock::time_point, wait_awaiter*>;
+
+        // returned by readable, writable and sleep_for.
+        // co_await yields 0 when ready, -1 with errno ETIMEDOUT on timeout
+        // or EBUSY when another coroutine already waits in that direction
+        struct wait_awaiter{
+            enum kind_t{READ_WAIT, WRITE_WAIT, SLEEP_WAIT};
+
+            Scheduler *scheduler;
+            int fd;
+            kind_t kind;
+            int timeoutMs;
+
+            std::coroutine_handle<> handle;
+            int result;
+            int error;
+            bool hasTimer;
+            TimerMap::iterator timer;
+
+            wait_awaiter(Scheduler *s, int waitfd, kind_t waitKind, int waitMs)
+                : scheduler(s), fd(waitfd), kind(waitKind), timeoutMs(waitMs),
+                  result(0), error(0), hasTimer(false) {}
+
+            bool await_ready() const noexcept {return false;}
+            bool await_suspend(std::coroutine_handle<> h){return scheduler->suspend(*this, h);}
+            int await_resume();
+        };
+
+        // constructor
+        Scheduler();
+
+        // destroys coroutines still suspended, closing what they own
+        ~Scheduler();
+
+        // starts task now, it runs until its first suspension. The
+        // scheduler owns it from then on.
+        void spawn(Task<void> task);
+
+        // registers fd with the event loop and makes it non-blocking.
+        // returns 0 upon success, -1 upon failure
+        int watch(int fd);
+
+        // call before closing fd, no coroutine may be waiting on it
+        void unwatch(int fd);
+
+        // timeoutMs -1 waits indefinitely
+        wait_awaiter readable(int fd, int timeoutMs = -1){
+            return wait_awaiter(this, fd, wait_awaiter::READ_WAIT, timeoutMs);
+        }
+        wait_awaiter writable(int fd, int timeoutMs = -1){
+            return wait_awaiter(this, fd, wait_awaiter::WRITE_WAIT, timeoutMs);
+        }
+        wait_awaiter sleep_for(int ms){
+            return wait_awaiter(this, -1, wait_awaiter::SLEEP_WAIT, ms);
+        }
+
+        // waits for events or the next timer, at most maxWaitMs (-1 no
+        // limit), and resumes the coroutines that became runnable.
+        // returns number of events dispatched, -1 on error
+        int run_once(int maxWaitMs = -1);
+
+        // runs until stop is called or every spawned task finished
+        void run();
+        void stop(){running = false;}
+
+        size_t active_tasks(){return roots.size();}
+        EventLoop& get_loop(){return loop;}
+
+        // disable copy semantics
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+
+        private:
+
+            struct fd_state_t{
+                wait_awaiter *reader = nullptr;
+                wait_awaiter *writer = nullptr;
+            };
+
+            EventLoop loop;
+            bool running;
+            TimerMap timers;
+            std::unordered_map<int, fd_state_t> fds;
+
+            // addresses of the outermost frames of spawned tasks
+            std::unordered_set<void*> roots;
+
+            bool suspend(wait_awaiter &w, std::coroutine_handle<> h);
+            void wake(wait_awaiter *w, int result, int error);
+            void on_event(int fd, uint32_t events);
+            void fire_timers();
+
+            struct root_task;
+            static root_task run_root(Scheduler *scheduler, Task<void> task);
+    };
+}
+
+
+#endif
@@ -0,0 +1,156 @@
+#include <cstring>              // strerror
+#include <unistd.h>             // close
+#include <pthread.h>            // pthread_setaffinity_np
+#include <sched.h>              // cpu_set_t, sched_getaffinity
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/eventfd.h>
+
+#include <debuglog/debuglog.h>
+
+#include "shardedServer.h"
+#include "unixSocket.h"
+
+
+namespace mysocket{
+
+    ShardedServer::shard_t::~shard_t(){
+        if(wakefd != -1){
+            close(wakefd);
+        }
+    }
+
+    ShardedServer::ShardedServer(){
+    }
+
+    ShardedServer::~ShardedServer(){
+        stop();
+    }
+
+    int ShardedServer::start(const char* port, int numShards, int backlog,
+                bool pinThreads, ShardInit init){
+
+        if(!shards.empty() || numShards < 1){
+            std::cerr << "error: " << __func__ << ", invalid shard count or "
+                    << "already started" << std::endl;
+            return -1;
+        }
+
+        /** SO_REUSEPORT groups exist for TCP and UDP only. Each shard binding
+        *   a unix path would unlink the previous shard's socket, leaving
+        *   a single reachable listener.
+        */
+        if(is_unix_address(port)){
+            std::cerr << "error: " << __func__ << ", " << port
+                    << ", unix addresses cannot be sharded" << std::endl;
+            errno = EINVAL;
+            return -1;
+        }
+
+        // bind every listener up front so a failure is reported to the
+        // caller rather than on a worker thread
+        for(int i = 0; i < numShards; ++i){
+            std::unique_ptr<shard_t> shard(new shard_t());
+            shard->index = i;
+
+            if(shard->server.initialize(port, backlog, true) != 0 ||
+                    set_nonblocking(shard->server.get_fd()) != 0){
+                std::cerr << "error: " << __func__ << ", shard " << i
+                        << " listener failed" << std::endl;
+                shards.clear();
+                return -1;
+            }
+
+            /** eventfd: a counter the kernel treats as a readable descriptor.
+            *   stop() writes to it from another thread, which wakes the
+            *   shard's epoll_wait.
+            */
+            shard->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if(shard->wakefd == -1){
+                std::cerr << "error: " << __func__ << ", eventfd, "
+                        << strerror(errno) << std::endl;
+                shards.clear();
+                return -1;
+            }
+
+            shards.push_back(std::move(shard));
+        }
+
+        for(auto &shard : shards){
+            shard->thread = std::thread(run_shard, shard.get(), pinThreads, init);
+        }
+
+        log_info("started %d shards", numShards);
+        return 0;
+    }
+
+    void ShardedServer::run_shard(shard_t *shard, bool pin, ShardInit init){
+
+        /** The process may be confined to some cpus, by taskset, cgroup
+        *   cpusets or a container, and those need not be 0..n-1. Shard i
+        *   goes to the i-th cpu the process is allowed to run on, cycling
+        *   when there are more shards than cpus.
+        */
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if(pin && sched_getaffinity(0, sizeof(allowed), &allowed) != 0){
+            log_warn("shard %d, sched_getaffinity: %s", shard->index, strerror(errno));
+            pin = false;
+        }
+
+        int numAllowed = pin ? CPU_COUNT(&allowed) : 0;
+        if(numAllowed > 0){
+            int skip = shard->index % numAllowed;
+            int cpu = 0;
+            for(; cpu < CPU_SETSIZE; ++cpu){
+                if(CPU_ISSET(cpu, &allowed) && skip-- == 0){
+                    break;
+                }
+            }
+
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(cpu, &cpus);
+
+            int rv = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+            if(rv != 0){
+                log_warn("shard %d, pthread_setaffinity_np: %s", shard->index,
+                        strerror(rv));
+            }
+            log_debug("shard %d pinned to cpu %d", shard->index, cpu);
+        }
+
+        shard->loop.add(shard->wakefd, EventLoop::READ, [shard](int fd, uint32_t){
+            uint64_t value;
+            if(read(fd, &value, sizeof(value)) > 0){
+                shard->loop.stop();
+            }
+        });
+
+        init(*shard);
+        shard->loop.run();
+
+        log_trace("shard %d stopped", shard->index);
+    }
+
+    void ShardedServer::stop(){
+        uint64_t one = 1;
+
+        for(auto &shard : shards){
+            if(write(shard->wakefd, &one, sizeof(one)) != sizeof(one)){
+                log_warn("shard %d, wake write failed", shard->index);
+            }
+        }
+
+        for(auto &shard : shards){
+            if(shard->thread.joinable()){
+                shard->thread.join();
+            }
+        }
+
+        shards.clear();
+    }
+
+} // end namespace
@@ -0,0 +1,73 @@
+#ifndef SHARDED_SERVER_H
+#define SHARDED_SERVER_H
+
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "eventLoop.h"
+#include "socketServer.h"
+
+namespace mysocket{
+
+    /*  One reactor per core.
+    *
+    *   Every shard owns a worker thread, a non-blocking SO_REUSEPORT
+    *   listening socket bound to the same port, and an EventLoop. The
+    *   kernel spreads incoming connections across the listeners, so
+    *   accepts and all later I/O on a connection stay on one thread with
+    *   no shared state between shards.
+    *
+    *   The init callback runs on the shard's own thread before its loop
+    *   starts. It registers the listening socket with the loop and sets
+    *   up whatever per-shard state the application needs.
+    */
+    class ShardedServer{
+        public:
+
+        struct shard_t{
+            int index;
+            SocketServer server;
+            EventLoop loop;
+            int wakefd = -1;            // eventfd used by stop
+            std::thread thread;
+
+            ~shard_t();
+        };
+
+        using ShardInit = std::function<void(shard_t &shard)>;
+
+        // constructor
+        ShardedServer();
+
+        // destructor, stops all shards
+        ~ShardedServer();
+
+        // binds numShards listeners on port and starts one thread per
+        // shard. port must be a TCP port, unix: addresses are refused.
+        // pinThreads binds shard i to the i-th cpu of the process's
+        // affinity mask, modulo their number.
+        // returns 0 upon success, -1 upon failure
+        int start(const char* port, int numShards, int backlog, bool pinThreads,
+                    ShardInit init);
+
+        // wakes every shard, stops its loop and joins its thread
+        void stop();
+
+        int get_num_shards(){return int(shards.size());}
+
+        // disable copy semantics
+        ShardedServer(const ShardedServer&) = delete;
+        ShardedServer& operator=(const ShardedServer&) = delete;
+
+
+        private:
+            std::vector<std::unique_ptr<shard_t>> shards;
+
+            static void run_shard(shard_t *shard, bool pin, ShardInit init);
+    };
+}
+
+
+#endif
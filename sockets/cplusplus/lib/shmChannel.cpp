@@ -0,0 +1,429 @@
+#include <cstring>              // memcpy, strerror
+#include <unistd.h>             // close, ftruncate, sysconf, syscall
+
+#include <iostream>
+#include <cerrno>
+#include <chrono>
+#include <new>                  // placement new
+#include <thread>               // hardware_concurrency
+
+#include <poll.h>
+#include <linux/futex.h>        // FUTEX_WAIT, FUTEX_WAKE
+#include <sys/mman.h>           // mmap, memfd_create
+#include <sys/stat.h>           // fstat
+#include <sys/syscall.h>        // SYS_futex
+
+#include <debuglog/debuglog.h>
+
+#include "shmChannel.h"
+#include "unixSocket.h"
+
+
+namespace mysocket{
+
+    static constexpr uint32_t SHM_MAGIC = 0x6d736863;       // "mshc"
+    static constexpr uint32_t SHM_VERSION = 1;
+
+    // a sleeper wakes at least this often to check for a vanished peer
+    static constexpr int SLEEP_SLICE_MS = 100;
+
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                "futex words must be plain 32 bit integers");
+
+    using Clock = std::chrono::steady_clock;
+
+
+    static size_t page_size(){
+        return size_t(sysconf(_SC_PAGESIZE));
+    }
+
+    // the header takes the first page, the two rings follow
+    static size_t data_offset(){
+        return page_size();
+    }
+
+    static inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    /** long syscall(SYS_futex, uint32_t *uaddr, int futex_op, uint32_t val,
+    *               const struct timespec *timeout, ...);
+    *
+    *   FUTEX_WAIT sleeps only if *uaddr still equals val, checked
+    *   atomically inside the kernel, so a wake that changed the word first
+    *   is never lost. The shared (not _PRIVATE) operations key the wait on
+    *   the physical page, which lets two processes meet on a word in a
+    *   MAP_SHARED mapping.
+    */
+    static long futex(std::atomic<uint32_t> *word, int op, uint32_t val,
+                    const struct timespec *timeout){
+        return syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), op, val,
+                        timeout, NULL, 0);
+    }
+
+    // copies across the end of the ring
+    static void copy_in(uint8_t *ring, uint64_t mask, uint64_t pos,
+                        const void *src, size_t len){
+        size_t offset = size_t(pos & mask);
+        size_t first = len < size_t(mask + 1) - offset ? len : size_t(mask + 1) - offset;
+        memcpy(ring + offset, src, first);
+        memcpy(ring, (const uint8_t*)src + first, len - first);
+    }
+
+    static void copy_out(const uint8_t *ring, uint64_t mask, uint64_t pos,
+                        void *dst, size_t len){
+        size_t offset = size_t(pos & mask);
+        size_t first = len < size_t(mask + 1) - offset ? len : size_t(mask + 1) - offset;
+        memcpy(dst, ring + offset, first);
+        memcpy((uint8_t*)dst + first, ring, len - first);
+    }
+
+    static uint64_t record_size(uint32_t len){
+        return (uint64_t(len) + 8 + 7) & ~uint64_t(7);
+    }
+
+
+    ShmChannel::ShmChannel(){
+        socketfd = -1;
+        region = nullptr;
+        regionSize = 0;
+        header = nullptr;
+        capacity = 0;
+        mask = 0;
+        txRing = rxRing = nullptr;
+        txData = rxData = nullptr;
+        wakeups = 0;
+
+        // spinning only helps while the peer runs on another core
+        spinNs = std::thread::hardware_concurrency() > 1 ? DEFAULT_SPIN_US * 1000 : 0;
+    }
+
+    ShmChannel::~ShmChannel(){
+        if(header != nullptr){
+            close_channel();
+            munmap(region, regionSize);
+            region = nullptr;
+            header = nullptr;
+        }
+    }
+
+    int ShmChannel::map_region(int memfd, size_t size){
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        region = p;
+        regionSize = size;
+        return 0;
+    }
+
+    void ShmChannel::attach(bool offerSide){
+        uint8_t *data = (uint8_t*)region + data_offset();
+
+        header = (shm_header_t*)region;
+        capacity = size_t(header->capacity);
+        mask = capacity - 1;
+
+        // the offering side sends on ring 0, the accepting side on ring 1
+        txRing = &header->rings[offerSide ? 0 : 1];
+        rxRing = &header->rings[offerSide ? 1 : 0];
+        txData = data + (offerSide ? 0 : capacity);
+        rxData = data + (offerSide ? capacity : 0);
+    }
+
+    int ShmChannel::offer(int unixfd, size_t size){
+        static_assert(sizeof(shm_header_t) <= 4096, "header must fit the first page");
+
+        if(header != nullptr){
+            errno = EISCONN;
+            return -1;
+        }
+
+        size_t page = page_size();
+        size_t ringSize = page;
+        while(ringSize < size){
+            ringSize <<= 1;
+        }
+
+        int memfd = memfd_create("mysocket-shm", MFD_CLOEXEC);
+        if(memfd == -1){
+            std::cerr << "error: " << __func__ << ", memfd_create, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        size_t total = data_offset() + 2 * ringSize;
+        if(ftruncate(memfd, off_t(total)) != 0 || map_region(memfd, total) != 0){
+            std::cerr << "error: " << __func__ << ", shared memory setup, "
+                    << strerror(errno) << std::endl;
+            close(memfd);
+            return -1;
+        }
+
+        // a fresh memfd reads as zeros, construct the atomics properly anyway
+        shm_header_t *h = new (region) shm_header_t();
+        h->magic = SHM_MAGIC;
+        h->version = SHM_VERSION;
+        h->capacity = ringSize;
+
+        uint8_t tag = 'S';
+        int rv = send_fds(unixfd, &memfd, 1, &tag, 1);
+
+        // the mappings on both sides keep the memory alive
+        close(memfd);
+
+        if(rv != 0){
+            munmap(region, regionSize);
+            region = nullptr;
+            return -1;
+        }
+
+        socketfd = unixfd;
+        attach(true);
+        log_debug("shared memory channel offered, %zu bytes per direction", ringSize);
+        return 0;
+    }
+
+    int ShmChannel::accept(int unixfd){
+        int memfd;
+        int count;
+        uint8_t tag;
+        struct stat st;
+
+        if(header != nullptr){
+            errno = EISCONN;
+            return -1;
+        }
+
+        if(receive_fds(unixfd, &memfd, 1, &count, &tag, 1) <= 0 || count != 1){
+            std::cerr << "error: " << __func__ << ", no shared memory received" << std::endl;
+            if(count == 1){
+                close(memfd);
+            }
+            return -1;
+        }
+
+        if(fstat(memfd, &st) != 0 || size_t(st.st_size) <= data_offset() ||
+                map_region(memfd, size_t(st.st_size)) != 0){
+            std::cerr << "error: " << __func__ << ", shared memory unusable" << std::endl;
+            close(memfd);
+            return -1;
+        }
+        close(memfd);
+
+        shm_header_t *h = (shm_header_t*)region;
+        if(h->magic != SHM_MAGIC || h->version != SHM_VERSION ||
+                data_offset() + 2 * h->capacity != regionSize){
+            std::cerr << "error: " << __func__ << ", shared memory header mismatch" << std::endl;
+            munmap(region, regionSize);
+            region = nullptr;
+            return -1;
+        }
+
+        socketfd = unixfd;
+        attach(false);
+        return 0;
+    }
+
+    bool ShmChannel::peer_gone(){
+        struct pollfd pfd;
+        pfd.fd = socketfd;
+        pfd.events = POLLRDHUP;
+        pfd.revents = 0;
+
+        return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLRDHUP | POLLHUP | POLLERR));
+    }
+
+    void ShmChannel::wake(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &sleeping){
+        // the waker clears the flag: until the sleeper has run, the
+        // following messages must not repeat the system call
+        if(sleeping.exchange(0) == 0){
+            return;
+        }
+        seq.fetch_add(1);
+        futex(&seq, FUTEX_WAKE, 1, NULL);
+        ++wakeups;
+    }
+
+    int ShmChannel::wait(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &sleeping,
+                        const std::function<bool()> &ready, int timeoutMs){
+        if(ready()){
+            return 0;
+        }
+
+        Clock::time_point start = Clock::now();
+
+        // a poll, the caller does not want to wait at all
+        if(timeoutMs == 0){
+            errno = ETIMEDOUT;
+            return -1;
+        }
+
+        // spin: a peer on another core usually answers within microseconds,
+        // far less than a futex sleep and wake round trip. Never past the
+        // caller's timeout.
+        if(spinNs > 0){
+            int64_t spinLimit = spinNs;
+            if(timeoutMs > 0 && spinLimit > int64_t(timeoutMs) * 1000000){
+                spinLimit = int64_t(timeoutMs) * 1000000;
+            }
+            Clock::time_point spinEnd = start + std::chrono::nanoseconds(spinLimit);
+            do{
+                for(int i = 0; i < 64; ++i){
+                    if(ready()){
+                        return 0;
+                    }
+                    cpu_relax();
+                }
+            }while(Clock::now() < spinEnd);
+        }
+
+        Clock::time_point deadline = start + std::chrono::milliseconds(timeoutMs);
+
+        for(;;){
+            uint32_t observed = seq.load();
+
+            /** Announce the sleep, then look at the ring once more. The other
+            *   side publishes first and reads the flag second, both with
+            *   sequentially consistent operations, so at least one of the two
+            *   sees the other: either the check below finds the update, or
+            *   the other side bumps seq and FUTEX_WAIT returns at once.
+            */
+            sleeping.store(1);
+            if(ready()){
+                sleeping.store(0);
+                return 0;
+            }
+
+            int sliceMs = SLEEP_SLICE_MS;
+            if(timeoutMs >= 0){
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                deadline - Clock::now()).count();
+                if(left <= 0){
+                    sleeping.store(0);
+                    errno = ETIMEDOUT;
+                    return -1;
+                }
+                if(left < sliceMs){
+                    sliceMs = int(left);
+                }
+            }
+
+            struct timespec slice;
+            slice.tv_sec = sliceMs / 1000;
+            slice.tv_nsec = long(sliceMs % 1000) * 1000000L;
+            futex(&seq, FUTEX_WAIT, observed, &slice);
+            sleeping.store(0);
+
+            if(ready()){
+                return 0;
+            }
+            if(peer_gone()){
+                errno = EPIPE;
+                return -1;
+            }
+        }
+    }
+
+    int ShmChannel::send(const void *buf, uint32_t len){
+        if(header == nullptr){
+            errno = ENOTCONN;
+            return -1;
+        }
+        if(len > max_message_size()){
+            errno = EMSGSIZE;
+            return -1;
+        }
+
+        uint64_t need = record_size(len);
+        uint64_t head = txRing->head.load(std::memory_order_relaxed);
+
+        // only this side moves head; the consumer moves tail
+        auto hasSpace = [&]{
+            return txRing->closed.load(std::memory_order_relaxed) != 0 ||
+                capacity - (head - txRing->tail.load()) >= need;
+        };
+        if(wait(txRing->spaceSeq, txRing->producerSleeping, hasSpace, -1) != 0){
+            return -1;
+        }
+        if(txRing->closed.load() != 0){
+            errno = EPIPE;
+            return -1;
+        }
+
+        uint64_t record[1] = {uint64_t(len)};
+        copy_in(txData, mask, head, record, RECORD_HEADER_SIZE);
+        copy_in(txData, mask, head + RECORD_HEADER_SIZE, buf, len);
+
+        // publishing head also releases the bytes written above
+        txRing->head.store(head + need);
+        if(txRing->consumerSleeping.load() != 0){
+            wake(txRing->dataSeq, txRing->consumerSleeping);
+        }
+        return 0;
+    }
+
+    ssize_t ShmChannel::receive(void *buf, size_t len, int timeoutMs){
+        if(header == nullptr){
+            errno = ENOTCONN;
+            return -1;
+        }
+
+        uint64_t tail = rxRing->tail.load(std::memory_order_relaxed);
+
+        auto hasData = [&]{
+            return rxRing->head.load() != tail ||
+                rxRing->closed.load(std::memory_order_relaxed) != 0;
+        };
+        if(wait(rxRing->dataSeq, rxRing->consumerSleeping, hasData, timeoutMs) != 0){
+            return errno == EPIPE ? 0 : -1;
+        }
+        if(rxRing->head.load() == tail){
+            return 0;                           // closed and drained
+        }
+
+        uint64_t record[1];
+        copy_out(rxData, mask, tail, record, RECORD_HEADER_SIZE);
+        uint32_t length = uint32_t(record[0]);
+        if(length > len){
+            errno = EMSGSIZE;
+            return -1;
+        }
+        copy_out(rxData, mask, tail + RECORD_HEADER_SIZE, buf, length);
+
+        tail += record_size(length);
+        rxRing->tail.store(tail);
+
+        /** A full ring wakes its producer only once half of it is free
+        *   again. Waking it for every freed record would, on a shared core,
+        *   switch back and forth once per message. The ring is half free at
+        *   the latest when it is empty, before this side can go to sleep.
+        */
+        if(rxRing->producerSleeping.load() != 0 &&
+                capacity - (rxRing->head.load() - tail) >= capacity / 2){
+            wake(rxRing->spaceSeq, rxRing->producerSleeping);
+        }
+        return ssize_t(length);
+    }
+
+    void ShmChannel::close_channel(){
+        if(header == nullptr){
+            return;
+        }
+
+        // the peer's receive returns 0 once drained, its send fails
+        txRing->closed.store(1);
+        rxRing->closed.store(1);
+        for(std::atomic<uint32_t> *seq : {&txRing->dataSeq, &rxRing->spaceSeq}){
+            seq->fetch_add(1);
+            futex(seq, FUTEX_WAKE, 1, NULL);
+        }
+    }
+
+} // end namespace
@@ -0,0 +1,138 @@
+#ifndef SHM_CHANNEL_H
+#define SHM_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+
+#include <sys/types.h>
+
+namespace mysocket{
+
+    /*  Message channel between two processes on one host through shared
+    *   memory, set up over an ordinary connected unix socket.
+    *
+    *   Even a unix socket copies each message twice, into the kernel and
+    *   back out, and costs a system call per send and per receive. Here
+    *   both processes map the same memfd holding one single-producer
+    *   single-consumer ring per direction. A send copies the message into
+    *   the ring and publishes it with an atomic store; the receiver copies
+    *   it out. No system call is made while both sides are busy.
+    *
+    *   An idle side first spins for a while, the cheapest wait when the
+    *   peer runs on another core and answers within microseconds, and
+    *   then sleeps on a futex in the shared header. The other side only
+    *   makes the futex wake call when a sleeper announced itself.
+    *
+    *   Handshake: one side calls offer on a connected unix socket, which
+    *   creates the memory and passes the memfd with SCM_RIGHTS, the other
+    *   calls accept on its end. The socket stays open for the lifetime of
+    *   the channel: a sleeping side checks it for a hang up, so a peer that
+    *   exits without close does not leave it waiting forever.
+    *
+    *       server: accept_client_connection(&c);  ch.offer(c.fd);
+    *       client: connect_client("unix:@app", ""); ch.accept(client.get_fd());
+    */
+    class ShmChannel{
+        public:
+
+        // bytes per direction, rounded up to a power of two pages
+        static constexpr size_t DEFAULT_CAPACITY = 1 << 20;
+
+        // time spent polling the ring before sleeping on the futex
+        static constexpr int DEFAULT_SPIN_US = 50;
+
+        ShmChannel();
+        ~ShmChannel();
+
+        // creates the shared memory and passes it over the connected unix
+        // socket. returns 0 upon success, -1 upon failure
+        int offer(int unixfd, size_t capacity = DEFAULT_CAPACITY);
+
+        // maps the shared memory passed by the peer's offer.
+        // returns 0 upon success, -1 upon failure
+        int accept(int unixfd);
+
+        bool is_ready(){return header != nullptr;}
+
+        // copies one message into the ring, waits while the ring is full.
+        // returns 0 upon success, -1 with errno EPIPE when the peer closed,
+        // EMSGSIZE when len exceeds max_message_size
+        int send(const void *buf, uint32_t len);
+
+        // copies the next message into buf, waits up to timeoutMs (-1
+        // indefinitely) for one to arrive. returns the message length,
+        // 0 when the peer closed and everything was read, -1 with errno
+        // ETIMEDOUT, or EMSGSIZE when len is too small (the message stays)
+        ssize_t receive(void *buf, size_t len, int timeoutMs = -1);
+
+        // marks the sending direction closed and wakes the peer
+        void close_channel();
+
+        // 0 sleeps right away, better when both sides share one core
+        void set_spin(int spinUs){spinNs = int64_t(spinUs) * 1000;}
+
+        size_t max_message_size(){return capacity - RECORD_HEADER_SIZE;}
+
+        // futex wake calls made by this side, each one a system call
+        uint64_t get_wakeups(){return wakeups;}
+
+        // disable copy semantics
+        ShmChannel(const ShmChannel&) = delete;
+        ShmChannel& operator=(const ShmChannel&) = delete;
+
+
+        private:
+
+            static constexpr size_t RECORD_HEADER_SIZE = 8;
+
+            // one direction. Counters only grow, the ring offset is the
+            // counter masked with capacity - 1. Each side writes its own
+            // cache line so the two cores do not steal a line back and
+            // forth on every message.
+            struct ring_t{
+                alignas(64) std::atomic<uint64_t> head;             // producer
+                alignas(64) std::atomic<uint64_t> tail;             // consumer
+
+                // futex words, bumped before each wake so a sleeper that
+                // checked the ring just before does not miss it
+                alignas(64) std::atomic<uint32_t> dataSeq;
+                std::atomic<uint32_t> consumerSleeping;
+                std::atomic<uint32_t> spaceSeq;
+                std::atomic<uint32_t> producerSleeping;
+                std::atomic<uint32_t> closed;
+            };
+
+            struct shm_header_t{
+                uint32_t magic;
+                uint32_t version;
+                uint64_t capacity;
+                ring_t rings[2];            // [0] offer -> accept, [1] back
+            };
+
+            int socketfd;                   // handshake socket, watched for hang up
+            void *region;
+            size_t regionSize;
+            shm_header_t *header;
+            size_t capacity;
+            uint64_t mask;
+
+            ring_t *txRing;
+            ring_t *rxRing;
+            uint8_t *txData;
+            uint8_t *rxData;
+
+            int64_t spinNs;
+            uint64_t wakeups;
+
+            int map_region(int memfd, size_t size);
+            void attach(bool offerSide);
+            int wait(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &sleeping,
+                    const std::function<bool()> &ready, int timeoutMs);
+            void wake(std::atomic<uint32_t> &seq, std::atomic<uint32_t> &sleeping);
+            bool peer_gone();
+    };
+}
+
+
+#endif
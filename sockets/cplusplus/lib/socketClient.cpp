@@ -4,6 +4,11 @@
 
 #include <iostream>
 #include <cerrno>
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>              // fcntl
+#include <poll.h>
 
 #include <arpa/inet.h>          // inet_ntop
 #include <netdb.h>              
@@ -14,6 +19,8 @@
 #include <debuglog/debuglog.h>
 
 #include "socketClient.h"
+#include "socketIO.h"
+#include "unixSocket.h"
 
 namespace mysocket{
 
@@ -22,10 +29,30 @@ namespace mysocket{
         connected = false;
     }
 
-    SocketClient::SocketClient(const SocketClient& sc){
+    SocketClient::SocketClient(SocketClient&& sc) noexcept{
         socketfd = sc.socketfd;
         connected = sc.connected;
-        connectionIPAdrress = sc.connectionIPAdrress;
+        connectionIPAdrress = std::move(sc.connectionIPAdrress);
+        options = sc.options;
+        timestamps = sc.timestamps;
+
+        // the moved-from object no longer owns the descriptor
+        sc.socketfd = -1;
+        sc.connected = false;
+    }
+
+    SocketClient& SocketClient::operator=(SocketClient&& sc) noexcept{
+        if(this != &sc){
+            close_socket();
+            socketfd = sc.socketfd;
+            connected = sc.connected;
+            connectionIPAdrress = std::move(sc.connectionIPAdrress);
+            options = sc.options;
+            timestamps = sc.timestamps;
+            sc.socketfd = -1;
+            sc.connected = false;
+        }
+        return *this;
     }
 
     SocketClient::~SocketClient(){
@@ -36,6 +63,10 @@ namespace mysocket{
     {
         struct addrinfo hints, *servinfo, *ptr;
 
+        if(is_unix_address(port)){
+            return connect_unix(port, -1);
+        }
+
         memset(&hints, 0, sizeof hints);    /// zero out all struct data
 
         /** AF_UNSPEC is a wildcard that represents Address Family (AF) domain
@@ -81,6 +112,9 @@ namespace mysocket{
                 continue;
             }
 
+            // buffer sizes only take full effect when set before connect
+            apply_socket_options(socketfd, options);
+
             // request connection to server
             rv = connect(socketfd, ptr->ai_addr, ptr->ai_addrlen);
 
@@ -101,49 +135,330 @@ namespace mysocket{
             return -1;
         }
 
+        set_connection_ip_address(ptr->ai_addr);
         freeaddrinfo(servinfo);                 // free address structure memory
+
+        // OPT_ID needs a connected TCP socket
+        if(options.timestamping){
+            enable_timestamping(socketfd);
+            timestamps = ConnectionTimestamps();
+        }
     
         connected = true;
         return 0;
     }
 
 
+    int SocketClient::connect_client(const char* port, const char* ipAddress, int timeoutMs)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        struct addrinfo hints, *servinfo, *ptr;
+        std::vector<struct addrinfo*> addresses;
+        std::vector<struct pollfd> attempts;
+        std::vector<struct addrinfo*> attemptAddress;
+        size_t next = 0;
+        int winner = -1;
+        struct addrinfo *winnerAddress = NULL;
+
+        close_socket();
+
+        if(is_unix_address(port)){
+            return connect_unix(port, timeoutMs);
+        }
+
+        memset(&hints, 0, sizeof hints);
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        int rv = getaddrinfo(ipAddress, port, &hints, &servinfo);
+        if (rv != 0) {
+            std::cerr << "error: " << __func__ << ", getaddrinfo: " 
+                    << gai_strerror(rv) << std::endl;
+            return -1;
+        }
+
+        /** Interleave address families (RFC 8305, section 4), starting with
+        *   the family getaddrinfo preferred. A host whose IPv6 path is
+        *   broken then costs one attempt delay, not a timeout per address.
+        */
+        std::vector<struct addrinfo*> preferred, other;
+        for(ptr = servinfo; ptr != NULL; ptr = ptr->ai_next){
+            if(ptr->ai_family == servinfo->ai_family){
+                preferred.push_back(ptr);
+            }
+            else{
+                other.push_back(ptr);
+            }
+        }
+        for(size_t i = 0; i < preferred.size() || i < other.size(); ++i){
+            if(i < preferred.size()) addresses.push_back(preferred[i]);
+            if(i < other.size()) addresses.push_back(other[i]);
+        }
+
+        Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+        Clock::time_point nextStart = Clock::now();
+
+        while(winner == -1){
+            Clock::time_point now = Clock::now();
+            if(now >= deadline){
+                std::cerr << "error: " << __func__ << ", connect timed out after "
+                        << timeoutMs << " ms" << std::endl;
+                break;
+            }
+
+            // start the next attempt when its delay has passed
+            if(next < addresses.size() && (now >= nextStart || attempts.empty())){
+                ptr = addresses[next++];
+
+                int fd = socket(ptr->ai_family, ptr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                ptr->ai_protocol);
+                if(fd == -1){
+                    continue;
+                }
+                apply_socket_options(fd, options);
+
+                /** A non-blocking connect returns EINPROGRESS right away. The
+                *   socket becomes writable when the handshake finishes, and
+                *   SO_ERROR then tells success from failure.
+                */
+                if(connect(fd, ptr->ai_addr, ptr->ai_addrlen) == 0){
+                    winner = fd;
+                    winnerAddress = ptr;
+                    break;
+                }
+                if(errno != EINPROGRESS){
+                    log_debug("connect attempt failed: %s", strerror(errno));
+                    close(fd);
+                    continue;
+                }
+
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                attempts.push_back(pfd);
+                attemptAddress.push_back(ptr);
+                nextStart = now + std::chrono::milliseconds(CONNECTION_ATTEMPT_DELAY_MS);
+            }
+
+            if(attempts.empty()){
+                if(next >= addresses.size()){
+                    std::cerr << "error: " << __func__ << ", failed to connect\n";
+                    break;
+                }
+                continue;
+            }
+
+            // wait until an attempt completes, the next attempt is due,
+            // or the deadline
+            Clock::time_point wakeup = deadline;
+            if(next < addresses.size() && nextStart < wakeup){
+                wakeup = nextStart;
+            }
+            long waitMs = long(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                wakeup - now).count());
+
+            rv = poll(attempts.data(), attempts.size(), int(waitMs < 0 ? 0 : waitMs));
+            if(rv < 0 && errno != EINTR){
+                std::cerr << "error: " << __func__ << ", poll " 
+                    << strerror(errno) << std::endl;
+                break;
+            }
+
+            for(size_t i = 0; i < attempts.size() && winner == -1; ){
+                if(attempts[i].revents == 0){
+                    ++i;
+                    continue;
+                }
+
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(attempts[i].fd, SOL_SOCKET, SO_ERROR, &error, &length);
+
+                if(error == 0){
+                    winner = attempts[i].fd;
+                    winnerAddress = attemptAddress[i];
+                }
+                else{
+                    log_debug("connect attempt failed: %s", strerror(error));
+                    close(attempts[i].fd);
+                    // a failure starts the next attempt without waiting
+                    nextStart = Clock::now();
+                }
+                attempts.erase(attempts.begin() + long(i));
+                attemptAddress.erase(attemptAddress.begin() + long(i));
+            }
+        }
+
+        // abandon the attempts that lost the race
+        for(struct pollfd &pfd : attempts){
+            close(pfd.fd);
+        }
+
+        if(winner != -1){
+            // callers of this class expect blocking sockets
+            int flags = fcntl(winner, F_GETFL, 0);
+            fcntl(winner, F_SETFL, flags & ~O_NONBLOCK);
+
+            socketfd = winner;
+            connected = true;
+            set_connection_ip_address(winnerAddress->ai_addr);
+
+            if(options.timestamping){
+                enable_timestamping(socketfd);
+                timestamps = ConnectionTimestamps();
+            }
+        }
+
+        freeaddrinfo(servinfo);
+        return winner != -1 ? 0 : -1;
+    }
+
+
+    int SocketClient::connect_unix(const char* address, int timeoutMs)
+    {
+        unix_address_t ua;
+
+        close_socket();
+
+        if(parse_unix_address(address, &ua) != 0){
+            return -1;
+        }
+
+        socketfd = socket(AF_UNIX, ua.socketType | SOCK_CLOEXEC, 0);
+        if(socketfd == -1){
+            std::cerr << "error: " << __func__ << ", socket, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        if(options.sendBufferSize > 0 || options.receiveBufferSize > 0){
+            socket_options_t buffers;
+            buffers.sendBufferSize = options.sendBufferSize;
+            buffers.receiveBufferSize = options.receiveBufferSize;
+            apply_socket_options(socketfd, buffers);
+        }
+
+        /** A unix connect completes at once unless the listener's backlog
+        *   is full; it then waits for room, bounded by the send timeout.
+        */
+        struct timeval tv = {0, 0};
+        if(timeoutMs > 0){
+            tv.tv_sec = timeoutMs / 1000;
+            tv.tv_usec = (timeoutMs % 1000) * 1000;
+            setsockopt(socketfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        }
+
+        if(connect(socketfd, (const struct sockaddr*)(const void*)&ua.address, ua.length) != 0){
+            std::cerr << "error: " << __func__ << ", connect " << ua.name << ", "
+                    << strerror(errno) << std::endl;
+            close_socket();
+            return -1;
+        }
+
+        if(timeoutMs > 0){
+            tv.tv_sec = 0;
+            tv.tv_usec = 0;
+            setsockopt(socketfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        }
+
+        // SO_TIMESTAMPING is a TCP/UDP facility, and MSG_ERRQUEUE is not
+        // understood by unix stream sockets
+        options.timestamping = false;
+
+        connectionIPAdrress = address;
+        connected = true;
+        return 0;
+    }
+
+
+    void SocketClient::set_connection_ip_address(const struct sockaddr *address)
+    {
+        char text[INET6_ADDRSTRLEN] = {0};
+
+        if(address->sa_family == AF_INET){
+            inet_ntop(AF_INET, &((const struct sockaddr_in*)(const void*)address)->sin_addr,
+                        text, sizeof(text));
+        }
+        else if(address->sa_family == AF_INET6){
+            inet_ntop(AF_INET6, &((const struct sockaddr_in6*)(const void*)address)->sin6_addr,
+                        text, sizeof(text));
+        }
+        connectionIPAdrress = text;
+    }
+
+
     ssize_t SocketClient::receive_data(int connectedFD, void* buf, size_t len){
+        return receive_data(connectedFD, buf, len, NULL);
+    }
+
+    ssize_t SocketClient::receive_data(int connectedFD, void* buf, size_t len,
+                                        struct timespec *kernelTime){
         ssize_t bytesRead;
-        bytesRead = recv(connectedFD, buf, len, 0);
+        if(options.timestamping){
+            bytesRead = timestamps.receive(connectedFD, buf, len, 0, kernelTime);
+        }
+        else{
+            bytesRead = recv(connectedFD, buf, len, 0);
+        }
+        if(options.quickAck && bytesRead > 0){
+            rearm_quickack(connectedFD);
+        }
         return bytesRead;
     }
 
     ssize_t SocketClient::send_data(int connectedFD, void* buf, size_t len){
 
-        ssize_t totalBytesSent = 0;
+        const uint8_t *data = (const uint8_t*)buf;
+        size_t totalBytesSent = 0;
         ssize_t bytesSent;
-        ssize_t bytesRemaining = len - totalBytesSent;
+        uint64_t startNs = options.timestamping ? realtime_ns() : 0;
+
+        while(totalBytesSent < len){
 
-        while(bytesRemaining > 0){
-           
             /* MSG_NOSIGNAL - don't generate a SIGPIPE signal if the peer
             *  on a stream-oriented socket has closed the connection.
             */
-            bytesSent = send(connectedFD, buf, bytesRemaining, MSG_NOSIGNAL);
+            bytesSent = send(connectedFD, data + totalBytesSent, len - totalBytesSent,
+                            MSG_NOSIGNAL);
 
             if(bytesSent > 0){
-                totalBytesSent += bytesSent;
+                totalBytesSent += size_t(bytesSent);
+            }
+            else if(bytesSent < 0 && errno == EINTR){
+                continue;
             }
-             else if(bytesSent == 0){
-                std::cerr << "warn: " << __func__ << ", bytesSent: " << bytesSent 
-                    << std::endl;
+            else if(bytesSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                // non-blocking socket is full, the caller queues the rest,
+                // see OutboundQueue
+                break;
             }
             else{
                 std::cerr << "warn: " << __func__ << ", bytesSent: " << bytesSent
                     << ", errno: " << strerror(errno) << std::endl;
                 break;
             }
-            
-            bytesRemaining = len - totalBytesSent;
-            log_trace("bytesSent %ld, bytesRemaining %ld", bytesSent, bytesRemaining);
+
+            log_trace("bytesSent %ld, bytesRemaining %zu", bytesSent, len - totalBytesSent);
+        }
+
+        if(options.timestamping){
+            // keep the errno of a short send for the caller
+            int error = errno;
+            timestamps.on_send(connectedFD, totalBytesSent, startNs);
+            errno = error;
         }
-        return totalBytesSent;
+        return ssize_t(totalBytesSent);
+    }
+
+    ssize_t SocketClient::send_data(int connectedFD, const struct iovec *iov, int iovcnt){
+        uint64_t startNs = options.timestamping ? realtime_ns() : 0;
+        ssize_t bytesSent = send_iov(connectedFD, iov, iovcnt);
+        if(options.timestamping && bytesSent > 0){
+            // keep the errno of a short send for the caller
+            int error = errno;
+            timestamps.on_send(connectedFD, size_t(bytesSent), startNs);
+            errno = error;
+        }
+        return bytesSent;
     }
 
     void SocketClient::close_socket(){
@@ -154,4 +469,11 @@ namespace mysocket{
         }
     }
 
+    int SocketClient::release(){
+        int fd = socketfd;
+        socketfd = -1;
+        connected = false;
+        return fd;
+    }
+
 } // end namespace
\ No newline at end of file
@@ -2,7 +2,13 @@
 #define SOCKET_CLIENT_H
 
 #include <cstdint>
+#include <ostream>
+#include <string>
 #include <netinet/in.h>                 // struct sockaddr_in
+#include <sys/uio.h>                    // struct iovec
+
+#include "socketOptions.h"
+#include "timestamping.h"
 
 namespace mysocket{
     class SocketClient{
@@ -11,33 +17,79 @@ namespace mysocket{
         // constants
         static constexpr int RECEIVE_BUFFER_LENGTH = 2048;
 
+        // delay before the next address is tried while earlier connection
+        // attempts are still in progress (RFC 8305 recommends 250 ms)
+        static constexpr int CONNECTION_ATTEMPT_DELAY_MS = 250;
+
         SocketClient();
-        SocketClient(const SocketClient&);
         ~SocketClient();
 
+        // move semantics transfer ownership of the socket
+        SocketClient(SocketClient&&) noexcept;
+        SocketClient& operator=(SocketClient&&) noexcept;
+
+        // tuning applied to the socket before connect, see
+        // low_latency_profile and bulk_profile
+        void set_options(const socket_options_t &opts){options = opts;}
+
+        // port may also be a unix domain address, "unix:/path" or
+        // "unix:@name" (see unixSocket.h), then ipAddress is ignored.
         // returns 0 upon success, -1 upon failure
         int connect_client(const char* port, const char* ipAddress);
 
+        // non-blocking connect bounded by timeoutMs. Addresses are tried
+        // happy eyeballs style: families alternate, a new attempt starts
+        // every CONNECTION_ATTEMPT_DELAY_MS (or as soon as one fails) while
+        // earlier attempts continue, and the first to complete wins.
+        // The connected socket is returned to blocking mode.
+        // returns 0 upon success, -1 upon failure or timeout
+        int connect_client(const char* port, const char* ipAddress, int timeoutMs);
+
         ssize_t receive_data(int connectedFD, void* buf, size_t len);
+
+        // with options.timestamping, also returns the time the kernel
+        // received the data (CLOCK_REALTIME), zero when not available
+        ssize_t receive_data(int connectedFD, void* buf, size_t len, struct timespec *kernelTime);
+
+        // returns bytes sent. On a non-blocking socket this stops short
+        // when the socket buffer fills, OutboundQueue keeps the remainder
         ssize_t send_data(int connectedFD, void* buf, size_t len);
 
+        // scatter-gather send, e.g. a header and a payload in separate
+        // buffers go out in one system call without copying them together.
+        // For large payloads see ZeroCopySender in socketIO.h
+        ssize_t send_data(int connectedFD, const struct iovec *iov, int iovcnt);
+
+        // wire-to-user and user-to-wire latency histograms, recorded while
+        // options.timestamping is set
+        ConnectionTimestamps& get_timestamps(){return timestamps;}
+        void dump_latency(std::ostream &out){timestamps.dump(out, socketfd);}
+
         int get_fd(){return socketfd;}
         bool get_connect_state(){return connected;}
         std::string get_connection_ip_address(){return connectionIPAdrress;}
 
-        // disable copy semantics
-        
+        // disable copy semantics, two objects closing one descriptor
+        SocketClient(const SocketClient&) = delete;
         SocketClient& operator=(const SocketClient&) = delete;
 
 
         void close_socket();
 
+        // gives up ownership of the connected descriptor without closing
+        // it, e.g. to hand it to a SpliceRelay. returns -1 when not connected
+        int release();
+
 
         private:
             int socketfd;
             bool connected;
             std::string connectionIPAdrress;
+            socket_options_t options;
+            ConnectionTimestamps timestamps;
 
+            void set_connection_ip_address(const struct sockaddr *address);
+            int connect_unix(const char* address, int timeoutMs);
     };
 }
 
@@ -0,0 +1,289 @@
+#include <cstring>              // memset, strerror
+#include <climits>              // IOV_MAX
+
+#include <iostream>
+#include <cerrno>
+#include <vector>
+
+#include <poll.h>
+#include <netinet/in.h>         // IPPROTO_IP, IPPROTO_IPV6
+#include <linux/errqueue.h>     // struct sock_extended_err
+#include <linux/net_tstamp.h>   // SOF_TIMESTAMPING_TX_*
+#include <sys/socket.h>
+
+#include <debuglog/debuglog.h>
+
+#include "socketIO.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY 0x4000000
+#endif
+
+
+namespace mysocket{
+
+    // wait for completions when out of pinned memory, milliseconds
+    static constexpr int ZEROCOPY_WAIT_MS = 10;
+
+    /** Drops the first n bytes from the iovec array held in vec, starting
+    *   at index first. Returns the new first index.
+    */
+    static size_t advance_iov(std::vector<struct iovec> &vec, size_t first, size_t n){
+        while(first < vec.size() && n >= vec[first].iov_len){
+            n -= vec[first].iov_len;
+            ++first;
+        }
+        if(first < vec.size()){
+            vec[first].iov_base = (uint8_t*)vec[first].iov_base + n;
+            vec[first].iov_len -= n;
+        }
+        return first;
+    }
+
+    static size_t total_length(const struct iovec *iov, int iovcnt){
+        size_t total = 0;
+        for(int i = 0; i < iovcnt; ++i){
+            total += iov[i].iov_len;
+        }
+        return total;
+    }
+
+
+    ssize_t send_iov(int fd, const struct iovec *iov, int iovcnt, int flags){
+        std::vector<struct iovec> vec(iov, iov + iovcnt);
+        size_t first = 0;
+        ssize_t totalBytesSent = 0;
+        struct msghdr msg;
+
+        // skip leading empty buffers
+        first = advance_iov(vec, first, 0);
+
+        while(first < vec.size()){
+
+            /** ssize_t sendmsg(int sockfd, const struct msghdr *msg, int flags);
+            *
+            *   Transmits the buffers listed in msg_iov, in order, as if they
+            *   were one contiguous buffer. Headers and payloads that live
+            *   in separate memory go out in a single system call without
+            *   first being copied together.
+            *
+            *   At most IOV_MAX buffers are accepted per call.
+            */
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &vec[first];
+            msg.msg_iovlen = vec.size() - first;
+            if(msg.msg_iovlen > IOV_MAX){
+                msg.msg_iovlen = IOV_MAX;
+            }
+
+            ssize_t bytesSent = sendmsg(fd, &msg, flags | MSG_NOSIGNAL);
+            if(bytesSent < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+                // a full non-blocking socket is not an error, the caller
+                // retries the rest when it becomes writable
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    break;
+                }
+                int error = errno;
+                std::cerr << "warn: " << __func__ << ", bytesSent: " << bytesSent
+                    << ", errno: " << strerror(error) << std::endl;
+                errno = error;
+                break;
+            }
+            if(bytesSent == 0){
+                break;
+            }
+
+            totalBytesSent += bytesSent;
+            first = advance_iov(vec, first, size_t(bytesSent));
+            log_trace("bytesSent %ld, buffers remaining %ld", bytesSent,
+                        long(vec.size() - first));
+        }
+        return totalBytesSent;
+    }
+
+
+    ZeroCopySender::ZeroCopySender(int fd){
+        socketfd = fd;
+        nextSequence = 0;
+        completedThrough = 0;
+        dataCopied = false;
+    }
+
+    int ZeroCopySender::enable(){
+        int yes = 1;
+        int stamping = 0;
+        socklen_t length = sizeof(stamping);
+
+        // transmit timestamps share the error queue, and each reader
+        // drops the messages meant for the other
+        const int txStamps = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_TX_HARDWARE
+                           | SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_TX_ACK;
+        if(getsockopt(socketfd, SOL_SOCKET, SO_TIMESTAMPING, &stamping, &length) == 0 &&
+                (stamping & txStamps) != 0){
+            errno = EINVAL;
+            std::cerr << "error: " << __func__ << ", transmit timestamps are enabled on fd "
+                    << socketfd << ", zero copy completions would share its error queue"
+                    << std::endl;
+            return -1;
+        }
+
+        /** SO_ZEROCOPY must be set before MSG_ZEROCOPY is accepted on a
+        *   send. Requires Linux 4.14 for TCP.
+        */
+        if(setsockopt(socketfd, SOL_SOCKET, SO_ZEROCOPY, &yes, sizeof(yes)) != 0){
+            std::cerr << "error: " << __func__ << ", setsockopt SO_ZEROCOPY, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    int64_t ZeroCopySender::send(const void *buf, size_t len, size_t *bytesQueued){
+        struct iovec iov;
+        iov.iov_base = const_cast<void*>(buf);
+        iov.iov_len = len;
+        return send(&iov, 1, bytesQueued);
+    }
+
+    int64_t ZeroCopySender::send(const struct iovec *iov, int iovcnt, size_t *bytesQueued){
+        std::vector<struct iovec> vec(iov, iov + iovcnt);
+        size_t first = 0;
+        size_t total = total_length(iov, iovcnt);
+        size_t remaining = total;
+        uint32_t firstSequence = nextSequence;
+        struct msghdr msg;
+
+        if(bytesQueued != nullptr){
+            *bytesQueued = 0;
+        }
+        first = advance_iov(vec, first, 0);
+
+        while(remaining > 0){
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &vec[first];
+            msg.msg_iovlen = vec.size() - first;
+            if(msg.msg_iovlen > IOV_MAX){
+                msg.msg_iovlen = IOV_MAX;
+            }
+
+            ssize_t bytesSent = sendmsg(socketfd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+            if(bytesSent < 0){
+                if(errno == EINTR){
+                    continue;
+                }
+
+                /** ENOBUFS: the socket reached its limit of pinned memory
+                *   (optmem_max). Wait for the error queue to become
+                *   readable (POLLERR), collect completions to release some
+                *   pages and try again.
+                */
+                if(errno == ENOBUFS && pending() > 0){
+                    struct pollfd pfd = {socketfd, 0, 0};
+                    poll(&pfd, 1, ZEROCOPY_WAIT_MS);
+                    poll_completions();
+                    continue;
+                }
+
+                int error = errno;
+                std::cerr << "warn: " << __func__ << ", sendmsg MSG_ZEROCOPY, "
+                        << strerror(error) << std::endl;
+                errno = error;
+
+                // the sends that went through still hold the buffer
+                break;
+            }
+
+            // every successful call is assigned the next id by the kernel
+            ++nextSequence;
+            remaining -= size_t(bytesSent);
+            first = advance_iov(vec, first, size_t(bytesSent));
+        }
+
+        if(bytesQueued != nullptr){
+            *bytesQueued = total - remaining;
+        }
+
+        // nothing was sent, nothing to wait for
+        if(nextSequence == firstSequence){
+            return -1;
+        }
+        return int64_t(nextSequence) - 1;
+    }
+
+    void ZeroCopySender::complete_range(uint32_t lo, uint32_t hi){
+        if(lo != completedThrough){
+            outOfOrder[lo] = hi;
+            return;
+        }
+
+        completedThrough = hi + 1;
+
+        // absorb ranges that are now contiguous
+        auto it = outOfOrder.find(completedThrough);
+        while(it != outOfOrder.end()){
+            completedThrough = it->second + 1;
+            outOfOrder.erase(it);
+            it = outOfOrder.find(completedThrough);
+        }
+    }
+
+    int ZeroCopySender::poll_completions(){
+        int count = 0;
+        uint8_t control[128];
+        struct msghdr msg;
+
+        for(;;){
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            /** Completion notifications arrive on the socket error queue.
+            *   Reading it never blocks, EAGAIN means it is empty. Each
+            *   notification covers the inclusive range of ids
+            *   [ee_info, ee_data], consecutive sends are often coalesced
+            *   into a single notification.
+            */
+            if(recvmsg(socketfd, &msg, MSG_ERRQUEUE) == -1){
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    break;
+                }
+                if(errno == EINTR){
+                    continue;
+                }
+                std::cerr << "error: " << __func__ << ", recvmsg MSG_ERRQUEUE, "
+                        << strerror(errno) << std::endl;
+                return -1;
+            }
+
+            for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)){
+                bool isRecvErr = (cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVERR) ||
+                                 (cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR);
+                if(!isRecvErr){
+                    continue;
+                }
+
+                struct sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                if(err.ee_origin != SO_EE_ORIGIN_ZEROCOPY || err.ee_errno != 0){
+                    continue;
+                }
+
+                if(err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED){
+                    dataCopied = true;
+                }
+
+                complete_range(err.ee_info, err.ee_data);
+                ++count;
+            }
+        }
+        return count;
+    }
+
+} // end namespace
@@ -0,0 +1,80 @@
+#ifndef SOCKET_IO_H
+#define SOCKET_IO_H
+
+#include <cstdint>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/uio.h>                    // struct iovec
+
+namespace mysocket{
+
+    // Sends every byte described by iov with one sendmsg call per pass,
+    // continuing after partial sends. iov itself is not modified.
+    // Returns the number of bytes sent, less than the total only on error,
+    // errno then tells which. EAGAIN on a non-blocking socket is reported
+    // this way too, without a warning.
+    ssize_t send_iov(int fd, const struct iovec *iov, int iovcnt, int flags = 0);
+
+
+    /*  MSG_ZEROCOPY transmission with completion tracking.
+    *
+    *   The kernel pins the pages of the user buffer and transmits from
+    *   them directly instead of copying into socket buffers. The buffer
+    *   must therefore stay valid and unmodified until the kernel reports
+    *   it is done with it through the socket error queue.
+    *
+    *   Each send call returns a sequence number. Once is_complete returns
+    *   true for that number, the buffer may be reused. Zero copy pays off
+    *   for large buffers, roughly 10 KB and up; for small sends the page
+    *   pinning and notification costs exceed the copy.
+    */
+    class ZeroCopySender{
+        public:
+
+        explicit ZeroCopySender(int fd);
+
+        // sets SO_ZEROCOPY, returns 0 upon success, -1 upon failure.
+        // Fails with EINVAL when the socket has transmit timestamps
+        // enabled (enable_timestamping), both use the error queue.
+        int enable();
+
+        // returns the sequence number covering this buffer, -1 when
+        // nothing was queued, on error or when there was nothing to send.
+        // bytesQueued, when not null, receives the bytes the kernel took.
+        // Less than the total means an error stopped the send part way,
+        // errno tells which; the returned sequence then covers the bytes
+        // taken so far and must still be waited for.
+        int64_t send(const void *buf, size_t len, size_t *bytesQueued = nullptr);
+        int64_t send(const struct iovec *iov, int iovcnt, size_t *bytesQueued = nullptr);
+
+        // reads pending completion notifications without blocking.
+        // returns the number of notifications read, -1 on error
+        int poll_completions();
+
+        // true when every send up to and including sequence finished
+        bool is_complete(int64_t sequence){return sequence < int64_t(completedThrough);}
+
+        // number of sends the kernel still holds buffers for
+        uint32_t pending(){return nextSequence - completedThrough;}
+
+        // true if the kernel fell back to copying, e.g. over loopback
+        bool copied(){return dataCopied;}
+
+
+        private:
+            int socketfd;
+            uint32_t nextSequence;          // id the kernel gives the next send
+            uint32_t completedThrough;      // all ids below this completed
+            bool dataCopied;
+
+            // completed ranges [first, second] not yet contiguous with
+            // completedThrough
+            std::map<uint32_t, uint32_t> outOfOrder;
+
+            void complete_range(uint32_t lo, uint32_t hi);
+    };
+}
+
+
+#endif
@@ -0,0 +1,133 @@
+#include <cstring>              // strerror
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>        // TCP_NODELAY, TCP_QUICKACK, TCP_CORK
+
+#include <debuglog/debuglog.h>
+
+#include "socketOptions.h"
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL 46
+#endif
+
+#ifndef TCP_NOTSENT_LOWAT
+#define TCP_NOTSENT_LOWAT 25
+#endif
+
+
+namespace mysocket{
+
+    socket_options_t low_latency_profile(){
+        socket_options_t options;
+        options.noDelay = true;
+        options.quickAck = true;
+        options.busyPollUs = 50;
+        return options;
+    }
+
+    socket_options_t bulk_profile(){
+        socket_options_t options;
+        options.sendBufferSize = 4 * 1024 * 1024;
+        options.receiveBufferSize = 4 * 1024 * 1024;
+        options.cork = true;
+        options.notSentLowat = 128 * 1024;
+        return options;
+    }
+
+    static int set_option(int fd, int level, int name, int value, const char *text){
+        if(setsockopt(fd, level, name, &value, sizeof(value)) != 0){
+            std::cerr << "warn: " << __func__ << ", setsockopt " << text << ", "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    int apply_socket_options(int fd, const socket_options_t &options){
+        int rv = 0;
+
+        /** TCP_NODELAY: send small segments at once. By default Nagle's
+        *   algorithm holds a small segment back while earlier data is
+        *   unacknowledged, which combined with a delayed ACK at the peer
+        *   adds up to 40 ms to a request/response exchange.
+        */
+        if(options.noDelay && set_option(fd, IPPROTO_TCP, TCP_NODELAY, 1, "TCP_NODELAY") != 0){
+            rv = -1;
+        }
+
+        /** TCP_QUICKACK: acknowledge received data immediately instead of
+        *   waiting to piggyback the ACK on outgoing data.
+        */
+        if(options.quickAck && set_option(fd, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK") != 0){
+            rv = -1;
+        }
+
+        /** SO_BUSY_POLL: a blocking receive on an empty queue polls the
+        *   device receive queue for up to this many microseconds before
+        *   sleeping, trading CPU time for wakeup latency. Raising it above
+        *   net.core.busy_read needs CAP_NET_ADMIN.
+        */
+        if(options.busyPollUs > 0 &&
+                set_option(fd, SOL_SOCKET, SO_BUSY_POLL, options.busyPollUs, "SO_BUSY_POLL") != 0){
+            rv = -1;
+        }
+
+        /** SO_SNDBUF / SO_RCVBUF: the receive buffer bounds the TCP window,
+        *   which must cover bandwidth x round trip time for a single stream
+        *   to fill the link. Set before connect or listen so the window
+        *   scale negotiated in the handshake covers the larger buffer. The
+        *   kernel doubles the value and caps it at net.core.wmem_max and
+        *   net.core.rmem_max.
+        */
+        if(options.sendBufferSize > 0 &&
+                set_option(fd, SOL_SOCKET, SO_SNDBUF, options.sendBufferSize, "SO_SNDBUF") != 0){
+            rv = -1;
+        }
+        if(options.receiveBufferSize > 0 &&
+                set_option(fd, SOL_SOCKET, SO_RCVBUF, options.receiveBufferSize, "SO_RCVBUF") != 0){
+            rv = -1;
+        }
+
+        /** TCP_CORK: queue partial segments until a full one can be sent,
+        *   so a header and body written separately leave as one packet.
+        *   See flush_cork.
+        */
+        if(options.cork && set_option(fd, IPPROTO_TCP, TCP_CORK, 1, "TCP_CORK") != 0){
+            rv = -1;
+        }
+
+        /** TCP_NOTSENT_LOWAT: the socket reports writable only while fewer
+        *   than this many bytes wait unsent. Large send buffers then do not
+        *   hold seconds of stale data, and memory use per connection stays
+        *   bounded.
+        */
+        if(options.notSentLowat > 0 &&
+                set_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.notSentLowat,
+                            "TCP_NOTSENT_LOWAT") != 0){
+            rv = -1;
+        }
+
+        return rv;
+    }
+
+    int rearm_quickack(int fd){
+        int yes = 1;
+        return setsockopt(fd, IPPROTO_TCP, TCP_QUICKACK, &yes, sizeof(yes));
+    }
+
+    int flush_cork(int fd){
+        int off = 0, on = 1;
+
+        // clearing the option sends any pending partial segment
+        if(setsockopt(fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off)) != 0){
+            return -1;
+        }
+        return setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+    }
+
+} // end namespace
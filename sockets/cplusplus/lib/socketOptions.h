@@ -0,0 +1,50 @@
+#ifndef SOCKET_OPTIONS_H
+#define SOCKET_OPTIONS_H
+
+namespace mysocket{
+
+    /*  Per-socket tuning applied by SocketServer (listener and accepted
+    *   sockets) and SocketClient (before connect). A zero or false field
+    *   leaves the kernel default in place.
+    */
+    struct socket_options_t{
+        // latency
+        bool noDelay = false;           // TCP_NODELAY, disable Nagle
+        bool quickAck = false;          // TCP_QUICKACK, re-armed after each receive
+        int busyPollUs = 0;             // SO_BUSY_POLL, spin on the device queue
+
+        // throughput
+        int sendBufferSize = 0;         // SO_SNDBUF bytes
+        int receiveBufferSize = 0;      // SO_RCVBUF bytes
+        bool cork = false;              // TCP_CORK, send only full segments
+        int notSentLowat = 0;           // TCP_NOTSENT_LOWAT bytes
+
+        // instrumentation, enabled once connected rather than by
+        // apply_socket_options, see timestamping.h
+        bool timestamping = false;      // SO_TIMESTAMPING
+    };
+
+    // TCP_NODELAY, TCP_QUICKACK and SO_BUSY_POLL 50 us
+    socket_options_t low_latency_profile();
+
+    // 4 MB socket buffers, TCP_CORK and TCP_NOTSENT_LOWAT 128 KB
+    socket_options_t bulk_profile();
+
+    // applies every option that is set. A failing option is reported and
+    // skipped, the others are still applied.
+    // returns 0 when all were applied, -1 otherwise
+    int apply_socket_options(int fd, const socket_options_t &options);
+
+    // TCP_QUICKACK is not permanent, the kernel may fall back to delayed
+    // acknowledgements after a receive, so it is set again after each one.
+    // returns 0 upon success, -1 upon failure
+    int rearm_quickack(int fd);
+
+    // with TCP_CORK set, pushes out a partial segment now instead of after
+    // the 200 ms cork timeout. Call at the end of a response.
+    // returns 0 upon success, -1 upon failure
+    int flush_cork(int fd);
+}
+
+
+#endif
@@ -4,16 +4,20 @@
 
 #include <iostream>
 #include <cerrno>
+#include <cstddef>              // offsetof
 
 #include <arpa/inet.h>          // inet_ntop
 #include <netdb.h>              
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/stat.h>           // lstat
 
 #include <debuglog/debuglog.h>
 
 #include "socketServer.h"
+#include "socketIO.h"
+#include "unixSocket.h"
 
 
 
@@ -22,6 +26,7 @@ namespace mysocket{
     SocketServer::SocketServer(){
         socketfd = -1;
         servicePort = 0;
+        unixSocket = false;
     }
 
     SocketServer::~SocketServer(){
@@ -37,13 +42,18 @@ namespace mysocket{
     *   communication style:
     *       SOCK_STREAM, SOCK_DGRAM, SOCK_RAW
     */
-    int SocketServer::initialize(const char* port, int backlog)
+    int SocketServer::initialize(const char* port, int backlog, bool reusePort)
     {
         int rv;                 /// return values
         int yes = 1;            /// for setsockopt
         struct addrinfo hints, *serverinfo, *p;
 
         servicePort = 0;
+        unixSocket = is_unix_address(port);
+
+        if(unixSocket){
+            return initialize_unix(port, backlog);
+        }
 
         /** The addrinfo structure used by getaddrinfo() contains the following
          fields:
@@ -167,6 +177,31 @@ namespace mysocket{
             }
 
 
+            /** SO_REUSEPORT: allows multiple sockets to bind the same 
+             *  address and port, provided every one of them sets the option
+             *  before bind. Incoming connections are distributed across
+             *  the listening sockets by a hash of the connection 4-tuple,
+             *  so each thread owning a listener accepts its own share
+             *  without contending on a single accept queue.
+             */
+            if(reusePort){
+                rv = setsockopt(socketfd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(int));
+                if(rv != 0){
+                    std::cerr << "error: " << __func__ << ", setsockopt SO_REUSEPORT, " 
+                            << strerror(errno) << std::endl;
+                    close_socket();
+                    continue;
+                }
+            }
+
+
+            /** Socket buffer sizes must be set on the listener, before the
+             *  handshake, for the window scale to cover them. Accepted
+             *  sockets get the full set of options in accept_client_connection.
+             */
+            apply_socket_options(socketfd, options);
+
+
             // bind the socket to address
             rv = bind(socketfd, p->ai_addr, p->ai_addrlen);
             if(rv == 0){
@@ -187,6 +222,14 @@ namespace mysocket{
             return -1;
         }
 
+        /** A backlog larger than net.core.somaxconn is silently truncated,
+        *   so AUTO_BACKLOG asks for exactly the system maximum.
+        */
+        if(backlog == AUTO_BACKLOG || backlog <= 0){
+            backlog = max_listen_backlog();
+        }
+        log_trace("listen backlog %d", backlog);
+
         /** int listen(int sockfd, int backlog);
         *   The backlog argument defines the maximum length to which the queue of pending
         *   connections for sockfd may grow.
@@ -205,6 +248,148 @@ namespace mysocket{
         return 0;
     }
 
+
+    int SocketServer::initialize_unix(const char* address, int backlog)
+    {
+        unix_address_t ua;
+        struct stat st;
+
+        if(parse_unix_address(address, &ua) != 0){
+            return -1;
+        }
+
+        socketfd = socket(AF_UNIX, ua.socketType | SOCK_CLOEXEC, 0);
+        if(socketfd == -1){
+            std::cerr << "error: " << __func__ << ", socket, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        /** A path bound by an earlier run stays in the file system after the
+        *   process exits and makes bind fail with EADDRINUSE. It is the
+        *   equivalent of SO_REUSEADDR for TCP: remove it, but only if it
+        *   is a socket, never a regular file given by mistake, and only if
+        *   no process answers on it. A stale path refuses the connect.
+        */
+        if(!ua.abstract && lstat(ua.name.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)){
+            int probe = socket(AF_UNIX, ua.socketType | SOCK_CLOEXEC, 0);
+            if(probe != -1){
+                if(connect(probe, (const struct sockaddr*)(const void*)&ua.address, ua.length) == 0){
+                    close(probe);
+                    close_socket();
+                    std::cerr << "error: " << __func__ << ", " << ua.name
+                            << " is served by another process" << std::endl;
+                    errno = EADDRINUSE;
+                    return -1;
+                }
+                close(probe);
+            }
+            unlink(ua.name.c_str());
+        }
+
+        if(bind(socketfd, (const struct sockaddr*)(const void*)&ua.address, ua.length) != 0){
+            std::cerr << "error: " << __func__ << ", bind " << ua.name << ", "
+                    << strerror(errno) << std::endl;
+            close_socket();
+            return -1;
+        }
+        if(!ua.abstract){
+            unixPath = ua.name;
+        }
+
+        // SO_TIMESTAMPING is a TCP/UDP facility, and MSG_ERRQUEUE is not
+        // understood by unix stream sockets
+        options.timestamping = false;
+
+        // only the buffer sizes of socket_options_t apply to unix sockets,
+        // the TCP options would be reported as failures
+        if(options.sendBufferSize > 0 || options.receiveBufferSize > 0){
+            socket_options_t buffers;
+            buffers.sendBufferSize = options.sendBufferSize;
+            buffers.receiveBufferSize = options.receiveBufferSize;
+            apply_socket_options(socketfd, buffers);
+        }
+
+        if(backlog == AUTO_BACKLOG || backlog <= 0){
+            backlog = max_listen_backlog();
+        }
+
+        if(listen(socketfd, backlog) != 0){
+            std::cerr << "error: " << __func__ << ", listen failed "
+                << strerror(errno) << std::endl;
+            close_socket();
+            return -1;
+        }
+
+        log_debug("listening on %s", address);
+        return 0;
+    }
+
+
+    int SocketServer::adopt(int listenfd){
+        int listening = 0;
+        socklen_t length = sizeof(listening);
+        struct sockaddr_storage address;
+        socklen_t addressLength = sizeof(address);
+
+        /** SO_ACCEPTCONN reports whether listen was called on the socket,
+        *   getsockname what it is bound to.
+        */
+        if(getsockopt(listenfd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) != 0 ||
+                listening == 0 ||
+                getsockname(listenfd, (struct sockaddr*)&address, &addressLength) != 0){
+            std::cerr << "error: " << __func__ << ", fd " << listenfd
+                    << " is not a listening socket" << std::endl;
+            return -1;
+        }
+
+        close_socket();
+        socketfd = listenfd;
+        servicePort = 0;
+        unixSocket = address.ss_family == AF_UNIX;
+
+        if(address.ss_family == AF_INET){
+            servicePort = ntohs(((struct sockaddr_in*)&address)->sin_port);
+        }
+        else if(address.ss_family == AF_INET6){
+            servicePort = ntohs(((struct sockaddr_in6*)&address)->sin6_port);
+        }
+        else if(unixSocket){
+            // see initialize_unix
+            options.timestamping = false;
+
+            // a path, not an abstract name, is removed by close_socket
+            const struct sockaddr_un *ua = (const struct sockaddr_un*)&address;
+            if(addressLength > offsetof(struct sockaddr_un, sun_path) && ua->sun_path[0] != '\0'){
+                unixPath = ua->sun_path;
+            }
+        }
+
+        log_debug("adopted listening socket fd %d", listenfd);
+        return 0;
+    }
+
+    int SocketServer::release(){
+        int fd = socketfd;
+        socketfd = -1;
+        unixPath.clear();
+        return fd;
+    }
+
+
+    int SocketServer::max_listen_backlog(){
+        int value = 0;
+
+        FILE *fp = fopen("/proc/sys/net/core/somaxconn", "r");
+        if(fp != NULL){
+            if(fscanf(fp, "%d", &value) != 1){
+                value = 0;
+            }
+            fclose(fp);
+        }
+        return value > 0 ? value : SOMAXCONN;
+    }
+
     
     int SocketServer::accept_client_connection(client_info_t *theConnection){
 
@@ -235,34 +420,66 @@ namespace mysocket{
             perror("accept: ");
             return -1;
         }
-        else return 0;
+
+        // unix sockets inherit the listener's buffer sizes and have no
+        // TCP options or transmit timestamps
+        if(!unixSocket){
+            apply_socket_options(theConnection->fd, options);
+        }
+
+        // OPT_ID numbers bytes from the state at this call, so TCP
+        // accepts it only on a connected socket
+        if(options.timestamping && !unixSocket){
+            enable_timestamping(theConnection->fd);
+            timestamps[theConnection->fd] = ConnectionTimestamps();
+        }
+        return 0;
     }
 
     ssize_t SocketServer::receive_data(int connectedFD, void* buf, size_t len){
+        return receive_data(connectedFD, buf, len, NULL);
+    }
+
+    ssize_t SocketServer::receive_data(int connectedFD, void* buf, size_t len,
+                                        struct timespec *kernelTime){
         ssize_t bytesRead;
-        bytesRead = recv(connectedFD, buf, len, 0);
+        if(options.timestamping){
+            bytesRead = timestamps[connectedFD].receive(connectedFD, buf, len, 0, kernelTime);
+        }
+        else{
+            bytesRead = recv(connectedFD, buf, len, 0);
+        }
+        if(options.quickAck && bytesRead > 0){
+            rearm_quickack(connectedFD);
+        }
         return bytesRead;
     }
 
     ssize_t SocketServer::send_data(int connectedFD, void* buf, size_t len){
 
-        ssize_t totalBytesSent = 0;
+        const uint8_t *data = (const uint8_t*)buf;
+        size_t totalBytesSent = 0;
         ssize_t bytesSent;
-        ssize_t bytesRemaining = len - totalBytesSent;
+        uint64_t startNs = options.timestamping ? realtime_ns() : 0;
 
-        while(bytesRemaining > 0){
+        while(totalBytesSent < len){
 
             /* MSG_NOSIGNAL - don't generate a SIGPIPE signal if the peer
             *  on a stream-oriented socket has closed the connection.
             */
-            bytesSent = send(connectedFD, buf, bytesRemaining, MSG_NOSIGNAL);
+            bytesSent = send(connectedFD, data + totalBytesSent, len - totalBytesSent,
+                            MSG_NOSIGNAL);
 
             if(bytesSent > 0){
-                totalBytesSent += bytesSent;
+                totalBytesSent += size_t(bytesSent);
             }
-            else if(bytesSent == 0){
-                //std::cerr << "warn: " << __func__ << ", bytesSent: " << bytesSent 
-                //    << std::endl;
+            else if(bytesSent < 0 && errno == EINTR){
+                continue;
+            }
+            else if(bytesSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+                // non-blocking socket is full, the caller queues the rest,
+                // see OutboundQueue
+                break;
             }
             else{
                 std::cerr << "warn: " << __func__ << ", bytesSent: " << bytesSent
@@ -270,10 +487,34 @@ namespace mysocket{
                 break;
             }
 
-            bytesRemaining = len - totalBytesSent;
-            log_trace("bytesSent %ld, bytesRemaining %ld", bytesSent, bytesRemaining);
+            log_trace("bytesSent %ld, bytesRemaining %zu", bytesSent, len - totalBytesSent);
+        }
+
+        if(options.timestamping){
+            // keep the errno of a short send for the caller
+            int error = errno;
+            timestamps[connectedFD].on_send(connectedFD, totalBytesSent, startNs);
+            errno = error;
+        }
+        return ssize_t(totalBytesSent);
+    }
+
+    ssize_t SocketServer::send_data(int connectedFD, const struct iovec *iov, int iovcnt){
+        uint64_t startNs = options.timestamping ? realtime_ns() : 0;
+        ssize_t bytesSent = send_iov(connectedFD, iov, iovcnt);
+        if(options.timestamping && bytesSent > 0){
+            // keep the errno of a short send for the caller
+            int error = errno;
+            timestamps[connectedFD].on_send(connectedFD, size_t(bytesSent), startNs);
+            errno = error;
+        }
+        return bytesSent;
+    }
+
+    void SocketServer::dump_latency(std::ostream &out){
+        for(auto &entry : timestamps){
+            entry.second.dump(out, entry.first);
         }
-        return totalBytesSent;
     }
 
     void SocketServer::close_socket(){
@@ -281,6 +522,10 @@ namespace mysocket{
             close(socketfd);
             socketfd = -1;
         }
+        if(!unixPath.empty()){
+            unlink(unixPath.c_str());
+            unixPath.clear();
+        }
     }
 
 } // end namespace
\ No newline at end of file
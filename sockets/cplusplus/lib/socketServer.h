@@ -2,7 +2,14 @@
 #define SOCKET_SERVER_H
 
 #include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
 #include <netinet/in.h>                 // struct sockaddr_in
+#include <sys/uio.h>                    // struct iovec
+
+#include "socketOptions.h"
+#include "timestamping.h"
 
 namespace mysocket{
 
@@ -20,6 +27,9 @@ namespace mysocket{
 
         // constants
         static constexpr int BACKLOG_QUEUE_SIZE = 5;
+
+        // pass as maxpending to size the listen queue to the system limit
+        static constexpr int AUTO_BACKLOG = -1;
         static constexpr int RECEIVE_BUFFER_LENGTH = 2048;
 
         // constructor
@@ -28,13 +38,54 @@ namespace mysocket{
         // destructor
         ~SocketServer();
 
-        int initialize(const char* port, int maxpending);
+        // reusePort sets SO_REUSEPORT so that several listening sockets,
+        // one per thread, may bind the same port. The kernel spreads
+        // incoming connections across them.
+        // port may also be a unix domain address, "unix:/path" or
+        // "unix:@name", see unixSocket.h. reusePort does not apply to it.
+        int initialize(const char* port, int maxpending, bool reusePort = false);
+
+        // takes ownership of a socket that is already listening, e.g. one
+        // received in a ListenerHandoff, in place of initialize.
+        // returns 0 upon success, -1 when fd is not a listening socket
+        int adopt(int listenfd);
+
+        // gives up ownership of the listening socket without closing it or
+        // removing its unix socket file, e.g. after handing it to another
+        // process. returns the descriptor, -1 when not listening
+        int release();
+
+        // tuning for the listener and every accepted socket, see
+        // low_latency_profile and bulk_profile. Call before initialize.
+        void set_options(const socket_options_t &opts){options = opts;}
 
         int accept_client_connection(client_info_t *theConnection);
 
+        // largest listen backlog the kernel honors, net.core.somaxconn
+        static int max_listen_backlog();
+
         ssize_t receive_data(int connectedFD, void* buf, size_t len);
+
+        // with options.timestamping, also returns the time the kernel
+        // received the data (CLOCK_REALTIME), zero when not available
+        ssize_t receive_data(int connectedFD, void* buf, size_t len, struct timespec *kernelTime);
+
+        // returns bytes sent. On a non-blocking socket this stops short
+        // when the socket buffer fills, OutboundQueue keeps the remainder
         ssize_t send_data(int connectedFD, void* buf, size_t len);
 
+        // scatter-gather send, e.g. a header and a payload in separate
+        // buffers go out in one system call without copying them together.
+        // For large payloads see ZeroCopySender in socketIO.h
+        ssize_t send_data(int connectedFD, const struct iovec *iov, int iovcnt);
+
+        // per-connection wire-to-user and user-to-wire latency histograms,
+        // recorded while options.timestamping is set
+        void dump_latency(std::ostream &out);
+
+        // drops the histograms of a connection, call when closing it
+        void clear_latency(int connectedFD){timestamps.erase(connectedFD);}
+
         int get_fd(){return socketfd;}
 
         // disable copy semantics
@@ -48,8 +99,16 @@ namespace mysocket{
         private:
             int socketfd;
             int servicePort;
+            socket_options_t options;
+            std::unordered_map<int, ConnectionTimestamps> timestamps;
+
+            // listening on a unix domain address; the socket file created
+            // by bind, removed by close_socket
+            bool unixSocket;
+            std::string unixPath;
 
             int bind_server();
+            int initialize_unix(const char* address, int backlog);
     };
 }
 
@@ -0,0 +1,218 @@
+#include <cstring>              // strerror
+#include <unistd.h>             // close, pipe2
+#include <fcntl.h>              // splice, F_SETPIPE_SZ
+
+#include <iostream>
+#include <cerrno>
+
+#include <signal.h>             // pthread_sigmask, sigtimedwait
+#include <sys/socket.h>         // shutdown
+
+#include <debuglog/debuglog.h>
+
+#include "spliceRelay.h"
+
+
+namespace mysocket{
+
+    SpliceRelay::SpliceRelay(EventLoop &eventLoop){
+        loop = &eventLoop;
+        bytesRelayed = 0;
+    }
+
+    SpliceRelay::~SpliceRelay(){
+        while(!pairs.empty()){
+            close_pair(pairs.begin()->first);
+        }
+    }
+
+    int SpliceRelay::open_direction(direction_t &d, int from, int to){
+        d.from = from;
+        d.to = to;
+
+        if(pipe2(d.pipefd, O_NONBLOCK | O_CLOEXEC) != 0){
+            std::cerr << "error: " << __func__ << ", pipe2, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        // the default 64 KB pipe limits how far one direction can run
+        // ahead of a slow destination; failure just keeps the default
+        if(fcntl(d.pipefd[1], F_SETPIPE_SZ, PIPE_SIZE) == -1){
+            log_debug("F_SETPIPE_SZ: %s", strerror(errno));
+        }
+        return 0;
+    }
+
+    int SpliceRelay::add(int clientfd, SocketClient &upstream){
+        int upstreamfd = upstream.release();
+        if(upstreamfd == -1){
+            close(clientfd);
+            return -1;
+        }
+        return add(clientfd, upstreamfd);
+    }
+
+    int SpliceRelay::add(int clientfd, int upstreamfd){
+        pair_t &p = pairs[clientfd];
+        p.clientfd = clientfd;
+        p.upstreamfd = upstreamfd;
+        owner[clientfd] = clientfd;
+        owner[upstreamfd] = clientfd;
+
+        if(open_direction(p.toUpstream, clientfd, upstreamfd) != 0 ||
+                open_direction(p.toClient, upstreamfd, clientfd) != 0 ||
+                set_nonblocking(clientfd) != 0 || set_nonblocking(upstreamfd) != 0){
+            close_pair(clientfd);
+            return -1;
+        }
+
+        // edge triggered on both directions, on_event pumps until EAGAIN
+        EventLoop::Callback cb = [this](int fd, uint32_t){on_event(fd);};
+        if(loop->add(clientfd, EventLoop::READ | EventLoop::WRITE, cb) != 0 ||
+                loop->add(upstreamfd, EventLoop::READ | EventLoop::WRITE, cb) != 0){
+            close_pair(clientfd);
+            return -1;
+        }
+
+        log_debug("relay fd %d <-> fd %d", clientfd, upstreamfd);
+
+        // data may have arrived before registration
+        on_event(clientfd);
+        return 0;
+    }
+
+    /*  Moves bytes from d.from to d.to until the source has nothing more,
+    *   the destination is full, or the source ended. returns 0 to keep the
+    *   direction open, -1 on a connection error.
+    */
+    int SpliceRelay::pump(direction_t &d){
+        for(;;){
+            bool progress = false;
+
+            /** ssize_t splice(int fd_in, loff_t *off_in, int fd_out,
+            *                  loff_t *off_out, size_t len, unsigned int flags);
+            *
+            *   Moves data between two descriptors, one of which must be a
+            *   pipe, inside the kernel. SPLICE_F_MOVE asks for pages to be
+            *   moved rather than copied, SPLICE_F_NONBLOCK keeps the pipe
+            *   side from blocking.
+            */
+            if(!d.sourceEnded && d.inPipe < size_t(PIPE_SIZE)){
+                ssize_t n = splice(d.from, NULL, d.pipefd[1], NULL, SPLICE_CHUNK,
+                                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if(n > 0){
+                    d.inPipe += size_t(n);
+                    progress = true;
+                }
+                else if(n == 0){
+                    d.sourceEnded = true;
+                    progress = true;
+                }
+                else if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                    log_debug("splice from fd %d: %s", d.from, strerror(errno));
+                    return -1;
+                }
+            }
+
+            if(d.inPipe > 0){
+                ssize_t n = splice(d.pipefd[0], NULL, d.to, NULL, d.inPipe,
+                                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if(n > 0){
+                    d.inPipe -= size_t(n);
+                    bytesRelayed += uint64_t(n);
+                    progress = true;
+                }
+                else if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
+                    log_debug("splice to fd %d: %s", d.to, strerror(errno));
+                    return -1;
+                }
+            }
+
+            if(!progress){
+                break;
+            }
+        }
+
+        // source finished and everything forwarded, pass the FIN on
+        if(d.sourceEnded && d.inPipe == 0 && !d.shutdownSent){
+            shutdown(d.to, SHUT_WR);
+            d.shutdownSent = true;
+            log_debug("fd %d ended, shut down fd %d", d.from, d.to);
+        }
+        return 0;
+    }
+
+    void SpliceRelay::on_event(int fd){
+        auto o = owner.find(fd);
+        if(o == owner.end()){
+            return;
+        }
+        int clientfd = o->second;
+        pair_t &p = pairs[clientfd];
+
+        /** splice has no MSG_NOSIGNAL. Splicing into a socket whose peer
+        *   has gone raises SIGPIPE, which kills the process by default.
+        *   Block it while pumping; a SIGPIPE raised meanwhile is taken off
+        *   the pending set with sigtimedwait before the mask is restored,
+        *   and the splice fails with EPIPE as usual. When the caller
+        *   already blocks SIGPIPE, its pending signals are left alone.
+        */
+        sigset_t pipeSet, oldSet;
+        sigemptyset(&pipeSet);
+        sigaddset(&pipeSet, SIGPIPE);
+        pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+
+        // readable source or writable destination both let a direction
+        // move, so an event on either socket pumps both directions
+        bool failed = pump(p.toUpstream) != 0 || pump(p.toClient) != 0;
+
+        if(failed && !sigismember(&oldSet, SIGPIPE)){
+            struct timespec noWait = {0, 0};
+            while(sigtimedwait(&pipeSet, NULL, &noWait) == SIGPIPE){
+            }
+        }
+        pthread_sigmask(SIG_SETMASK, &oldSet, NULL);
+
+        if(failed){
+            close_pair(clientfd);
+            return;
+        }
+
+        if(p.toUpstream.shutdownSent && p.toClient.shutdownSent){
+            close_pair(clientfd);
+        }
+    }
+
+    void SpliceRelay::close_pair(int clientfd){
+        auto it = pairs.find(clientfd);
+        if(it == pairs.end()){
+            return;
+        }
+        pair_t &p = it->second;
+
+        for(int fd : {p.clientfd, p.upstreamfd}){
+            if(fd != -1){
+                loop->remove(fd);
+                owner.erase(fd);
+                close(fd);
+            }
+        }
+        for(direction_t *d : {&p.toUpstream, &p.toClient}){
+            for(int &pfd : d->pipefd){
+                if(pfd != -1){
+                    close(pfd);
+                    pfd = -1;
+                }
+            }
+        }
+
+        pairs.erase(it);
+        log_debug("relay for fd %d closed", clientfd);
+
+        if(onClose){
+            onClose(clientfd);
+        }
+    }
+
+} // end namespace
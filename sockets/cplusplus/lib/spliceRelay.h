@@ -0,0 +1,102 @@
+#ifndef SPLICE_RELAY_H
+#define SPLICE_RELAY_H
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include "eventLoop.h"
+#include "socketClient.h"
+
+namespace mysocket{
+
+    /*  Forwards bytes between pairs of connected sockets without copying
+    *   them through user space.
+    *
+    *   Each direction of a pair owns a pipe. splice moves data from the
+    *   source socket into the pipe and from the pipe into the destination
+    *   socket; the kernel passes page references along instead of copying
+    *   payload into and out of a user buffer, so a relay costs two system
+    *   calls per chunk and no memory bandwidth for the payload.
+    *
+    *   Half-close: when one side shuts down its sending direction, the
+    *   relay finishes forwarding what is buffered and then shuts down the
+    *   same direction towards the other side, which can keep sending. The
+    *   pair is closed once both directions have ended or on an error.
+    *
+    *   Runs on an EventLoop, sockets are made non-blocking. SIGPIPE from
+    *   a destination that has gone is absorbed, the process need not
+    *   ignore it.
+    */
+    class SpliceRelay{
+        public:
+
+        // bytes requested per splice call
+        static constexpr size_t SPLICE_CHUNK = 65536;
+
+        // pipe capacity requested with F_SETPIPE_SZ, bounds the bytes in
+        // flight per direction
+        static constexpr int PIPE_SIZE = 262144;
+
+        // called with the client descriptor after a pair is closed
+        using CloseCallback = std::function<void(int clientfd)>;
+
+        explicit SpliceRelay(EventLoop &loop);
+
+        // closes every pair
+        ~SpliceRelay();
+
+        // relays between two connected sockets, taking ownership of both.
+        // returns 0 upon success, -1 upon failure (both are closed)
+        int add(int clientfd, int upstreamfd);
+
+        // same, the upstream socket is taken from a connected SocketClient
+        int add(int clientfd, SocketClient &upstream);
+
+        void set_close_callback(CloseCallback cb){onClose = std::move(cb);}
+
+        size_t size(){return pairs.size();}
+        uint64_t get_bytes_relayed(){return bytesRelayed;}
+
+        // disable copy semantics
+        SpliceRelay(const SpliceRelay&) = delete;
+        SpliceRelay& operator=(const SpliceRelay&) = delete;
+
+
+        private:
+
+            struct direction_t{
+                int from = -1;
+                int to = -1;
+                int pipefd[2] = {-1, -1};
+                size_t inPipe = 0;          // bytes spliced in, not yet out
+                bool sourceEnded = false;   // read returned 0
+                bool shutdownSent = false;  // SHUT_WR sent to the destination
+            };
+
+            struct pair_t{
+                int clientfd;
+                int upstreamfd;
+                direction_t toUpstream;
+                direction_t toClient;
+            };
+
+            EventLoop *loop;
+            CloseCallback onClose;
+            uint64_t bytesRelayed;
+
+            // keyed by client descriptor
+            std::unordered_map<int, pair_t> pairs;
+
+            // either descriptor of a pair to the client descriptor
+            std::unordered_map<int, int> owner;
+
+            int open_direction(direction_t &d, int from, int to);
+            int pump(direction_t &d);
+            void on_event(int fd);
+            void close_pair(int clientfd);
+    };
+}
+
+
+#endif
@@ -0,0 +1,106 @@
+#include <cstring>              // strerror
+#include <unistd.h>             // close, read, write
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/eventfd.h>
+#include <sys/uio.h>            // struct iovec
+
+#include <debuglog/debuglog.h>
+
+#include "submissionQueue.h"
+
+
+namespace mysocket{
+
+    SubmissionQueue::SubmissionQueue(EventLoop &eventLoop, OutboundQueue &outbound){
+        loop = &eventLoop;
+        out = &outbound;
+        signalled = false;
+        closed = false;
+
+        // readable while a wakeup is pending, see WorkerPool
+        wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(wakefd == -1){
+            std::cerr << "error: " << __func__ << ", eventfd, "
+                    << strerror(errno) << std::endl;
+            return;
+        }
+
+        if(loop->add(wakefd, EventLoop::READ, [this](int, uint32_t){
+                    if(drain() < 0 && onError){
+                        onError();
+                    }
+                }) != 0){
+            ::close(wakefd);
+            wakefd = -1;
+        }
+    }
+
+    SubmissionQueue::~SubmissionQueue(){
+        if(wakefd != -1){
+            loop->remove(wakefd);
+            ::close(wakefd);
+            wakefd = -1;
+        }
+    }
+
+    int SubmissionQueue::submit(const void *buf, size_t len){
+        const uint8_t *bytes = static_cast<const uint8_t*>(buf);
+        return submit(std::vector<uint8_t>(bytes, bytes + len));
+    }
+
+    int SubmissionQueue::submit(std::vector<uint8_t> &&message){
+        if(closed.load()){
+            errno = EPIPE;
+            return -1;
+        }
+
+        messages.push(std::move(message));
+
+        /** The exchange comes after the push. drain clears the flag before
+        *   it pops, so either drain sees this message, or the exchange
+        *   below sees false and wakes the loop for another drain.
+        */
+        if(!signalled.exchange(true)){
+            uint64_t one = 1;
+            if(write(wakefd, &one, sizeof(one)) != sizeof(one)){
+                log_warn("submission wakeup failed: %s", strerror(errno));
+            }
+        }
+        return 0;
+    }
+
+    int SubmissionQueue::drain(){
+        uint64_t count;
+        std::vector<uint8_t> batch[DRAIN_BATCH];
+        struct iovec iov[DRAIN_BATCH];
+        int written = 0;
+
+        if(read(wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+            log_warn("submission read failed: %s", strerror(errno));
+        }
+        signalled.store(false);
+
+        // small messages from many producers go out with one gather write
+        // per batch instead of one send each
+        for(;;){
+            int n = 0;
+            while(n < DRAIN_BATCH && messages.pop(batch[n])){
+                iov[n].iov_base = batch[n].data();
+                iov[n].iov_len = batch[n].size();
+                ++n;
+            }
+            if(n == 0){
+                break;
+            }
+            if(out->send(iov, n) != 0){
+                return -1;
+            }
+            written += n;
+        }
+        return written;
+    }
+
+} // end namespace
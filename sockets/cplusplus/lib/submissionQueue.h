@@ -0,0 +1,91 @@
+#ifndef SUBMISSION_QUEUE_H
+#define SUBMISSION_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "eventLoop.h"
+#include "mpscQueue.h"
+#include "outboundQueue.h"
+
+namespace mysocket{
+
+    /*  Lets any thread send on a connection owned by an EventLoop thread.
+    *
+    *   Calling send on one socket from several threads interleaves their
+    *   bytes. Instead, other threads submit whole messages to this queue,
+    *   and the thread running the loop writes them to the connection's
+    *   OutboundQueue one message at a time, so messages never mix and
+    *   each producer's messages leave in the order submitted.
+    *
+    *   submit is lock-free: two allocations, the message vector and the
+    *   queue node (only the node when a vector is moved in), one atomic
+    *   exchange to queue the message and, only when the queue was idle,
+    *   one eventfd write to wake the loop. Messages submitted while a wakeup is pending share
+    *   it, so a busy producer costs the loop one wakeup per batch.
+    *
+    *       auto sq = std::make_shared<SubmissionQueue>(loop, out);
+    *       std::thread([sq]{ sq->submit(msg, len); }).detach();
+    *
+    *   The object has to outlive every producer, share it with
+    *   std::shared_ptr when producers are not joined first.
+    */
+    class SubmissionQueue{
+        public:
+
+        // messages written to the connection with one gather write
+        static constexpr int DRAIN_BATCH = 64;
+
+        // called on the loop thread when writing to the connection failed
+        using ErrorCallback = std::function<void()>;
+
+        // out belongs to the connection and must outlive this object, loop
+        // is the loop driving it. Registers an eventfd with loop.
+        SubmissionQueue(EventLoop &loop, OutboundQueue &out);
+
+        // unregisters and closes the eventfd, drops undelivered messages
+        ~SubmissionQueue();
+
+        bool is_ready(){return wakefd != -1;}
+
+        // any thread. returns 0 upon success, -1 with errno EPIPE after
+        // close was called
+        int submit(const void *buf, size_t len);
+        int submit(std::vector<uint8_t> &&message);
+
+        // loop thread. Writes every submitted message to the connection,
+        // also called by the eventfd callback.
+        // returns number of messages written, -1 when the connection failed
+        int drain();
+
+        // loop thread. Later submits fail, e.g. once the connection closed
+        void close(){closed.store(true);}
+
+        void set_error_callback(ErrorCallback cb){onError = std::move(cb);}
+
+        int get_fd(){return wakefd;}
+
+        // disable copy semantics
+        SubmissionQueue(const SubmissionQueue&) = delete;
+        SubmissionQueue& operator=(const SubmissionQueue&) = delete;
+
+
+        private:
+            EventLoop *loop;
+            OutboundQueue *out;
+            ErrorCallback onError;
+
+            MpscQueue<std::vector<uint8_t>> messages;
+            int wakefd;
+
+            // true from the first submit after a drain started until the
+            // next drain, only that submit writes the eventfd
+            std::atomic<bool> signalled;
+            std::atomic<bool> closed;
+    };
+}
+
+
+#endif
@@ -0,0 +1,143 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <exception>                    // std::terminate
+#include <optional>
+#include <utility>
+
+namespace mysocket{
+
+    /*  Coroutine return type, requires C++20.
+    *
+    *   A Task does not run until it is awaited. co_await on a Task starts
+    *   it and suspends the awaiting coroutine; when the Task finishes, the
+    *   awaiting coroutine resumes with the co_return value. Control moves
+    *   between the two by symmetric transfer, so long chains of awaits do
+    *   not grow the stack.
+    *
+    *   The library does not throw; an exception escaping a Task terminates
+    *   the program.
+    *
+    *       Task<ssize_t> read_header(AsyncConnection &conn){
+    *           uint8_t header[4];
+    *           ssize_t n = co_await conn.read_some(header, sizeof(header));
+    *           co_return n;
+    *       }
+    */
+    template<typename T>
+    class Task;
+
+
+    namespace detail{
+
+        struct promise_base{
+            // coroutine to resume when this one finishes
+            std::coroutine_handle<> continuation;
+
+            struct final_awaiter{
+                bool await_ready() noexcept {return false;}
+
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept{
+                    std::coroutine_handle<> next = h.promise().continuation;
+                    return next ? next : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept {return {};}
+            final_awaiter final_suspend() noexcept {return {};}
+            void unhandled_exception() noexcept {std::terminate();}
+        };
+
+
+        template<typename T>
+        struct promise : promise_base{
+            std::optional<T> value;
+
+            Task<T> get_return_object() noexcept;
+
+            template<typename U>
+            void return_value(U &&v){value.emplace(std::forward<U>(v));}
+
+            T result(){return std::move(*value);}
+        };
+
+
+        template<>
+        struct promise<void> : promise_base{
+            Task<void> get_return_object() noexcept;
+            void return_void() noexcept {}
+            void result(){}
+        };
+    }
+
+
+    template<typename T = void>
+    class Task{
+        public:
+
+        using promise_type = detail::promise<T>;
+        using handle_type = std::coroutine_handle<promise_type>;
+
+        Task() noexcept : handle(nullptr) {}
+        explicit Task(handle_type h) noexcept : handle(h) {}
+
+        ~Task(){
+            if(handle){
+                handle.destroy();
+            }
+        }
+
+        // move semantics transfer ownership of the coroutine frame
+        Task(Task &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+        Task& operator=(Task &&other) noexcept{
+            if(this != &other){
+                if(handle){
+                    handle.destroy();
+                }
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+        // disable copy semantics
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        bool done() const {return !handle || handle.done();}
+
+        // awaiting starts the task and resumes the caller when it finishes
+        bool await_ready() const noexcept {return !handle || handle.done();}
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller) noexcept{
+            handle.promise().continuation = caller;
+            return handle;
+        }
+
+        T await_resume(){return handle.promise().result();}
+
+
+        private:
+            handle_type handle;
+    };
+
+
+    namespace detail{
+
+        template<typename T>
+        Task<T> promise<T>::get_return_object() noexcept{
+            return Task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> promise<void>::get_return_object() noexcept{
+            return Task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+        }
+    }
+}
+
+
+#endif
@@ -0,0 +1,239 @@
+#include "timerWheel.h"
+
+
+namespace mysocket{
+
+    TimerWheel::TimerWheel(int tick){
+        tickMs = tick > 0 ? tick : DEFAULT_TICK_MS;
+        start = Clock::now();
+        currentTick = 0;
+        count = 0;
+        freeList = NIL;
+        for(uint32_t &head : heads){
+            head = NIL;
+        }
+    }
+
+    TimerWheel::timer_id_t TimerWheel::schedule(int delayMs, Callback cb){
+        uint32_t index;
+
+        if(freeList != NIL){
+            index = freeList;
+            freeList = nodes[index].next;
+        }
+        else{
+            index = uint32_t(nodes.size());
+            nodes.emplace_back();
+            nodes[index].generation = 1;
+        }
+
+        node_t &n = nodes[index];
+        n.callback = std::move(cb);
+        n.expires = tick_at(Clock::now(), delayMs);
+        link(index);
+        ++count;
+
+        return (uint64_t(n.generation) << 32) | index;
+    }
+
+    int TimerWheel::reschedule(timer_id_t id, int delayMs){
+        node_t *n = find(id);
+        if(n == nullptr){
+            return -1;
+        }
+
+        uint32_t index = uint32_t(id);
+        unlink(index);
+        n->expires = tick_at(Clock::now(), delayMs);
+        link(index);
+        return 0;
+    }
+
+    bool TimerWheel::cancel(timer_id_t id){
+        if(find(id) == nullptr){
+            return false;
+        }
+
+        uint32_t index = uint32_t(id);
+        unlink(index);
+        release(index);
+        --count;
+        return true;
+    }
+
+    bool TimerWheel::is_pending(timer_id_t id){
+        return find(id) != nullptr;
+    }
+
+    int TimerWheel::expire(){
+        if(count == 0){
+            return 0;
+        }
+        return expire(Clock::now());
+    }
+
+    int TimerWheel::expire(Clock::time_point now){
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count();
+        int ran = 0;
+
+        // the last tick that has fully begun, the one in progress is not due
+        uint64_t target = ns > 0 ? uint64_t(ns / (int64_t(tickMs) * 1000000)) : 0;
+
+        while(currentTick < target){
+
+            // nothing pending, skip the empty ticks in one step
+            if(count == 0){
+                currentTick = target;
+                break;
+            }
+
+            ++currentTick;
+
+            /** When a level wraps around, the next slot of the level above
+            *   covers the ticks that are now within reach, its timers move
+            *   down to the finer levels.
+            */
+            for(int level = 1; level < LEVELS; ++level){
+                if((currentTick >> (SLOT_BITS * (level - 1))) & SLOT_MASK){
+                    break;
+                }
+                cascade(level);
+            }
+
+            // every timer in this level 0 slot expires on this tick
+            uint32_t &head = heads[currentTick & SLOT_MASK];
+            while(head != NIL){
+                uint32_t index = head;
+                unlink(index);
+
+                // the callback may schedule timers and grow the node vector
+                Callback cb = std::move(nodes[index].callback);
+                release(index);
+                --count;
+
+                cb();
+                ++ran;
+            }
+        }
+
+        return ran;
+    }
+
+    int TimerWheel::next_timeout_ms(){
+        if(count == 0){
+            return -1;
+        }
+
+        // the next level 0 wrap may bring timers down from level 1
+        uint64_t ticks = SLOTS - (currentTick & SLOT_MASK);
+        for(uint64_t d = 1; d < ticks; ++d){
+            if(heads[(currentTick + d) & SLOT_MASK] != NIL){
+                ticks = d;
+                break;
+            }
+        }
+
+        Clock::time_point due = start + std::chrono::milliseconds(
+                                    int64_t(currentTick + ticks) * tickMs);
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        due - Clock::now()).count();
+        if(ns <= 0){
+            return 0;
+        }
+        return int((ns + 999999) / 1000000);
+    }
+
+    TimerWheel::node_t* TimerWheel::find(timer_id_t id){
+        uint32_t index = uint32_t(id);
+        if(index >= nodes.size()){
+            return nullptr;
+        }
+
+        node_t &n = nodes[index];
+        if(n.slot == NO_SLOT || n.generation != uint32_t(id >> 32)){
+            return nullptr;
+        }
+        return &n;
+    }
+
+    uint64_t TimerWheel::tick_at(Clock::time_point t, int delayMs){
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t - start).count()
+                    + int64_t(delayMs > 0 ? delayMs : 0) * 1000000;
+        int64_t tickNs = int64_t(tickMs) * 1000000;
+
+        // rounded up, so a timer never fires early
+        uint64_t tick = uint64_t((ns + tickNs - 1) / tickNs);
+        return tick > currentTick ? tick : currentTick + 1;
+    }
+
+    void TimerWheel::link(uint32_t index){
+        node_t &n = nodes[index];
+        uint64_t delta = n.expires - currentTick;
+        uint64_t expires = n.expires;
+        int level = 0;
+
+        // the coarsest level still able to tell the expiry apart
+        while(level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))){
+            ++level;
+        }
+
+        // beyond the range of the wheel, parked in the last slot it can
+        // reach and linked again each time that slot is emptied
+        uint64_t range = uint64_t(1) << (SLOT_BITS * LEVELS);
+        if(delta >= range){
+            expires = currentTick + range - 1;
+        }
+
+        uint16_t slot = uint16_t(level * SLOTS +
+                            int((expires >> (SLOT_BITS * level)) & SLOT_MASK));
+        n.slot = slot;
+        n.prev = NIL;
+        n.next = heads[slot];
+        if(n.next != NIL){
+            nodes[n.next].prev = index;
+        }
+        heads[slot] = index;
+    }
+
+    void TimerWheel::unlink(uint32_t index){
+        node_t &n = nodes[index];
+
+        if(n.prev != NIL){
+            nodes[n.prev].next = n.next;
+        }
+        else{
+            heads[n.slot] = n.next;
+        }
+        if(n.next != NIL){
+            nodes[n.next].prev = n.prev;
+        }
+    }
+
+    void TimerWheel::release(uint32_t index){
+        node_t &n = nodes[index];
+
+        n.callback = nullptr;
+        n.slot = NO_SLOT;
+
+        // ids still held by the caller no longer match
+        if(++n.generation == 0){
+            n.generation = 1;
+        }
+        n.next = freeList;
+        freeList = index;
+    }
+
+    void TimerWheel::cascade(int level){
+        uint32_t &head = heads[level * SLOTS +
+                            int((currentTick >> (SLOT_BITS * level)) & SLOT_MASK)];
+        uint32_t index = head;
+        head = NIL;
+
+        while(index != NIL){
+            uint32_t next = nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+} // end namespace
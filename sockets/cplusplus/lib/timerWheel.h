@@ -0,0 +1,117 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace mysocket{
+
+    /*  Hierarchical timer wheel for per-connection timers: idle timeouts,
+    *   heartbeats and write deadlines.
+    *
+    *   Time is counted in ticks. Level 0 has one slot per tick for the next
+    *   64 ticks, level 1 one slot per 64 ticks, and so on for 4 levels,
+    *   2^24 ticks in all (46 hours at 10 ms). A timer goes into the slot
+    *   of the coarsest level that still tells its expiry apart, as a list
+    *   node. When level 0 wraps around, the next slot of level 1 is
+    *   emptied into the finer levels, and so on up.
+    *
+    *   schedule, reschedule and cancel are O(1): a timer is unlinked from
+    *   a doubly linked list found by its id. expire only visits the slots
+    *   for the ticks that passed, never the pending timers, so 100k idle
+    *   connections cost nothing until one of them is due. The price is
+    *   resolution: a timer fires up to one tick late, never early.
+    *
+    *   A heartbeat re-arms itself from its callback:
+    *
+    *       std::function<void()> beat = [&]{send_ping(fd); wheel.schedule(30000, beat);};
+    *
+    *   Not thread safe, every call is made from the thread running expire.
+    */
+    class TimerWheel{
+        public:
+
+        using Clock = std::chrono::steady_clock;
+        using Callback = std::function<void()>;
+
+        // 0 is never a valid id, use it for "no timer"
+        using timer_id_t = uint64_t;
+
+        static constexpr int DEFAULT_TICK_MS = 10;
+
+        // constructor
+        explicit TimerWheel(int tickMs = DEFAULT_TICK_MS);
+
+        // runs cb once, delayMs milliseconds from now. returns the id
+        timer_id_t schedule(int delayMs, Callback cb);
+
+        // moves a pending timer to delayMs milliseconds from now, keeping
+        // its callback. returns 0 upon success, -1 when id is not pending
+        int reschedule(timer_id_t id, int delayMs);
+
+        // returns true when the timer was pending and will not run
+        bool cancel(timer_id_t id);
+
+        bool is_pending(timer_id_t id);
+
+        // runs the callbacks of every timer that is due.
+        // returns the number run
+        int expire();
+        int expire(Clock::time_point now);
+
+        // milliseconds until expire has work to do, for the timeout of
+        // epoll_wait, select or poll. -1 when no timer is pending. May be
+        // earlier than the next expiry, when a coarser slot is due to be
+        // emptied.
+        int next_timeout_ms();
+
+        size_t size(){return count;}
+        int get_tick_ms(){return tickMs;}
+
+        // disable copy semantics
+        TimerWheel(const TimerWheel&) = delete;
+        TimerWheel& operator=(const TimerWheel&) = delete;
+
+
+        private:
+
+            static constexpr int LEVELS = 4;
+            static constexpr int SLOT_BITS = 6;
+            static constexpr int SLOTS = 1 << SLOT_BITS;
+            static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+            static constexpr uint32_t NIL = UINT32_MAX;
+            static constexpr uint16_t NO_SLOT = UINT16_MAX;
+
+            // nodes live in one vector and link by index, freed nodes are
+            // reused, so arming a timer allocates nothing once warmed up
+            struct node_t{
+                Callback callback;
+                uint64_t expires;           // tick
+                uint32_t prev;
+                uint32_t next;              // also links the free list
+                uint32_t generation;        // bumped when freed, stale ids miss
+                uint16_t slot;              // level * SLOTS + slot, NO_SLOT when free
+            };
+
+            int tickMs;
+            Clock::time_point start;
+            uint64_t currentTick;           // every tick up to here was run
+            size_t count;
+
+            std::vector<node_t> nodes;
+            uint32_t freeList;
+            uint32_t heads[LEVELS * SLOTS];
+
+            node_t* find(timer_id_t id);
+            uint64_t tick_at(Clock::time_point t, int delayMs);
+            void link(uint32_t index);
+            void unlink(uint32_t index);
+            void release(uint32_t index);
+            void cascade(int level);
+    };
+}
+
+
+#endif
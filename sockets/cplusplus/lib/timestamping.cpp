@@ -0,0 +1,299 @@
+#include <cstring>              // memset, memcpy, strerror
+#include <cstdio>               // snprintf
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <linux/errqueue.h>     // struct sock_extended_err, scm_timestamping
+#include <linux/net_tstamp.h>   // SOF_TIMESTAMPING_*
+#include <netinet/in.h>
+
+#include <debuglog/debuglog.h>
+
+#include "timestamping.h"
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY 60
+#endif
+
+
+namespace mysocket{
+
+    // unacknowledged sends kept for matching, older ones are dropped
+    static constexpr size_t MAX_PENDING_SENDS = 4096;
+
+    uint64_t realtime_ns(){
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    }
+
+    static uint64_t to_ns(const struct timespec &ts){
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    }
+
+
+    LatencyHistogram::LatencyHistogram(){
+        clear();
+    }
+
+    void LatencyHistogram::clear(){
+        memset(buckets, 0, sizeof(buckets));
+        total = 0;
+        sum = 0;
+        minimum = UINT64_MAX;
+        maximum = 0;
+    }
+
+    int LatencyHistogram::bucket_index(uint64_t ns){
+        if(ns < uint64_t(SUB_BUCKETS)){
+            return int(ns);
+        }
+
+        // position of the highest set bit picks the power of two, the next
+        // SUB_BUCKET_BITS bits pick the linear bucket within it
+        int msb = 63 - __builtin_clzll(ns);
+        if(msb >= MAX_BITS){
+            return NUM_BUCKETS - 1;
+        }
+        int sub = int((ns >> (msb - SUB_BUCKET_BITS)) & uint64_t(SUB_BUCKETS - 1));
+        return (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+
+    uint64_t LatencyHistogram::bucket_value(int index){
+        if(index < SUB_BUCKETS){
+            return uint64_t(index);
+        }
+        int msb = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+        uint64_t sub = uint64_t(index % SUB_BUCKETS);
+
+        // lower bound of the bucket
+        return (uint64_t(SUB_BUCKETS) | sub) << (msb - SUB_BUCKET_BITS);
+    }
+
+    void LatencyHistogram::record(uint64_t ns){
+        ++buckets[bucket_index(ns)];
+        ++total;
+        sum += ns;
+        if(ns < minimum) minimum = ns;
+        if(ns > maximum) maximum = ns;
+    }
+
+    uint64_t LatencyHistogram::percentile(double p){
+        if(total == 0){
+            return 0;
+        }
+
+        uint64_t rank = uint64_t(p * double(total));
+        if(rank >= total){
+            rank = total - 1;
+        }
+
+        uint64_t seen = 0;
+        for(int i = 0; i < NUM_BUCKETS; ++i){
+            seen += buckets[i];
+            if(seen > rank){
+                uint64_t value = bucket_value(i);
+                return value < minimum ? minimum : (value > maximum ? maximum : value);
+            }
+        }
+        return maximum;
+    }
+
+    void LatencyHistogram::dump(std::ostream &out, const char *name){
+        char line[256];
+
+        snprintf(line, sizeof(line),
+                "%-14s count %8llu  min %9.1f  p50 %9.1f  p90 %9.1f  p99 %9.1f"
+                "  p999 %9.1f  max %9.1f us",
+                name, (unsigned long long)total, double(min()) / 1000.0,
+                double(percentile(0.50)) / 1000.0, double(percentile(0.90)) / 1000.0,
+                double(percentile(0.99)) / 1000.0, double(percentile(0.999)) / 1000.0,
+                double(max()) / 1000.0);
+        out << line << std::endl;
+    }
+
+
+    int enable_timestamping(int fd){
+
+        /** SO_TIMESTAMPING flags:
+        *
+        *   RX_SOFTWARE     stamp incoming data when the stack receives it
+        *   TX_SOFTWARE     stamp outgoing data when it reaches the driver
+        *   SOFTWARE        report software stamps (as opposed to NIC
+        *                   hardware stamps, which need driver support)
+        *   OPT_ID          tag each transmit stamp with the byte offset of
+        *                   the send it belongs to
+        *   OPT_TSONLY      return only the stamp on the error queue, not a
+        *                   copy of the sent data
+        */
+        int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE
+                  | SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_OPT_ID
+                  | SOF_TIMESTAMPING_OPT_TSONLY;
+
+        // MSG_ZEROCOPY completions share the error queue, and each reader
+        // drops the messages meant for the other
+        int zerocopy = 0;
+        socklen_t length = sizeof(zerocopy);
+        if(getsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &zerocopy, &length) == 0 && zerocopy != 0){
+            errno = EINVAL;
+            std::cerr << "error: " << __func__ << ", SO_ZEROCOPY is set on fd "
+                    << fd << ", transmit timestamps would share its error queue" << std::endl;
+            return -1;
+        }
+
+        if(setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) != 0){
+            std::cerr << "error: " << __func__ << ", setsockopt SO_TIMESTAMPING, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+
+    ConnectionTimestamps::ConnectionTimestamps(){
+        bytesSent = 0;
+    }
+
+    ssize_t ConnectionTimestamps::receive(int fd, void *buf, size_t len, int flags,
+                                        struct timespec *kernelTime){
+        struct msghdr msg;
+        struct iovec iov;
+        uint8_t control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+        iov.iov_base = buf;
+        iov.iov_len = len;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(kernelTime != NULL){
+            memset(kernelTime, 0, sizeof(*kernelTime));
+        }
+
+        ssize_t n = recvmsg(fd, &msg, flags);
+        if(n <= 0){
+            return n;
+        }
+        uint64_t now = realtime_ns();
+
+        for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)){
+            if(cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SO_TIMESTAMPING){
+                continue;
+            }
+
+            // ts[0] software, ts[1] deprecated, ts[2] hardware
+            struct scm_timestamping stamps;
+            memcpy(&stamps, CMSG_DATA(cm), sizeof(stamps));
+            if(stamps.ts[0].tv_sec == 0 && stamps.ts[0].tv_nsec == 0){
+                continue;
+            }
+
+            uint64_t stamped = to_ns(stamps.ts[0]);
+            if(now >= stamped){
+                wireToUser.record(now - stamped);
+            }
+            if(kernelTime != NULL){
+                *kernelTime = stamps.ts[0];
+            }
+        }
+        return n;
+    }
+
+    void ConnectionTimestamps::on_send(int fd, size_t bytes, uint64_t sendStartNs){
+        if(bytes == 0){
+            return;
+        }
+
+        // the stamp is taken inside the send call, so the user side time
+        // must be read before it
+        bytesSent += uint32_t(bytes);
+        sendTimes[bytesSent - 1] = sendStartNs;
+
+        // peers that never produce stamps must not grow the map forever
+        if(sendTimes.size() > MAX_PENDING_SENDS){
+            sendTimes.erase(sendTimes.begin());
+        }
+
+        poll_transmit(fd);
+    }
+
+    int ConnectionTimestamps::poll_transmit(int fd){
+        int count = 0;
+
+        for(;;){
+            struct msghdr msg;
+            uint8_t control[512];
+
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+
+            /** Transmit timestamps are returned on the socket error queue,
+            *   like MSG_ZEROCOPY completions: a SO_TIMESTAMPING message
+            *   with the stamp and an IP_RECVERR message whose ee_data is
+            *   the OPT_ID key.
+            */
+            if(recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){
+                if(errno == EAGAIN || errno == EWOULDBLOCK){
+                    break;
+                }
+                std::cerr << "error: " << __func__ << ", recvmsg MSG_ERRQUEUE, "
+                        << strerror(errno) << std::endl;
+                return -1;
+            }
+
+            bool haveStamp = false, haveKey = false;
+            struct scm_timestamping stamps;
+            uint32_t key = 0;
+
+            for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)){
+                if(cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_TIMESTAMPING){
+                    memcpy(&stamps, CMSG_DATA(cm), sizeof(stamps));
+                    haveStamp = true;
+                }
+                else if((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                        (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)){
+                    struct sock_extended_err err;
+                    memcpy(&err, CMSG_DATA(cm), sizeof(err));
+                    if(err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING &&
+                            err.ee_info == SCM_TSTAMP_SND){
+                        key = err.ee_data;
+                        haveKey = true;
+                    }
+                }
+            }
+
+            if(!haveStamp || !haveKey){
+                continue;
+            }
+            ++count;
+
+            auto it = sendTimes.find(key);
+            if(it == sendTimes.end()){
+                continue;
+            }
+
+            uint64_t stamped = to_ns(stamps.ts[0]);
+            if(stamped >= it->second){
+                userToWire.record(stamped - it->second);
+            }
+
+            // a later key implies the earlier bytes went out too
+            sendTimes.erase(sendTimes.begin(), std::next(it));
+        }
+
+        return count;
+    }
+
+    void ConnectionTimestamps::dump(std::ostream &out, int fd){
+        out << "fd " << fd << std::endl;
+        wireToUser.dump(out, "  wire-to-user");
+        userToWire.dump(out, "  user-to-wire");
+    }
+
+} // end namespace
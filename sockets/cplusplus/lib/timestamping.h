@@ -0,0 +1,124 @@
+#ifndef TIMESTAMPING_H
+#define TIMESTAMPING_H
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+
+#include <sys/types.h>
+#include <time.h>                       // struct timespec
+
+namespace mysocket{
+
+    /*  Latency histogram with logarithmic buckets.
+    *
+    *   Values are nanoseconds. Each power of two is split into
+    *   SUB_BUCKETS linear buckets, so a recorded value is off by at most
+    *   1/SUB_BUCKETS (12.5 %) at any magnitude, in a fixed 2.5 KB.
+    *   Recording is a few instructions, no allocation.
+    */
+    class LatencyHistogram{
+        public:
+
+        static constexpr int SUB_BUCKET_BITS = 3;
+        static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+
+        // values up to 2^MAX_BITS ns (about 18 minutes), larger ones are
+        // counted in the last bucket
+        static constexpr int MAX_BITS = 40;
+        static constexpr int NUM_BUCKETS = SUB_BUCKETS * (MAX_BITS - SUB_BUCKET_BITS + 1);
+
+        LatencyHistogram();
+
+        void record(uint64_t ns);
+        void clear();
+
+        uint64_t count(){return total;}
+        uint64_t min(){return total > 0 ? minimum : 0;}
+        uint64_t max(){return maximum;}
+        uint64_t mean(){return total > 0 ? sum / total : 0;}
+
+        // approximate value at fraction p (0.5 median, 0.99 ...) of the samples
+        uint64_t percentile(double p);
+
+        // one line: count, min, p50, p90, p99, p999, max in microseconds
+        void dump(std::ostream &out, const char *name);
+
+
+        private:
+            uint64_t buckets[NUM_BUCKETS];
+            uint64_t total;
+            uint64_t sum;
+            uint64_t minimum;
+            uint64_t maximum;
+
+            static int bucket_index(uint64_t ns);
+            static uint64_t bucket_value(int index);
+    };
+
+
+    // SO_TIMESTAMPING with software receive and transmit timestamps.
+    // Fails with EINVAL on a socket with SO_ZEROCOPY set, see
+    // ZeroCopySender, both use the error queue.
+    // returns 0 upon success, -1 upon failure
+    int enable_timestamping(int fd);
+
+
+    /*  Kernel timestamps for one TCP connection.
+    *
+    *   With SO_TIMESTAMPING the kernel stamps each received segment when
+    *   the network stack first sees it, and each sent segment when it is
+    *   handed to the device driver. Comparing those times with the
+    *   application's own clock splits a round trip into kernel and user
+    *   time:
+    *
+    *       wire-to-user    segment received by the stack until the
+    *                       application reads it (queueing, wakeup,
+    *                       scheduling)
+    *       user-to-wire    send call until the segment reaches the driver
+    *                       (Nagle, congestion window, qdisc)
+    *
+    *   Software timestamps use CLOCK_REALTIME.
+    */
+    class ConnectionTimestamps{
+        public:
+
+        ConnectionTimestamps();
+
+        // recvmsg that also returns the kernel receive time of the data in
+        // kernelTime (zero when no timestamp arrived) and records its
+        // wire-to-user latency. return value as recv
+        ssize_t receive(int fd, void *buf, size_t len, int flags, struct timespec *kernelTime);
+
+        // call after each successful send of bytes on fd, with the
+        // realtime_ns taken just before the send call. Collects transmit
+        // timestamps of this and earlier sends.
+        void on_send(int fd, size_t bytes, uint64_t sendStartNs);
+
+        // reads transmit timestamps from the socket error queue without
+        // blocking. returns the number read, -1 on error
+        int poll_transmit(int fd);
+
+        LatencyHistogram& wire_to_user(){return wireToUser;}
+        LatencyHistogram& user_to_wire(){return userToWire;}
+
+        void dump(std::ostream &out, int fd);
+
+
+        private:
+            LatencyHistogram wireToUser;
+            LatencyHistogram userToWire;
+
+            // with SOF_TIMESTAMPING_OPT_ID the kernel identifies a TCP
+            // transmit timestamp by the offset of the last byte of the send
+            uint32_t bytesSent;
+            std::map<uint32_t, uint64_t> sendTimes;     // byte offset -> ns
+    };
+
+
+    // CLOCK_REALTIME in nanoseconds, the clock of software timestamps
+    uint64_t realtime_ns();
+}
+
+
+#endif
@@ -0,0 +1,179 @@
+#include <cstring>              // memset, memcpy, strncmp, strlen, strerror
+#include <unistd.h>             // close
+
+#include <iostream>
+#include <cerrno>
+#include <cstddef>              // offsetof
+
+#include <sys/uio.h>            // struct iovec
+
+#include <debuglog/debuglog.h>
+
+#include "unixSocket.h"
+
+
+namespace mysocket{
+
+    static bool has_prefix(const char *text, const char *prefix){
+        return strncmp(text, prefix, strlen(prefix)) == 0;
+    }
+
+    bool is_unix_address(const char *text){
+        return text != NULL && (has_prefix(text, UNIX_STREAM_PREFIX) ||
+                                has_prefix(text, UNIX_SEQPACKET_PREFIX));
+    }
+
+    int parse_unix_address(const char *text, unix_address_t *out){
+        const char *name;
+
+        if(text == NULL){
+            return -1;
+        }
+        if(has_prefix(text, UNIX_SEQPACKET_PREFIX)){
+            out->socketType = SOCK_SEQPACKET;
+            name = text + strlen(UNIX_SEQPACKET_PREFIX);
+        }
+        else if(has_prefix(text, UNIX_STREAM_PREFIX)){
+            out->socketType = SOCK_STREAM;
+            name = text + strlen(UNIX_STREAM_PREFIX);
+        }
+        else{
+            return -1;
+        }
+
+        memset(&out->address, 0, sizeof(out->address));
+        out->address.sun_family = AF_UNIX;
+        out->abstract = name[0] == '@';
+        out->name = name;
+
+        /** struct sockaddr_un {
+        *       sa_family_t sun_family;     // AF_UNIX
+        *       char        sun_path[108];  // pathname
+        *   };
+        *
+        *   A path is NUL terminated. An abstract name starts with a NUL
+        *   byte instead of the '@' used in the text form, and its length
+        *   is given by the address length alone, without a terminator.
+        */
+        size_t length = strlen(name);
+        if(length == 0 || length >= sizeof(out->address.sun_path) ||
+                (out->abstract && length == 1)){
+            std::cerr << "error: " << __func__ << ", invalid unix socket name \""
+                    << name << "\"" << std::endl;
+            return -1;
+        }
+
+        memcpy(out->address.sun_path, name, length);
+        if(out->abstract){
+            out->address.sun_path[0] = '\0';
+            out->length = socklen_t(offsetof(struct sockaddr_un, sun_path) + length);
+        }
+        else{
+            out->length = socklen_t(offsetof(struct sockaddr_un, sun_path) + length + 1);
+        }
+        return 0;
+    }
+
+    int send_fds(int socketfd, const int *fds, int count, const void *data, size_t len){
+        struct msghdr msg;
+        struct iovec iov;
+        union{
+            struct cmsghdr align;
+            uint8_t buf[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+        } control;
+
+        if(count < 0 || count > MAX_PASSED_FDS || len == 0){
+            errno = EINVAL;
+            return -1;
+        }
+
+        iov.iov_base = const_cast<void*>(data);
+        iov.iov_len = len;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+
+        if(count > 0){
+            memset(&control, 0, sizeof(control));
+            msg.msg_control = control.buf;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * size_t(count));
+
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_SOCKET;
+            cm->cmsg_type = SCM_RIGHTS;
+            cm->cmsg_len = CMSG_LEN(sizeof(int) * size_t(count));
+            memcpy(CMSG_DATA(cm), fds, sizeof(int) * size_t(count));
+        }
+
+        ssize_t n;
+        do{
+            n = sendmsg(socketfd, &msg, MSG_NOSIGNAL);
+        }while(n < 0 && errno == EINTR);
+
+        if(n < 0){
+            std::cerr << "error: " << __func__ << ", sendmsg, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    ssize_t receive_fds(int socketfd, int *fds, int maxFds, int *count, void *data, size_t len){
+        struct msghdr msg;
+        struct iovec iov;
+        union{
+            struct cmsghdr align;
+            uint8_t buf[CMSG_SPACE(sizeof(int) * MAX_PASSED_FDS)];
+        } control;
+
+        *count = 0;
+
+        iov.iov_base = data;
+        iov.iov_len = len;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        // MSG_CMSG_CLOEXEC sets close-on-exec on the new descriptors
+        // atomically, as SOCK_CLOEXEC does for socket
+        ssize_t n;
+        do{
+            n = recvmsg(socketfd, &msg, MSG_CMSG_CLOEXEC);
+        }while(n < 0 && errno == EINTR);
+
+        if(n < 0){
+            std::cerr << "error: " << __func__ << ", recvmsg, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        for(struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)){
+            if(cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS){
+                continue;
+            }
+            int received = int((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            const uint8_t *p = CMSG_DATA(cm);
+
+            for(int i = 0; i < received; ++i){
+                int fd;
+                memcpy(&fd, p + sizeof(int) * size_t(i), sizeof(int));
+                if(*count < maxFds){
+                    fds[(*count)++] = fd;
+                }
+                else{
+                    close(fd);          // no room, do not leak it
+                }
+            }
+        }
+
+        if(msg.msg_flags & MSG_CTRUNC){
+            log_warn("descriptors dropped, control buffer too small");
+        }
+        return n;
+    }
+
+} // end namespace
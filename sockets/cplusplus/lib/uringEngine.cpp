@@ -0,0 +1,858 @@
+#include <algorithm>            // std::min
+#include <cstring>              // memset, memcpy, strerror
+#include <unistd.h>             // close, syscall
+#include <signal.h>             // _NSIG
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/uio.h>            // struct iovec
+
+#include <debuglog/debuglog.h>
+
+#include "uringEngine.h"
+
+
+namespace mysocket{
+
+    // buffer group id of the provided receive buffer ring
+    static constexpr uint16_t RECEIVE_GROUP = 0;
+
+    /** user_data layout, returned unchanged in the completion
+    *
+    *   bits 63-56  operation
+    *   bits 55-32  connection generation, counted per descriptor
+    *   bits 31-0   file descriptor
+    */
+    static constexpr uint32_t GENERATION_MASK = 0xffffff;
+
+    static uint64_t make_user_data(uint8_t op, int fd, uint32_t generation){
+        return (uint64_t(op) << 56) | (uint64_t(generation & GENERATION_MASK) << 32) |
+               uint32_t(fd);
+    }
+
+
+    UringEngine::UringEngine(){
+        ready = false;
+        ringfd = -1;
+        disabled = false;
+        sqRing = MAP_FAILED;
+        sqRingSize = 0;
+        sqes = nullptr;
+        sqesSize = 0;
+        sqHead = sqTail = nullptr;
+        sqMask = sqEntries = sqLocalTail = 0;
+        cqRing = MAP_FAILED;
+        cqRingSize = 0;
+        cqes = nullptr;
+        cqHead = cqTail = nullptr;
+        cqMask = 0;
+        sendMemory = nullptr;
+        fixedSend = true;
+        receiveRing = nullptr;
+        receiveMemory = nullptr;
+        receiveTail = 0;
+
+        if(setup() == 0){
+            ready = true;
+        }
+        else{
+            teardown();
+        }
+    }
+
+    UringEngine::~UringEngine(){
+        teardown();
+    }
+
+    int UringEngine::setup(){
+        struct io_uring_params params;
+
+        /** int io_uring_setup(u32 entries, struct io_uring_params *p);
+        *
+        *   Creates a submission queue and a completion queue shared between
+        *   the application and the kernel, and returns a file descriptor
+        *   used to map the queues and to submit work.
+        *
+        *   IORING_SETUP_CQSIZE sizes the completion queue independently, as
+        *   multishot operations post many completions per submission.
+        *
+        *   IORING_SETUP_DEFER_TASKRUN runs completion work, the second
+        *   half of each receive and send, only when run_once enters the
+        *   kernel to wait, in one batch, rather than whenever the thread
+        *   happens to make a system call. It requires
+        *   IORING_SETUP_SINGLE_ISSUER: one thread submits. The ring starts
+        *   disabled (IORING_SETUP_R_DISABLED), so that thread is the first
+        *   to call run_once, not necessarily the one constructing.
+        *
+        *   IORING_SETUP_COOP_TASKRUN, the fallback before Linux 6.1, at
+        *   least avoids interrupting the thread to run completion work.
+        */
+        memset(&params, 0, sizeof(params));
+        params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SINGLE_ISSUER |
+                       IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_R_DISABLED;
+        params.cq_entries = COMPLETION_ENTRIES;
+
+        ringfd = int(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        disabled = (ringfd >= 0);
+        if(ringfd < 0 && errno == EINVAL){
+            // kernel older than 6.1, no DEFER_TASKRUN
+            memset(&params, 0, sizeof(params));
+            params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+            params.cq_entries = COMPLETION_ENTRIES;
+            ringfd = int(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        }
+        if(ringfd < 0 && errno == EINVAL){
+            // kernel older than 5.19, no COOP_TASKRUN
+            memset(&params, 0, sizeof(params));
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = COMPLETION_ENTRIES;
+            ringfd = int(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        }
+        if(ringfd < 0){
+            log_info("io_uring_setup unavailable, %s", strerror(errno));
+            return -1;
+        }
+
+        // waiting with a timeout needs IORING_ENTER_EXT_ARG
+        if(!(params.features & IORING_FEAT_EXT_ARG)){
+            log_info("io_uring lacks IORING_FEAT_EXT_ARG");
+            return -1;
+        }
+
+        // map the rings, the submission entries are a separate mapping
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+        if(params.features & IORING_FEAT_SINGLE_MMAP){
+            if(cqRingSize > sqRingSize){
+                sqRingSize = cqRingSize;
+            }
+            cqRingSize = 0;
+        }
+
+        sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+        if(sqRing == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap sq ring, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+
+        if(cqRingSize == 0){
+            cqRing = sqRing;
+        }
+        else{
+            cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+            if(cqRing == MAP_FAILED){
+                std::cerr << "error: " << __func__ << ", mmap cq ring, "
+                        << strerror(errno) << std::endl;
+                return -1;
+            }
+        }
+
+        sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *p = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+        if(p == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap sqes, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        sqes = (struct io_uring_sqe*)p;
+
+        uint8_t *sq = (uint8_t*)sqRing;
+        uint8_t *cq = (uint8_t*)cqRing;
+
+        sqHead = (unsigned*)(void*)(sq + params.sq_off.head);
+        sqTail = (unsigned*)(void*)(sq + params.sq_off.tail);
+        sqMask = *(unsigned*)(void*)(sq + params.sq_off.ring_mask);
+        sqEntries = *(unsigned*)(void*)(sq + params.sq_off.ring_entries);
+        sqLocalTail = *sqTail;
+
+        // the index array maps ring slots to sqes, an identity mapping
+        // set once lets every slot refer to its own entry
+        unsigned *array = (unsigned*)(void*)(sq + params.sq_off.array);
+        for(unsigned i = 0; i < sqEntries; ++i){
+            array[i] = i;
+        }
+
+        cqHead = (unsigned*)(void*)(cq + params.cq_off.head);
+        cqTail = (unsigned*)(void*)(cq + params.cq_off.tail);
+        cqMask = *(unsigned*)(void*)(cq + params.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe*)(void*)(cq + params.cq_off.cqes);
+
+        /** Registered (fixed) send buffers.
+        *
+        *   IORING_REGISTER_BUFFERS pins the pages once. Sends that name a
+        *   buffer index skip the per-operation page lookup and reference
+        *   counting done for ordinary user buffers.
+        */
+        p = mmap(NULL, NUM_BUFFERS * BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap send buffers, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        sendMemory = (uint8_t*)p;
+
+        std::vector<struct iovec> iov(NUM_BUFFERS);
+        for(unsigned i = 0; i < NUM_BUFFERS; ++i){
+            iov[i].iov_base = sendMemory + i * BUFFER_SIZE;
+            iov[i].iov_len = BUFFER_SIZE;
+            freeSendBuffers.push_back(uint16_t(NUM_BUFFERS - 1 - i));
+        }
+
+        if(syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_BUFFERS,
+                    iov.data(), NUM_BUFFERS) != 0){
+            // usually RLIMIT_MEMLOCK, the same memory still stages sends
+            // as ordinary user buffers
+            log_info("io_uring register buffers failed, %s", strerror(errno));
+            fixedSend = false;
+        }
+
+        /** Provided buffer ring for multishot receive.
+        *
+        *   The kernel picks a buffer from the ring for each completion and
+        *   reports its id in the completion flags. We hand the buffer back
+        *   by writing it to the ring tail, no system call is needed.
+        */
+        p = mmap(NULL, NUM_BUFFERS * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap buffer ring, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        receiveRing = (struct io_uring_buf*)p;
+
+        p = mmap(NULL, NUM_BUFFERS * BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if(p == MAP_FAILED){
+            std::cerr << "error: " << __func__ << ", mmap receive buffers, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        receiveMemory = (uint8_t*)p;
+
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = uint64_t(receiveRing);
+        reg.ring_entries = NUM_BUFFERS;
+        reg.bgid = RECEIVE_GROUP;
+
+        if(syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0){
+            // kernel older than 5.19
+            log_info("io_uring provided buffer ring unavailable, %s", strerror(errno));
+            return -1;
+        }
+
+        for(unsigned i = 0; i < NUM_BUFFERS; ++i){
+            recycle_receive_buffer(uint16_t(i));
+        }
+
+        return 0;
+    }
+
+    void UringEngine::teardown(){
+        if(ringfd != -1){
+            // closing the ring cancels everything still in flight
+            close(ringfd);
+            ringfd = -1;
+        }
+        if(sqes != nullptr){
+            munmap(sqes, sqesSize);
+            sqes = nullptr;
+        }
+        if(cqRing != MAP_FAILED && cqRing != sqRing){
+            munmap(cqRing, cqRingSize);
+        }
+        cqRing = MAP_FAILED;
+        if(sqRing != MAP_FAILED){
+            munmap(sqRing, sqRingSize);
+            sqRing = MAP_FAILED;
+        }
+        if(sendMemory != nullptr){
+            munmap(sendMemory, NUM_BUFFERS * BUFFER_SIZE);
+            sendMemory = nullptr;
+        }
+        if(receiveRing != nullptr){
+            munmap(receiveRing, NUM_BUFFERS * sizeof(struct io_uring_buf));
+            receiveRing = nullptr;
+        }
+        if(receiveMemory != nullptr){
+            munmap(receiveMemory, NUM_BUFFERS * BUFFER_SIZE);
+            receiveMemory = nullptr;
+        }
+        ready = false;
+    }
+
+    struct io_uring_sqe* UringEngine::get_sqe(){
+        unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+        // queue full, hand what we have to the kernel first
+        if(sqLocalTail - head >= sqEntries){
+            enter(0, 0);
+            head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            if(sqLocalTail - head >= sqEntries){
+                std::cerr << "error: " << __func__ << ", submission queue full"
+                        << std::endl;
+                return nullptr;
+            }
+        }
+
+        struct io_uring_sqe *sqe = &sqes[sqLocalTail & sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        ++sqLocalTail;
+        return sqe;
+    }
+
+    int UringEngine::enter(unsigned minComplete, int timeoutMs){
+        struct io_uring_getevents_arg arg;
+        struct __kernel_timespec ts;
+
+        // GETEVENTS also runs deferred completion work, even without a wait
+        unsigned flags = IORING_ENTER_EXT_ARG | IORING_ENTER_GETEVENTS;
+
+        // the first thread to get here becomes the ring's single issuer
+        if(disabled){
+            if(syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_ENABLE_RINGS,
+                        NULL, 0) != 0){
+                std::cerr << "error: " << __func__ << ", enable ring, "
+                        << strerror(errno) << std::endl;
+                return -1;
+            }
+            disabled = false;
+        }
+
+        // publish the new entries, the kernel reads the tail on entry
+        __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+        unsigned toSubmit = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+
+        if(minComplete > 0 && timeoutMs >= 0){
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = (timeoutMs % 1000) * 1000000LL;
+            arg.ts = uint64_t(&ts);
+        }
+
+        /** int io_uring_enter(unsigned int fd, unsigned int to_submit,
+        *                      unsigned int min_complete, unsigned int flags,
+        *                      const void *arg, size_t argsz);
+        *
+        *   One call both submits every queued entry and waits for at least
+        *   min_complete completions. ETIME reports the timeout expired.
+        */
+        int rv = int(syscall(__NR_io_uring_enter, ringfd, toSubmit, minComplete,
+                    flags, &arg, sizeof(arg)));
+        if(rv < 0 && errno != ETIME && errno != EINTR && errno != EBUSY){
+            std::cerr << "error: " << __func__ << ", io_uring_enter, "
+                    << strerror(errno) << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    void UringEngine::recycle_receive_buffer(uint16_t bid){
+        struct io_uring_buf *buf = &receiveRing[receiveTail & (NUM_BUFFERS - 1)];
+        buf->addr = uint64_t(receiveMemory + size_t(bid) * BUFFER_SIZE);
+        buf->len = BUFFER_SIZE;
+        buf->bid = bid;
+        ++receiveTail;
+
+        // the ring tail overlays the resv field of the first entry
+        __atomic_store_n(&receiveRing[0].resv, receiveTail, __ATOMIC_RELEASE);
+    }
+
+    void UringEngine::release_chunk(send_chunk_t &chunk){
+        if(chunk.buffer != -1){
+            freeSendBuffers.push_back(uint16_t(chunk.buffer));
+            chunk.buffer = -1;
+        }
+    }
+
+    UringEngine::connection_t* UringEngine::register_fd(int fd){
+        auto it = connections.find(fd);
+        if(it != connections.end()){
+            return &it->second;
+        }
+
+        if(size_t(fd) >= generations.size()){
+            generations.resize(size_t(fd) + 1, 0);
+        }
+
+        connection_t &c = connections[fd];
+        c.generation = ++generations[size_t(fd)] & GENERATION_MASK;
+        c.queuedBytes = 0;
+        c.sentBytes = 0;
+        c.inFlightChunks = 0;
+        return &c;
+    }
+
+    UringEngine::connection_t* UringEngine::find_connection(int fd, uint32_t generation){
+        auto it = connections.find(fd);
+        if(it == connections.end() || it->second.generation != generation){
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    void UringEngine::arm_accept(int fd, connection_t *c){
+        struct io_uring_sqe *sqe = get_sqe();
+        if(sqe == nullptr){
+            deferred.push_back({fd, c->generation, OP_ACCEPT});
+            return;
+        }
+
+        // multishot accept posts one completion per connection
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->user_data = make_user_data(OP_ACCEPT, fd, c->generation);
+    }
+
+    void UringEngine::arm_receive(int fd, connection_t *c){
+        struct io_uring_sqe *sqe = get_sqe();
+        if(sqe == nullptr){
+            deferred.push_back({fd, c->generation, OP_RECEIVE});
+            return;
+        }
+
+        // multishot receive into buffers selected from RECEIVE_GROUP
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = fd;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = RECEIVE_GROUP;
+        sqe->user_data = make_user_data(OP_RECEIVE, fd, c->generation);
+    }
+
+    void UringEngine::start_send(int fd, connection_t *c){
+        if(c->inFlightChunks > 0 || c->chunks.empty()){
+            return;
+        }
+
+        struct io_uring_sqe *sqe = get_sqe();
+        if(sqe == nullptr){
+            // staged bytes stay queued, run_once submits them
+            deferred.push_back({fd, c->generation, OP_SEND});
+            return;
+        }
+
+        send_chunk_t &first = c->chunks.front();
+        if(c->chunks.size() == 1 && first.buffer != -1 && fixedSend){
+            // one registered buffer, the kernel skips pinning its pages
+            sqe->opcode = IORING_OP_SEND;
+            sqe->fd = fd;
+            sqe->addr = uint64_t(sendMemory + size_t(first.buffer) * BUFFER_SIZE + first.offset);
+            sqe->len = first.length - first.offset;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+            sqe->buf_index = uint16_t(first.buffer);
+            sqe->user_data = make_user_data(OP_SEND_FIXED, fd, c->generation);
+            c->inFlightChunks = 1;
+            return;
+        }
+
+        /** Gather the front of the chain into one sendmsg. The kernel
+        *   copies msghdr and iov when it consumes the entry
+        *   (IORING_FEAT_SUBMIT_STABLE), the chunks they point to must
+        *   stay put until the completion.
+        */
+        unsigned n = 0;
+        for(send_chunk_t &chunk : c->chunks){
+            if(n == MAX_SEND_CHUNKS){
+                break;
+            }
+            uint8_t *base = chunk.buffer != -1
+                            ? sendMemory + size_t(chunk.buffer) * BUFFER_SIZE
+                            : chunk.heap.data();
+            c->iov[n].iov_base = base + chunk.offset;
+            c->iov[n].iov_len = chunk.length - chunk.offset;
+            ++n;
+        }
+
+        memset(&c->msg, 0, sizeof(c->msg));
+        c->msg.msg_iov = c->iov;
+        c->msg.msg_iovlen = n;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = uint64_t(&c->msg);
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = make_user_data(OP_SEND, fd, c->generation);
+        c->inFlightChunks = n;
+    }
+
+    void UringEngine::stage(connection_t *c, const uint8_t *bytes, size_t len){
+        // top up the last registered buffer, in flight or not: a send
+        // only reads the length it was submitted with
+        if(!c->chunks.empty()){
+            send_chunk_t &last = c->chunks.back();
+            if(last.buffer != -1 && last.length < BUFFER_SIZE){
+                size_t n = std::min(len, BUFFER_SIZE - last.length);
+                memcpy(sendMemory + size_t(last.buffer) * BUFFER_SIZE + last.length, bytes, n);
+                last.length += uint32_t(n);
+                bytes += n;
+                len -= n;
+            }
+        }
+
+        while(len > 0){
+            send_chunk_t chunk;
+            chunk.offset = 0;
+
+            if(freeSendBuffers.empty()){
+                // out of registered memory, the rest goes in one heap chunk
+                chunk.buffer = -1;
+                chunk.heap.assign(bytes, bytes + len);
+                chunk.length = uint32_t(len);
+                c->chunks.push_back(std::move(chunk));
+                return;
+            }
+
+            size_t n = std::min(len, BUFFER_SIZE);
+            chunk.buffer = freeSendBuffers.back();
+            freeSendBuffers.pop_back();
+            memcpy(sendMemory + size_t(chunk.buffer) * BUFFER_SIZE, bytes, n);
+            chunk.length = uint32_t(n);
+            c->chunks.push_back(std::move(chunk));
+            bytes += n;
+            len -= n;
+        }
+    }
+
+    int UringEngine::accept_multishot(int listenfd, AcceptCallback cb){
+        if(!ready){
+            return -1;
+        }
+        connection_t *c = register_fd(listenfd);
+        c->accept = std::move(cb);
+        arm_accept(listenfd, c);
+        return 0;
+    }
+
+    int UringEngine::receive_multishot(int fd, ReceiveCallback cb){
+        if(!ready){
+            return -1;
+        }
+        connection_t *c = register_fd(fd);
+        c->receive = std::move(cb);
+        arm_receive(fd, c);
+        return 0;
+    }
+
+    int UringEngine::send_data(int fd, const void *buf, size_t len, SendCallback cb){
+        if(!ready){
+            return -1;
+        }
+        if(len == 0){
+            return 0;
+        }
+
+        connection_t *c = register_fd(fd);
+        stage(c, (const uint8_t*)buf, len);
+
+        c->queuedBytes += len;
+        c->requests.push_back({c->queuedBytes, len, std::move(cb)});
+
+        start_send(fd, c);
+        return 0;
+    }
+
+    int UringEngine::cancel(int fd){
+        auto it = connections.find(fd);
+        if(it == connections.end()){
+            return -1;
+        }
+        connection_t &c = it->second;
+
+        /** Cancel every request on fd. Completions still in flight carry
+        *   the old generation and are discarded when they arrive, even if
+        *   fd has been reused by then.
+        */
+        struct io_uring_sqe *sqe = get_sqe();
+        if(sqe != nullptr){
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = make_user_data(OP_CANCEL, fd, c.generation);
+        }
+
+        // cancellation must reach the kernel before the caller closes fd,
+        // and a queued sendmsg must be consumed before its msghdr goes
+        int rv = enter(0, 0);
+
+        // an in-flight send still reads its chunks, keep them until its
+        // completion arrives
+        for(size_t i = 0; i < c.chunks.size(); ++i){
+            if(i < c.inFlightChunks){
+                orphanedChunks[make_user_data(0, fd, c.generation)].push_back(
+                            std::move(c.chunks[i]));
+            }
+            else{
+                release_chunk(c.chunks[i]);
+            }
+        }
+        connections.erase(it);
+        return rv;
+    }
+
+    int UringEngine::run_once(int timeoutMs){
+        int count = 0;
+
+        if(!ready){
+            return -1;
+        }
+
+        // operations that found the submission queue full last time
+        run_deferred();
+
+        unsigned pending = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE) - *cqHead;
+        unsigned minComplete = (pending == 0 && timeoutMs != 0) ? 1 : 0;
+
+        if(enter(minComplete, timeoutMs) != 0){
+            return -1;
+        }
+
+        unsigned head = *cqHead;
+        while(head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)){
+            struct io_uring_cqe *cqe = &cqes[head & cqMask];
+            uint64_t userData = cqe->user_data;
+            int32_t res = cqe->res;
+            uint32_t flags = cqe->flags;
+
+            // release the slot before the callback runs
+            ++head;
+            __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+
+            handle_completion(userData, res, flags);
+            ++count;
+        }
+
+        return count;
+    }
+
+    void UringEngine::run_deferred(){
+        std::vector<deferred_t> retry;
+        retry.swap(deferred);
+
+        for(deferred_t &d : retry){
+            connection_t *c = find_connection(d.fd, d.generation);
+            if(c == nullptr){
+                continue;
+            }
+            if(d.op == OP_ACCEPT && c->accept){
+                arm_accept(d.fd, c);
+            }
+            else if(d.op == OP_RECEIVE && c->receive){
+                arm_receive(d.fd, c);
+            }
+            else if(d.op == OP_SEND){
+                start_send(d.fd, c);
+            }
+        }
+    }
+
+    void UringEngine::handle_completion(uint64_t userData, int32_t res, uint32_t flags){
+        uint8_t op = uint8_t(userData >> 56);
+        uint32_t generation = uint32_t(userData >> 32) & GENERATION_MASK;
+        int fd = int(uint32_t(userData));
+
+        switch(op){
+            case OP_ACCEPT:
+                complete_accept(fd, generation, res, flags);
+                break;
+            case OP_RECEIVE:
+                complete_receive(fd, generation, res, flags);
+                break;
+            case OP_SEND:
+                complete_send(fd, generation, false, res);
+                break;
+            case OP_SEND_FIXED:
+                complete_send(fd, generation, true, res);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void UringEngine::complete_accept(int fd, uint32_t generation, int32_t res, uint32_t flags){
+        struct sockaddr_storage address;
+        socklen_t addressLength = sizeof(address);
+
+        memset(&address, 0, sizeof(address));
+
+        connection_t *c = find_connection(fd, generation);
+        if(c == nullptr || !c->accept){
+            // listener was cancelled, nobody owns this connection
+            if(res >= 0){
+                close(res);
+            }
+            return;
+        }
+
+        if(res == -ECANCELED){
+            return;
+        }
+
+        if(res >= 0){
+            getpeername(res, (struct sockaddr*)&address, &addressLength);
+        }
+
+        // copy, the callback may cancel fd
+        AcceptCallback cb = c->accept;
+        cb(res, address);
+
+        // the kernel ended the multishot request, start another
+        if(res >= 0 && !(flags & IORING_CQE_F_MORE)){
+            c = find_connection(fd, generation);
+            if(c != nullptr && c->accept){
+                arm_accept(fd, c);
+            }
+        }
+    }
+
+    void UringEngine::complete_receive(int fd, uint32_t generation, int32_t res, uint32_t flags){
+        bool hasBuffer = (flags & IORING_CQE_F_BUFFER) != 0;
+        uint16_t bid = uint16_t(flags >> IORING_CQE_BUFFER_SHIFT);
+
+        connection_t *c = find_connection(fd, generation);
+        if(c == nullptr || !c->receive){
+            if(hasBuffer){
+                recycle_receive_buffer(bid);
+            }
+            return;
+        }
+
+        if(res > 0 && hasBuffer){
+            ReceiveCallback cb = c->receive;
+            cb(fd, receiveMemory + size_t(bid) * BUFFER_SIZE, res);
+            recycle_receive_buffer(bid);
+
+            if(!(flags & IORING_CQE_F_MORE)){
+                c = find_connection(fd, generation);
+                if(c != nullptr && c->receive){
+                    arm_receive(fd, c);
+                }
+            }
+            return;
+        }
+
+        if(hasBuffer){
+            recycle_receive_buffer(bid);
+        }
+
+        // all buffers were in use, they have been returned since
+        if(res == -ENOBUFS){
+            arm_receive(fd, c);
+            return;
+        }
+
+        if(res == -ECANCELED){
+            return;
+        }
+
+        // end of stream or error, receiving stops
+        ReceiveCallback cb = c->receive;
+        c->receive = nullptr;
+        cb(fd, nullptr, res);
+    }
+
+    void UringEngine::complete_send(int fd, uint32_t generation, bool fixed, int32_t res){
+        connection_t *c = find_connection(fd, generation);
+        if(c == nullptr){
+            // connection was cancelled while the send was in flight
+            auto it = orphanedChunks.find(make_user_data(0, fd, generation));
+            if(it != orphanedChunks.end()){
+                for(send_chunk_t &chunk : it->second){
+                    release_chunk(chunk);
+                }
+                orphanedChunks.erase(it);
+            }
+            return;
+        }
+
+        c->inFlightChunks = 0;
+
+        if(res == -EINVAL && fixed){
+            // kernel does not support registered buffers for send, send
+            // from the same memory as an ordinary user buffer. Sends of
+            // other connections submitted before the first of these
+            // completions fail the same way and are retried here too.
+            if(fixedSend){
+                log_info("IORING_RECVSEND_FIXED_BUF not supported for send");
+                fixedSend = false;
+            }
+            start_send(fd, c);
+            return;
+        }
+
+        // a send that moved nothing would be resubmitted forever
+        if(res == 0){
+            res = -EIO;
+        }
+
+        if(res < 0){
+            // fail every queued request
+            for(send_chunk_t &chunk : c->chunks){
+                release_chunk(chunk);
+            }
+            c->chunks.clear();
+            std::deque<send_request_t> failed;
+            failed.swap(c->requests);
+
+            for(send_request_t &request : failed){
+                if(request.callback){
+                    request.callback(fd, res);
+                }
+            }
+            return;
+        }
+
+        c->sentBytes += uint64_t(res);
+
+        // drop the chunks sent in full, the last may be partly sent
+        size_t left = size_t(res);
+        while(left > 0){
+            send_chunk_t &chunk = c->chunks.front();
+            size_t n = std::min(left, size_t(chunk.length - chunk.offset));
+            chunk.offset += uint32_t(n);
+            left -= n;
+            if(chunk.offset == chunk.length){
+                release_chunk(chunk);
+                c->chunks.pop_front();
+            }
+        }
+
+        std::vector<send_request_t> done;
+        while(!c->requests.empty() && c->requests.front().end <= c->sentBytes){
+            done.push_back(std::move(c->requests.front()));
+            c->requests.pop_front();
+        }
+
+        for(send_request_t &request : done){
+            if(request.callback){
+                request.callback(fd, ssize_t(request.total));
+            }
+        }
+
+        // a callback may have cancelled fd
+        c = find_connection(fd, generation);
+        if(c == nullptr){
+            return;
+        }
+        start_send(fd, c);
+    }
+
+} // end namespace
@@ -0,0 +1,180 @@
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/socket.h>                 // struct msghdr
+#include <sys/uio.h>                    // struct iovec
+
+#include <linux/io_uring.h>
+
+#include "ioEngine.h"
+
+namespace mysocket{
+
+    /*  IoEngine implemented directly on the io_uring system calls.
+    *
+    *   - submissions are batched and handed to the kernel with a single
+    *     io_uring_enter per run_once, which also waits for completions
+    *   - send_data copies the bytes once, into registered (fixed)
+    *     buffers chained per connection, small writes filling the last
+    *     one. A single send, or a sendmsg gathering up to
+    *     MAX_SEND_CHUNKS buffers, is in flight per connection to keep the
+    *     byte stream in order. When every registered buffer is taken the
+    *     bytes go to the heap instead of waiting.
+    *   - receives use multishot recv with a provided buffer ring, one
+    *     submission keeps delivering data until the connection ends
+    *   - accepts use multishot accept
+    *
+    *   Requires Linux 6.0 or newer. Check is_ready() after construction,
+    *   or use IoEngine::create which falls back to EpollEngine.
+    */
+    class UringEngine : public IoEngine{
+        public:
+
+        static constexpr unsigned RING_ENTRIES = 256;
+        static constexpr unsigned COMPLETION_ENTRIES = 4096;
+
+        // chunks of one connection's send chain one sendmsg gathers
+        static constexpr unsigned MAX_SEND_CHUNKS = 16;
+
+        UringEngine();
+        ~UringEngine() override;
+
+        // true when the ring and its buffers were set up successfully
+        bool is_ready(){return ready;}
+
+        const char* name() override {return "io_uring";}
+
+        int accept_multishot(int listenfd, AcceptCallback cb) override;
+        int receive_multishot(int fd, ReceiveCallback cb) override;
+        int send_data(int fd, const void *buf, size_t len, SendCallback cb = nullptr) override;
+        int cancel(int fd) override;
+        int run_once(int timeoutMs) override;
+
+        // disable copy semantics
+        UringEngine(const UringEngine&) = delete;
+        UringEngine& operator=(const UringEngine&) = delete;
+
+
+        private:
+
+            enum operation_t : uint8_t{
+                OP_ACCEPT = 1,
+                OP_RECEIVE,
+                OP_SEND,                    // send or sendmsg from the chain
+                OP_SEND_FIXED,              // send from one registered buffer
+                OP_CANCEL
+            };
+
+            // a send_data call, done once the stream has sent up to end
+            struct send_request_t{
+                uint64_t end;
+                size_t total;
+                SendCallback callback;
+            };
+
+            // staged bytes, in a registered buffer or, when all of those
+            // are in use, on the heap
+            struct send_chunk_t{
+                int buffer;                     // registered index, -1 heap
+                std::vector<uint8_t> heap;
+                uint32_t length;                // bytes staged
+                uint32_t offset;                // bytes sent
+            };
+
+            struct connection_t{
+                uint32_t generation;
+                AcceptCallback accept;
+                ReceiveCallback receive;
+
+                // the send chain, copied in once by send_data. One send
+                // in flight covers up to MAX_SEND_CHUNKS of it.
+                std::deque<send_chunk_t> chunks;
+                std::deque<send_request_t> requests;
+                uint64_t queuedBytes;
+                uint64_t sentBytes;
+                unsigned inFlightChunks;        // 0 when no send is in flight
+                struct msghdr msg;
+                struct iovec iov[MAX_SEND_CHUNKS];
+            };
+
+            // an operation get_sqe had no room for, retried by run_once
+            struct deferred_t{
+                int fd;
+                uint32_t generation;
+                uint8_t op;
+            };
+
+            bool ready;
+            int ringfd;
+            bool disabled;                  // enabled by the first enter
+
+            // submission queue
+            void *sqRing;
+            size_t sqRingSize;
+            struct io_uring_sqe *sqes;
+            size_t sqesSize;
+            unsigned *sqHead;
+            unsigned *sqTail;
+            unsigned sqMask;
+            unsigned sqEntries;
+            unsigned sqLocalTail;           // published to sqTail by enter
+
+            // completion queue
+            void *cqRing;
+            size_t cqRingSize;
+            struct io_uring_cqe *cqes;
+            unsigned *cqHead;
+            unsigned *cqTail;
+            unsigned cqMask;
+
+            // registered send buffers
+            uint8_t *sendMemory;
+            std::vector<uint16_t> freeSendBuffers;
+            bool fixedSend;
+
+            // chunks of cancelled connections still read by a send in
+            // flight, keyed by the send's user_data without the operation
+            std::unordered_map<uint64_t, std::vector<send_chunk_t>> orphanedChunks;
+
+            // provided receive buffer ring
+            struct io_uring_buf *receiveRing;
+            uint8_t *receiveMemory;
+            uint16_t receiveTail;
+
+            // per descriptor, bumped each time fd is registered, so late
+            // completions for a closed fd miss a connection reusing it
+            std::vector<uint32_t> generations;
+            std::unordered_map<int, connection_t> connections;
+            std::vector<deferred_t> deferred;
+
+            int setup();
+            void teardown();
+
+            struct io_uring_sqe* get_sqe();
+            int enter(unsigned minComplete, int timeoutMs);
+
+            connection_t* register_fd(int fd);
+            connection_t* find_connection(int fd, uint32_t generation);
+
+            void recycle_receive_buffer(uint16_t bid);
+            void release_chunk(send_chunk_t &chunk);
+            void stage(connection_t *c, const uint8_t *bytes, size_t len);
+
+            void arm_accept(int fd, connection_t *c);
+            void arm_receive(int fd, connection_t *c);
+            void start_send(int fd, connection_t *c);
+            void run_deferred();
+
+            void handle_completion(uint64_t userData, int32_t res, uint32_t flags);
+            void complete_accept(int fd, uint32_t generation, int32_t res, uint32_t flags);
+            void complete_receive(int fd, uint32_t generation, int32_t res, uint32_t flags);
+            void complete_send(int fd, uint32_t generation, bool fixed, int32_t res);
+    };
+}
+
+
+#endif
@@ -0,0 +1,188 @@
+#include <cstring>              // strerror
+#include <unistd.h>             // close, read, write
+
+#include <iostream>
+#include <cerrno>
+
+#include <sys/eventfd.h>
+
+#include <debuglog/debuglog.h>
+
+#include "workerPool.h"
+
+
+namespace mysocket{
+
+    WorkerPool::WorkerPool(int numWorkers){
+        nextWorker = 0;
+        queued = 0;
+        stopping = false;
+        steals = 0;
+        completed = 0;
+
+        /** int eventfd(unsigned int initval, int flags);
+        *
+        *   A kernel counter usable as a file descriptor. write adds to the
+        *   counter, read returns it and resets it to zero, and the
+        *   descriptor is readable while the counter is non-zero, so a
+        *   worker thread can wake an I/O thread blocked in epoll or select.
+        */
+        completionfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if(completionfd == -1){
+            std::cerr << "error: " << __func__ << ", eventfd, "
+                    << strerror(errno) << std::endl;
+            return;
+        }
+
+        if(numWorkers <= 0){
+            numWorkers = int(std::thread::hardware_concurrency());
+            if(numWorkers <= 0){
+                numWorkers = 1;
+            }
+        }
+
+        // every deque exists before any worker can try to steal from it
+        for(int i = 0; i < numWorkers; ++i){
+            workers.push_back(std::make_unique<worker_t>());
+        }
+        for(size_t i = 0; i < workers.size(); ++i){
+            workers[i]->thread = std::thread(&WorkerPool::work, this, i);
+        }
+        log_debug("worker pool started, %d workers", numWorkers);
+    }
+
+    WorkerPool::~WorkerPool(){
+        {
+            std::lock_guard<std::mutex> guard(idleLock);
+            stopping = true;
+        }
+        idle.notify_all();
+
+        for(std::unique_ptr<worker_t> &w : workers){
+            if(w->thread.joinable()){
+                w->thread.join();
+            }
+        }
+
+        if(completionfd != -1){
+            close(completionfd);
+            completionfd = -1;
+        }
+    }
+
+    int WorkerPool::submit(Job job, Job done){
+        // no workers to take the job, or no way to report it finished
+        if(!is_ready()){
+            std::cerr << "error: " << __func__ << ", worker pool not ready" << std::endl;
+            return -1;
+        }
+
+        worker_t &w = *workers[nextWorker.fetch_add(1, std::memory_order_relaxed)
+                                % workers.size()];
+        {
+            std::lock_guard<std::mutex> guard(w.lock);
+            w.tasks.push_back({std::move(job), std::move(done)});
+        }
+        queued.fetch_add(1);
+
+        // a worker that saw queued == 0 holds idleLock until it waits, so
+        // taking the lock here means the notify cannot fall between its
+        // check and its wait
+        {
+            std::lock_guard<std::mutex> guard(idleLock);
+        }
+        idle.notify_one();
+        return 0;
+    }
+
+    bool WorkerPool::take(size_t self, task_t &task){
+        // own deque first, oldest task
+        {
+            worker_t &w = *workers[self];
+            std::lock_guard<std::mutex> guard(w.lock);
+            if(!w.tasks.empty()){
+                task = std::move(w.tasks.front());
+                w.tasks.pop_front();
+                queued.fetch_sub(1);
+                return true;
+            }
+        }
+
+        // steal from the others, starting with the next worker so thieves
+        // spread over different victims
+        for(size_t i = 1; i < workers.size(); ++i){
+            worker_t &victim = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if(!victim.tasks.empty()){
+                task = std::move(victim.tasks.back());
+                victim.tasks.pop_back();
+                queued.fetch_sub(1);
+                steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void WorkerPool::work(size_t self){
+        task_t task;
+
+        for(;;){
+            if(take(self, task)){
+                task.job();
+                completed.fetch_add(1, std::memory_order_relaxed);
+                if(task.done){
+                    complete(std::move(task.done));
+                }
+                task = task_t();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(idleLock);
+            if(stopping && queued.load() == 0){
+                break;
+            }
+            idle.wait(guard, [this]{return stopping || queued.load() > 0;});
+        }
+    }
+
+    void WorkerPool::complete(Job done){
+        bool wasEmpty;
+        {
+            std::lock_guard<std::mutex> guard(completionLock);
+            wasEmpty = completions.empty();
+            completions.push_back(std::move(done));
+        }
+
+        // one wakeup per batch, later completions ride along until the
+        // I/O thread collects them
+        if(wasEmpty){
+            uint64_t one = 1;
+            if(write(completionfd, &one, sizeof(one)) != sizeof(one)){
+                log_warn("completion wakeup failed: %s", strerror(errno));
+            }
+        }
+    }
+
+    int WorkerPool::run_completions(){
+        uint64_t count;
+        std::vector<Job> ready;
+
+        // reset the counter before taking the batch: a completion queued
+        // after the swap signals again
+        if(read(completionfd, &count, sizeof(count)) < 0 && errno != EAGAIN){
+            log_warn("completion read failed: %s", strerror(errno));
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(completionLock);
+            ready.swap(completions);
+        }
+
+        for(Job &done : ready){
+            done();
+        }
+        return int(ready.size());
+    }
+
+} // end namespace
@@ -0,0 +1,111 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mysocket{
+
+    /*  Work-stealing thread pool for request handlers that are too CPU
+    *   heavy to run on an I/O thread.
+    *
+    *   The I/O thread decodes a request and submits a job. Each worker has
+    *   its own deque, so submitting and taking work only locks one
+    *   short deque rather than a queue shared by every thread. A worker
+    *   whose deque is empty steals from the others before going to sleep,
+    *   which evens out bursts that landed on one worker.
+    *
+    *   When a job finishes, its completion is queued back to the I/O thread
+    *   and an eventfd is signalled. The I/O loop waits on
+    *   get_completion_fd() next to its sockets (EventLoop, epoll, select)
+    *   and calls run_completions, so responses are still written by the
+    *   thread that owns the connection and no socket is touched by two
+    *   threads.
+    *
+    *   Jobs of one connection may finish out of order when they run on
+    *   different workers. Callers that need responses in request order
+    *   number the requests and reorder in the completion.
+    */
+    class WorkerPool{
+        public:
+
+        using Job = std::function<void()>;
+
+        // numWorkers 0 starts one worker per hardware thread
+        explicit WorkerPool(int numWorkers = 0);
+
+        // finishes the queued jobs and joins the workers. Completions not
+        // yet run are dropped.
+        ~WorkerPool();
+
+        bool is_ready(){return completionfd != -1 && !workers.empty();}
+
+        // queues job on a worker. done, when set, runs on the thread that
+        // calls run_completions after job has returned.
+        // returns 0 upon success, -1 when the pool is not ready
+        int submit(Job job, Job done = nullptr);
+
+        // eventfd, readable while completions are waiting
+        int get_completion_fd(){return completionfd;}
+
+        // runs the completions of finished jobs.
+        // returns the number run
+        int run_completions();
+
+        int get_num_workers(){return int(workers.size());}
+        uint64_t get_steals(){return steals.load(std::memory_order_relaxed);}
+        uint64_t get_completed(){return completed.load(std::memory_order_relaxed);}
+
+        // disable copy semantics
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+
+        private:
+
+            struct task_t{
+                Job job;
+                Job done;
+            };
+
+            // the owner takes from the front, so requests start in the
+            // order they arrived; thieves take from the back, the task
+            // that would otherwise wait longest
+            struct worker_t{
+                std::mutex lock;
+                std::deque<task_t> tasks;
+                std::thread thread;
+            };
+
+            std::vector<std::unique_ptr<worker_t>> workers;
+            std::atomic<uint32_t> nextWorker;
+
+            // jobs submitted and not yet taken, lets idle workers sleep
+            std::atomic<int64_t> queued;
+            std::mutex idleLock;
+            std::condition_variable idle;
+            bool stopping;
+
+            // finished jobs waiting for run_completions
+            std::mutex completionLock;
+            std::vector<Job> completions;
+            int completionfd;
+
+            std::atomic<uint64_t> steals;
+            std::atomic<uint64_t> completed;
+
+            void work(size_t self);
+            bool take(size_t self, task_t &task);
+            void complete(Job done);
+    };
+}
+
+
+#endif